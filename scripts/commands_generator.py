@@ -5,17 +5,62 @@ import random
 N = 1_000_000
 random.seed(42)
 
+
+def passive_order():
+    # Mostly passive orders that do not cross.
+    # Buys stay below 10000, sells stay above 10000.
+    if random.random() < 0.5:
+        side = "buy"
+        price = random.randint(9500, 9999)
+    else:
+        side = "sell"
+        price = random.randint(10001, 10500)
+
+    qty = random.randint(1, 100)
+    return qty, side, price
+
+
 with open("data/book_growth.txt", "w") as f:
     for i in range(1, N + 1):
-        # Mostly passive orders that do not cross.
-        # Buys stay below 10000, sells stay above 10000.
-        if random.random() < 0.5:
-            side = "buy"
-            price = random.randint(9500, 9999)
-        else:
-            side = "sell"
-            price = random.randint(10001, 10500)
+        qty, side, price = passive_order()
+        f.write(f"ADD GTC {qty} {side} {price}\n")
 
-        qty = random.randint(1, 100)
+# Resting book that is constantly churned: half of the commands add passive
+# orders, the rest cancel or reduce random live orders. The book hands out ids
+# sequentially starting at 2 and none of these orders trade, so the n-th ADD
+# gets id n + 1. Only meaningful with --iterations=1
+with open("data/cancel_heavy.txt", "w") as f:
+    live = []
+    next_id = 2
+    for i in range(1, N + 1):
+        r = random.random()
+        if r < 0.5 or not live:
+            qty, side, price = passive_order()
+            f.write(f"ADD GTC {qty} {side} {price}\n")
+            live.append(next_id)
+            next_id += 1
+        elif r < 0.85:
+            idx = random.randrange(len(live))
+            live[idx], live[-1] = live[-1], live[idx]
+            f.write(f"CANCEL {live.pop()}\n")
+        else:
+            f.write(f"MODIFY {random.choice(live)} quantity=1\n")
 
-        f.write(f"ADD GTC {qty} {side} {price}\n")
+# Same churn spread over 64 instruments ('@<instrument id>' prefix). Every
+# instrument has its own book and its own id sequence starting at 2
+INSTRUMENTS = 64
+with open("data/multi_instrument.txt", "w") as f:
+    live = [[] for _ in range(INSTRUMENTS)]
+    next_id = [2] * INSTRUMENTS
+    for i in range(1, N + 1):
+        instrument = random.randrange(INSTRUMENTS)
+        orders = live[instrument]
+        if random.random() < 0.6 or not orders:
+            qty, side, price = passive_order()
+            f.write(f"@{instrument} ADD GTC {qty} {side} {price}\n")
+            orders.append(next_id[instrument])
+            next_id[instrument] += 1
+        else:
+            idx = random.randrange(len(orders))
+            orders[idx], orders[-1] = orders[-1], orders[idx]
+            f.write(f"@{instrument} CANCEL {orders.pop()}\n")
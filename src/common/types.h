@@ -1,10 +1,86 @@
 #pragma once
 
 #include "usings.h"
+#include <cstdint>
+#include <string_view>
 
-enum class OrderType { Bad, Market, GoodTillCancel, GoodTillEOD, FillOrKill, FillAndKill };
+// Both enums are one byte so that they pack next to each other in Order.
+// GoodTillEOD rests until the session closes, GoodTillDate until the expiry given with the order.
+// Stop and StopLimit orders wait off the book until a trade reaches their trigger price, then they are
+// matched as a Market order (Stop) or a GoodTillCancel order at their price (StopLimit)
+enum class OrderType : std::uint8_t {
+    Bad,
+    Market,
+    GoodTillCancel,
+    GoodTillEOD,
+    FillOrKill,
+    FillAndKill,
+    GoodTillDate,
+    Stop,
+    StopLimit,
+};
+
+enum class Side : std::uint8_t { Bad, Buy, Sell };
+
+constexpr Side opposite(Side side) { return side == Side::Buy ? Side::Sell : Side::Buy; }
+
+// Why the book refused a command, None if it was accepted
+enum class RejectReason {
+    None,
+    BadQuantity,
+    BadPrice,
+    BadType,
+    BadSide,
+    // GoodTillDate order without an expiry in the future
+    BadExpiry,
+    // Stop order without a trigger price, or another order type turned into a stop
+    BadTrigger,
+    // Price can not be stored by the side container (TickLevels window limit)
+    PriceOutOfRange,
+    // FAK order that does not cross the spread
+    NotCrossing,
+    // FOK order that can not be filled completely
+    InsufficientLiquidity,
+    // Cancel or modify of an id that is not resting on the book
+    UnknownOrder,
+    // Instrument is not handled by this BookManager shard
+    UnknownInstrument,
+    // Order that has to match right away sent while the book is in a call auction
+    InAuction,
+};
 
-enum class Side { Bad, Buy, Sell };
+constexpr std::string_view toString(RejectReason reason)
+{
+    switch (reason) {
+    case RejectReason::None:
+        return "none";
+    case RejectReason::BadQuantity:
+        return "bad quantity";
+    case RejectReason::BadPrice:
+        return "bad price";
+    case RejectReason::BadType:
+        return "bad type";
+    case RejectReason::BadSide:
+        return "bad side";
+    case RejectReason::BadExpiry:
+        return "bad expiry";
+    case RejectReason::BadTrigger:
+        return "bad trigger";
+    case RejectReason::PriceOutOfRange:
+        return "price out of range";
+    case RejectReason::NotCrossing:
+        return "does not cross the spread";
+    case RejectReason::InsufficientLiquidity:
+        return "insufficient liquidity";
+    case RejectReason::UnknownOrder:
+        return "unknown order";
+    case RejectReason::UnknownInstrument:
+        return "unknown instrument";
+    case RejectReason::InAuction:
+        return "in auction";
+    }
+    return "unknown reason";
+}
 
 struct ModifyOrder {
     std::optional<price_t> price{};
@@ -12,3 +88,38 @@ struct ModifyOrder {
     std::optional<OrderType> type{};
     std::optional<Side> side{};
 };
+
+enum class Actions { ADD, CANCEL, MODIFY, NULLACTION };
+
+// One parsed line of a command file. Fields a command does not use keep their
+// bad value, for MODIFY the set fields are the requested modifications
+struct Command {
+    Actions action{Actions::NULLACTION};
+
+    orderId_t oid = badValues::orderId;
+    OrderType type = OrderType::Bad;
+    quantity_t quantity = badValues::quantity;
+    price_t price = badValues::price;
+    Side side = Side::Bad;
+    instrumentId_t instrument = 0;
+    // Only used by GoodTillDate adds
+    microsec_t expiry{0};
+    // Only used by Stop and StopLimit adds
+    price_t trigger = badValues::price;
+    // Displayed quantity of iceberg adds, 0 for other orders
+    quantity_t peak = 0;
+
+    ModifyOrder modifications() const
+    {
+        ModifyOrder mods;
+        if (quantity != badValues::quantity)
+            mods.quantity = quantity;
+        if (price != badValues::price)
+            mods.price = price;
+        if (side != Side::Bad)
+            mods.side = side;
+        if (type != OrderType::Bad)
+            mods.type = type;
+        return mods;
+    }
+};
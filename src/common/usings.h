@@ -7,8 +7,12 @@
 // TODO: make custom types that will have predictable bad values and other things
 using price_t = std::int32_t;
 using quantity_t = std::uint32_t;
+// price * quantity, e.g. the cost of sweeping several levels
+using notional_t = std::int64_t;
 using orderId_t = std::uint64_t;
 using orderIds_t = std::vector<orderId_t>;
+// Dense id of a traded symbol, every instrument has its own book and order ids
+using instrumentId_t = std::uint16_t;
 using microsec_t = std::chrono::microseconds;
 
 using userId_t = std::uint64_t;
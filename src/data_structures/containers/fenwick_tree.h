@@ -0,0 +1,67 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+// Binary indexed tree over a fixed number of values. Adding to a value and
+// summing a prefix both touch O(log n) nodes, lower_bound descends the tree
+// once. Values must stay non-negative for lower_bound to be meaningful
+template <typename T>
+class fenwick_tree
+{
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit fenwick_tree(size_t size = 0) : tree_(size + 1, T{}) {}
+
+    // Builds the tree from the given values in O(n)
+    explicit fenwick_tree(const std::vector<T>& values) : tree_(values.size() + 1, T{})
+    {
+        for (size_t i = 1; i < tree_.size(); ++i) {
+            tree_[i] += values[i - 1];
+            size_t parent = i + (i & (~i + 1));
+            if (parent < tree_.size())
+                tree_[parent] += tree_[i];
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return tree_.size() - 1; }
+    [[nodiscard]] size_t memory_bytes() const { return tree_.capacity() * sizeof(T); }
+
+    void add(size_t i, T delta)
+    {
+        for (++i; i < tree_.size(); i += i & (~i + 1))
+            tree_[i] += delta;
+    }
+
+    // Sum of values [0, i]
+    [[nodiscard]] T prefix_sum(size_t i) const
+    {
+        T sum{};
+        for (++i; i > 0; i -= i & (~i + 1))
+            sum += tree_[i];
+        return sum;
+    }
+
+    // Sum of every value
+    [[nodiscard]] T total() const { return size() == 0 ? T{} : prefix_sum(size() - 1); }
+
+    // Smallest i with prefix_sum(i) >= target, npos if the total is smaller
+    [[nodiscard]] size_t lower_bound(T target) const
+    {
+        if (target <= T{})
+            return size() == 0 ? npos : 0;
+
+        size_t pos = 0;
+        for (size_t step = std::bit_floor(size()); step > 0; step /= 2) {
+            if (pos + step < tree_.size() && tree_[pos + step] < target) {
+                pos += step;
+                target -= tree_[pos];
+            }
+        }
+        return pos < size() ? pos : npos;
+    }
+
+private:
+    std::vector<T> tree_; // 1-based, tree_[0] is unused
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bitset with summary layers on top: bit i of a word in layer k+1 is set iff
+// word i of layer k is non-zero. Finding the first/last/next set bit walks up
+// until a layer has a candidate and back down, so every query is a handful of
+// countr_zero / countl_zero calls no matter how sparse the bitset is
+class hierarchical_bitmap
+{
+public:
+    using word_type = std::uint64_t;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t word_bits = 64;
+
+    explicit hierarchical_bitmap(size_t bits = 0) { resize(bits); }
+
+    // Clears every bit
+    void resize(size_t bits)
+    {
+        size_ = bits;
+        layers_.clear();
+
+        size_t words = (bits + word_bits - 1) / word_bits;
+        do {
+            words = words == 0 ? 1 : words;
+            layers_.emplace_back(words, 0);
+            words = (words + word_bits - 1) / word_bits;
+        } while (layers_.back().size() > 1);
+    }
+
+    [[nodiscard]] size_t size() const { return size_; }
+    // Heap bytes of every layer
+    [[nodiscard]] size_t memory_bytes() const
+    {
+        size_t bytes = layers_.capacity() * sizeof(layers_[0]);
+        for (const auto& layer : layers_)
+            bytes += layer.capacity() * sizeof(word_type);
+        return bytes;
+    }
+    [[nodiscard]] bool none() const { return layers_.back()[0] == 0; }
+    [[nodiscard]] bool test(size_t i) const { return (layers_[0][i / word_bits] >> (i % word_bits)) & 1; }
+
+    void set(size_t i)
+    {
+        for (auto& layer : layers_) {
+            word_type& word = layer[i / word_bits];
+            bool wasEmpty = word == 0;
+            word |= word_type{1} << (i % word_bits);
+            if (!wasEmpty)
+                return;
+            i /= word_bits;
+        }
+    }
+
+    void reset(size_t i)
+    {
+        for (auto& layer : layers_) {
+            word_type& word = layer[i / word_bits];
+            word &= ~(word_type{1} << (i % word_bits));
+            if (word != 0)
+                return;
+            i /= word_bits;
+        }
+    }
+
+    [[nodiscard]] size_t find_first() const { return none() ? npos : descend_first(layers_.size() - 1, 0); }
+    [[nodiscard]] size_t find_last() const { return none() ? npos : descend_last(layers_.size() - 1, 0); }
+
+    // First set bit with index >= i
+    [[nodiscard]] size_t find_next(size_t i) const
+    {
+        if (i >= size_)
+            return npos;
+
+        for (size_t layer = 0; layer < layers_.size(); ++layer) {
+            size_t wordIdx = i / word_bits;
+            if (wordIdx >= layers_[layer].size())
+                return npos;
+
+            word_type word = layers_[layer][wordIdx] & (~word_type{0} << (i % word_bits));
+            if (word != 0) {
+                size_t found = wordIdx * word_bits + std::countr_zero(word);
+                return layer == 0 ? found : descend_first(layer - 1, found);
+            }
+
+            // Nothing left in this word, continue from the next word one layer up
+            i = wordIdx + 1;
+        }
+        return npos;
+    }
+
+    // Last set bit with index <= i
+    [[nodiscard]] size_t find_prev(size_t i) const
+    {
+        if (size_ == 0)
+            return npos;
+        if (i >= size_)
+            i = size_ - 1;
+
+        for (size_t layer = 0; layer < layers_.size(); ++layer) {
+            size_t wordIdx = i / word_bits;
+            size_t shift = word_bits - 1 - i % word_bits;
+            word_type word = layers_[layer][wordIdx] & (~word_type{0} >> shift);
+            if (word != 0) {
+                size_t found = wordIdx * word_bits + word_bits - 1 - std::countl_zero(word);
+                return layer == 0 ? found : descend_last(layer - 1, found);
+            }
+
+            // Nothing left in this word, continue from the previous word one layer up
+            if (wordIdx == 0)
+                return npos;
+            i = wordIdx - 1;
+        }
+        return npos;
+    }
+
+private:
+    size_t size_{0};
+    std::vector<std::vector<word_type>> layers_; // layers_[0] holds the actual bits
+
+    // Lowest set bit below word `wordIdx` of `layer`, which must be non-zero
+    size_t descend_first(size_t layer, size_t wordIdx) const
+    {
+        while (true) {
+            size_t bit = wordIdx * word_bits + std::countr_zero(layers_[layer][wordIdx]);
+            if (layer == 0)
+                return bit;
+            wordIdx = bit;
+            layer--;
+        }
+    }
+
+    size_t descend_last(size_t layer, size_t wordIdx) const
+    {
+        while (true) {
+            size_t bit = wordIdx * word_bits + word_bits - 1 - std::countl_zero(layers_[layer][wordIdx]);
+            if (layer == 0)
+                return bit;
+            wordIdx = bit;
+            layer--;
+        }
+    }
+};
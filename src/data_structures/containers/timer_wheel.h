@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel: level k has 64 slots of 64^k ticks each. An entry
+// sits at the highest level where its time and now() differ, in the slot of its
+// time's digit at that level. advance() jumps from one occupied slot to the next
+// with a bitmask per level. A slot that ends before the target time fires as a
+// whole, one that is only reached partially is cascaded a level down, so
+// inserting is O(1) and every entry is moved at most once per level no matter
+// how far it is in the future.
+// Entries can not be removed, owners skip the ones that became stale when they fire
+template <typename T>
+class timer_wheel
+{
+public:
+    using time_type = std::uint64_t;
+    static constexpr size_t slot_bits = 6;
+    static constexpr size_t slots = 1ull << slot_bits;
+    static constexpr size_t levels = (64 + slot_bits - 1) / slot_bits;
+
+    explicit timer_wheel(time_type now = 0) : now_{now}, slots_(levels * slots) {}
+
+    [[nodiscard]] time_type now() const { return now_; }
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    // Heap bytes of the slots and buffers, slots keep their capacity once they fired
+    [[nodiscard]] size_t memory_bytes() const
+    {
+        size_t bytes = slots_.capacity() * sizeof(slots_[0]) + due_.capacity() * sizeof(T) +
+                       cascading_.capacity() * sizeof(Entry);
+        for (const auto& slot : slots_)
+            bytes += slot.capacity() * sizeof(Entry);
+        return bytes;
+    }
+
+    // Entries at or before now() fire on the next advance()
+    void insert(time_type time, T value)
+    {
+        size_++;
+        if (time <= now_)
+            due_.push_back(std::move(value));
+        else
+            place(Entry{time, std::move(value)});
+    }
+
+    // Calls fn(value) for every entry with time <= `to` and moves now() to `to`.
+    // Slots fire in time order, the entries of a slot that fires as a whole are
+    // not sorted. fn must not insert into the wheel
+    template <typename Fn>
+    void advance(time_type to, Fn&& fn)
+    {
+        for (auto& value : due_)
+            fn(value);
+        size_ -= due_.size();
+        due_.clear();
+
+        while (now_ < to) {
+            size_t level = 0;
+            uint64_t mask = 0;
+            for (; level < levels; ++level) {
+                mask = occupied_[level] & above(digit(now_, level));
+                if (mask != 0)
+                    break;
+            }
+            if (level == levels) {
+                now_ = to;
+                return;
+            }
+
+            size_t slot = static_cast<size_t>(std::countr_zero(mask));
+            time_type start = blockStart(now_, level + 1) | (static_cast<time_type>(slot) << (level * slot_bits));
+            time_type end = start + ((time_type{1} << (level * slot_bits)) - 1);
+            if (start > to) {
+                now_ = to;
+                return;
+            }
+
+            occupied_[level] &= ~(uint64_t{1} << slot);
+            auto& entries = slots_[level * slots + slot];
+            if (end <= to) {
+                now_ = end;
+                for (auto& entry : entries)
+                    fn(entry.value);
+                size_ -= entries.size();
+                entries.clear();
+                continue;
+            }
+
+            now_ = start;
+            std::swap(cascading_, entries);
+            for (auto& entry : cascading_) {
+                if (entry.time == now_) {
+                    fn(entry.value);
+                    size_--;
+                } else {
+                    place(std::move(entry));
+                }
+            }
+            cascading_.clear();
+        }
+    }
+
+private:
+    struct Entry {
+        time_type time;
+        T value;
+    };
+
+    time_type now_;
+    std::vector<std::vector<Entry>> slots_; // levels * slots, level major
+    std::array<uint64_t, levels> occupied_{};
+    std::vector<T> due_;
+    std::vector<Entry> cascading_;
+    size_t size_{0};
+
+    static size_t digit(time_type time, size_t level) { return (time >> (level * slot_bits)) & (slots - 1); }
+    // Slots after `digit`
+    static uint64_t above(size_t digit) { return digit + 1 == slots ? 0 : ~uint64_t{0} << (digit + 1); }
+    // `time` with every digit below `level` cleared
+    static time_type blockStart(time_type time, size_t level)
+    {
+        size_t bits = level * slot_bits;
+        return bits >= 64 ? 0 : time >> bits << bits;
+    }
+
+    // time must be after now_
+    void place(Entry entry)
+    {
+        size_t level = static_cast<size_t>(63 - std::countl_zero(entry.time ^ now_)) / slot_bits;
+        size_t slot = digit(entry.time, level);
+        slots_[level * slots + slot].push_back(std::move(entry));
+        occupied_[level] |= uint64_t{1} << slot;
+    }
+};
@@ -0,0 +1,67 @@
+#include "arena.h"
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace
+{
+    constexpr size_t smallPageSize = 4096;
+
+    size_t roundUp(size_t value, size_t to) { return (value + to - 1) / to * to; }
+} // namespace
+
+PageArena::PageArena(size_t bytes, PageBacking backing, bool prefault, bool lock) noexcept
+{
+    if (bytes == 0)
+        return;
+    size_t capacity = roundUp(bytes, hugePageSize);
+
+    if (backing == PageBacking::Huge) {
+        void* data =
+            ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED) {
+            mapping_ = data;
+            mappingBytes_ = capacity;
+            begin_ = static_cast<std::byte*>(data);
+        } else {
+            backing = PageBacking::Transparent;
+        }
+    }
+
+    if (mapping_ == nullptr) {
+        // One huge page more than needed, so the arena can start on a 2MB
+        // boundary and the kernel can back all of it with huge pages
+        size_t mappingBytes = capacity + hugePageSize;
+        void* data = ::mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            return;
+        mapping_ = data;
+        mappingBytes_ = mappingBytes;
+        begin_ = reinterpret_cast<std::byte*>(roundUp(reinterpret_cast<std::uintptr_t>(data), hugePageSize));
+        // Small asks for 4K pages even where THP is enabled for every mapping.
+        // If the advice is refused the kernel's default applies
+        ::madvise(begin_, capacity, backing == PageBacking::Small ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+    }
+    capacity_ = capacity;
+    backing_ = backing;
+
+    if (prefault)
+        for (size_t offset = 0; offset < capacity_; offset += smallPageSize)
+            begin_[offset] = std::byte{0};
+    if (lock)
+        locked_ = ::mlock(begin_, capacity_) == 0;
+}
+
+PageArena::~PageArena()
+{
+    if (mapping_ != nullptr)
+        ::munmap(mapping_, mappingBytes_);
+}
+
+void* PageArena::allocate(size_t bytes, size_t align) noexcept
+{
+    size_t offset = roundUp(used_, align);
+    if (offset > capacity_ || capacity_ - offset < bytes)
+        return nullptr;
+    used_ = offset + bytes;
+    return begin_ + offset;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Pages backing a PageArena
+enum class PageBacking : std::uint8_t {
+    // Regular 4K pages
+    Small,
+    // 4K pages the kernel may merge into 2MB ones (madvise(MADV_HUGEPAGE))
+    Transparent,
+    // 2MB pages from the hugetlb pool (MAP_HUGETLB), Transparent if none are reserved
+    Huge,
+};
+
+constexpr std::string_view toString(PageBacking backing)
+{
+    switch (backing) {
+    case PageBacking::Small:
+        return "4K";
+    case PageBacking::Transparent:
+        return "transparent huge";
+    case PageBacking::Huge:
+        return "huge";
+    }
+    return "unknown";
+}
+
+// Book storage placed in one arena, see BasicOrderbook(const StorageOptions&)
+struct StorageOptions {
+    // Resting orders the arena is sized for, the book keeps working past it
+    // with storage from the heap
+    size_t orders{0};
+    PageBacking backing{PageBacking::Small};
+    // Touches every page up front, so growing the book into the arena does not fault
+    bool prefault{false};
+    // mlock()s the arena, it stays unlocked if RLIMIT_MEMLOCK is too low
+    bool lock{false};
+};
+
+// One anonymous mapping handed out front to back. Blocks are never given back
+// on their own, the mapping is unmapped with the arena. Meant for the pools of
+// the book, which keep their pages until they are destroyed.
+// Nothing throws: if the mapping fails the arena is empty and allocate()
+// returns nullptr, callers then fall back to the heap
+class PageArena
+{
+public:
+    static constexpr size_t hugePageSize = 2ull << 20;
+
+    PageArena() = default;
+    // `bytes` is rounded up to whole 2MB pages
+    PageArena(size_t bytes, PageBacking backing, bool prefault = false, bool lock = false) noexcept;
+    ~PageArena();
+    PageArena(const PageArena&) = delete;
+    PageArena& operator=(const PageArena&) = delete;
+
+    // nullptr once the arena is full. `align` must be a power of two up to 2MB
+    void* allocate(size_t bytes, size_t align) noexcept;
+    bool owns(const void* ptr) const noexcept
+    {
+        auto p = static_cast<const std::byte*>(ptr);
+        return p >= begin_ && p < begin_ + capacity_;
+    }
+
+    size_t capacity() const noexcept { return capacity_; }
+    size_t used() const noexcept { return used_; }
+    // What the mapping got, Huge falls back to Transparent
+    PageBacking backing() const noexcept { return backing_; }
+    bool locked() const noexcept { return locked_; }
+
+private:
+    void* mapping_{nullptr};
+    size_t mappingBytes_{0};
+    std::byte* begin_{nullptr};
+    size_t capacity_{0};
+    size_t used_{0};
+    PageBacking backing_{PageBacking::Small};
+    bool locked_{false};
+};
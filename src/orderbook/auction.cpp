@@ -0,0 +1,69 @@
+#include "auction.h"
+#include <algorithm>
+#include <limits>
+
+// Compiled for the default target, AVX2 and AVX-512, the loader picks the best
+// copy the CPU runs. Baseline x86-64 can not compare 64 bit integers in vector
+// registers and AVX2 has to emulate 64 bit min and max, AVX-512 has both
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ORDERBOOK_SCAN_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define ORDERBOOK_SCAN_CLONES
+#endif
+
+namespace
+{
+    // The passes below are min and max reductions, which the compiler only
+    // vectorises without branches in the loop. Candidates a pass skips are
+    // masked to the largest value instead
+    constexpr int64_t noImbalance = std::numeric_limits<int64_t>::max();
+    constexpr uint64_t noKey = std::numeric_limits<uint64_t>::max();
+
+    struct Best {
+        size_t idx;
+        int64_t volume;
+    };
+
+    ORDERBOOK_SCAN_CLONES Best bestCandidate(const price_t* prices, const int64_t* asks, const int64_t* bids,
+                                             size_t count, int64_t reference)
+    {
+        int64_t volume = 0;
+        for (size_t i = 0; i < count; ++i) {
+            int64_t ask = asks[i], bid = bids[i];
+            volume = std::max(volume, std::min(ask, bid));
+        }
+
+        int64_t imbalance = noImbalance;
+        for (size_t i = 0; i < count; ++i) {
+            int64_t ask = asks[i], bid = bids[i];
+            int64_t skip = static_cast<int64_t>(std::min(ask, bid) == volume) - 1;
+            imbalance = std::min(imbalance, (std::max(ask, bid) - std::min(ask, bid)) | (skip & noImbalance));
+        }
+
+        // Distance to the reference in the high half and the index in the low
+        // half, the smallest key is the closest and, of equally close ones, the first
+        uint64_t key = noKey;
+        for (size_t i = 0; i < count; ++i) {
+            int64_t ask = asks[i], bid = bids[i];
+            bool kept = std::min(ask, bid) == volume && std::max(ask, bid) - std::min(ask, bid) == imbalance;
+            int64_t offset = static_cast<int64_t>(prices[i]) - reference;
+            uint64_t distance = static_cast<uint64_t>(offset < 0 ? -offset : offset);
+            key = std::min(key, ((distance << 32) | i) | (static_cast<uint64_t>(kept) - 1));
+        }
+        return Best{.idx = static_cast<size_t>(key & 0xffff'ffff), .volume = volume};
+    }
+} // namespace
+
+std::optional<Equilibrium> AuctionSearch::pick(std::optional<price_t> reference) const noexcept
+{
+    if (prices_.empty())
+        return std::nullopt;
+
+    Best best = bestCandidate(prices_.data(), asks_.data(), bids_.data(), prices_.size(),
+                              reference.value_or(std::numeric_limits<price_t>::min()));
+    if (best.volume == 0)
+        return std::nullopt;
+    return Equilibrium{.price = prices_[best.idx],
+                       .volume = static_cast<uint64_t>(best.volume),
+                       .imbalance = bids_[best.idx] - asks_[best.idx]};
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "memoryStats.h"
+#include "usings.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Price at which a call auction uncrosses the book (see BasicOrderbook::uncross)
+struct Equilibrium {
+    price_t price;
+    // Volume that trades at `price`
+    uint64_t volume;
+    // Bid volume at or above `price` minus ask volume at or below it, the part of
+    // the larger side that is left after the uncross
+    int64_t imbalance;
+};
+
+// Equilibrium search of a crossed book. The caller fills one entry per candidate
+// price, lowest price first: the price, the ask volume at or below it and the
+// bid volume at or above it. pick() keeps
+//   - the candidates with the most executable volume (the smaller of the two),
+//   - of those the ones with the smallest imbalance,
+//   - of those the one closest to `reference`, the lowest one if there is none
+//     or two are as close.
+// Every step is one branch free pass over the arrays (see auction.cpp), so at
+// most 2^32 candidates. Volumes are signed like DepthIndex's, the passes
+// compare them in vector registers. The arrays keep their capacity between searches
+class AuctionSearch
+{
+public:
+    void resize(size_t candidates)
+    {
+        prices_.resize(candidates);
+        asks_.resize(candidates);
+        bids_.resize(candidates);
+    }
+    size_t size() const { return prices_.size(); }
+    std::span<price_t> prices() { return prices_; }
+    std::span<int64_t> asks() { return asks_; }
+    std::span<int64_t> bids() { return bids_; }
+    size_t memoryBytes() const
+    {
+        return heapBytes::vector(prices_) + heapBytes::vector(asks_) + heapBytes::vector(bids_);
+    }
+
+    // Empty if no candidate has executable volume
+    std::optional<Equilibrium> pick(std::optional<price_t> reference) const noexcept;
+
+private:
+    std::vector<price_t> prices_;
+    std::vector<int64_t> asks_;
+    std::vector<int64_t> bids_;
+};
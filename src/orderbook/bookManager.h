@@ -0,0 +1,96 @@
+#pragma once
+
+#include "orderbook.h"
+#include "types.h"
+#include "usings.h"
+#include <memory>
+#include <span>
+#include <vector>
+
+// Owns one book per instrument and routes commands to them by
+// Command::instrument. Instrument ids are small and dense, books are kept in a
+// vector indexed by the id and created when the first command for them arrives.
+//
+// A manager can be restricted to one shard of the instruments
+// (id % shardCount == shard). Every engine thread runs its own manager over a
+// different shard and the feed is split with shardOf(), so the books of a thread
+// are never touched by another one and matching needs no locks. Commands for
+// instruments outside of the shard are rejected
+template <typename Book>
+class BookManager
+{
+public:
+    explicit BookManager(size_t shard = 0, size_t shardCount = 1)
+        : shard_{shard}
+        , shardCount_{shardCount}
+    {
+    }
+
+    static size_t shardOf(instrumentId_t instrument, size_t shardCount) { return instrument % shardCount; }
+    bool owns(instrumentId_t instrument) const { return shardOf(instrument, shardCount_) == shard_; }
+
+    // Number of books created so far
+    size_t size() const { return count_; }
+
+    // nullptr if no command reached this instrument yet
+    Book* find(instrumentId_t instrument) const
+    {
+        return instrument < books_.size() ? books_[instrument].get() : nullptr;
+    }
+
+    // Finds or creates the book, the instrument must be owned by this manager
+    Book& book(instrumentId_t instrument)
+    {
+        if (instrument >= books_.size())
+            books_.resize(instrument + 1);
+        if (!books_[instrument]) {
+            books_[instrument] = std::make_unique<Book>();
+            count_++;
+        }
+        return *books_[instrument];
+    }
+
+    // Visits fn(instrument, book) for every book created so far
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (size_t instrument = 0; instrument < books_.size(); ++instrument)
+            if (books_[instrument])
+                fn(static_cast<instrumentId_t>(instrument), *books_[instrument]);
+    }
+
+    template <typename Sink>
+    void process(const Command& command, Sink& sink)
+    {
+        process(std::span<const Command>{&command, 1}, sink);
+    }
+
+    // Consecutive commands for the same instrument are handed to its book as
+    // one batch, see BasicOrderbook::process
+    template <typename Sink>
+    void process(std::span<const Command> commands, Sink& sink)
+    {
+        size_t first = 0;
+        while (first < commands.size()) {
+            instrumentId_t instrument = commands[first].instrument;
+            size_t last = first + 1;
+            while (last < commands.size() && commands[last].instrument == instrument)
+                last++;
+
+            auto run = commands.subspan(first, last - first);
+            if (owns(instrument))
+                book(instrument).process(run, sink);
+            else
+                // Adds have no id yet, like refused adds of the book they report 0
+                for (const auto& command : run)
+                    sink.onReject(command.action == Actions::ADD ? 0 : command.oid, RejectReason::UnknownInstrument);
+            first = last;
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Book>> books_;
+    size_t count_{0};
+    size_t shard_;
+    size_t shardCount_;
+};
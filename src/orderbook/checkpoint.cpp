@@ -0,0 +1,67 @@
+#include "checkpoint.h"
+#include <cerrno>
+#include <sys/wait.h>
+
+Checkpoint::Checkpoint(pid_t pid, std::uint64_t journalSequence, Journal* journal) noexcept
+    : pid_{pid}
+    , journalSequence_{journalSequence}
+    , journal_{journal}
+{
+    if (pid_ < 0)
+        result_ = SnapshotError::Io;
+}
+
+Checkpoint::Checkpoint(Checkpoint&& other) noexcept
+    : pid_{other.pid_}
+    , journalSequence_{other.journalSequence_}
+    , journal_{other.journal_}
+    , result_{other.result_}
+{
+    other.pid_ = -1;
+}
+
+Checkpoint::~Checkpoint()
+{
+    wait();
+}
+
+bool Checkpoint::done() noexcept
+{
+    if (pid_ <= 0)
+        return true;
+
+    int status = 0;
+    pid_t exited = ::waitpid(pid_, &status, WNOHANG);
+    if (exited == 0)
+        return false;
+    finish(exited == pid_ ? status : -1);
+    return true;
+}
+
+SnapshotError Checkpoint::wait() noexcept
+{
+    if (pid_ <= 0)
+        return result_;
+
+    int status = 0;
+    pid_t exited;
+    do {
+        exited = ::waitpid(pid_, &status, 0);
+    } while (exited < 0 && errno == EINTR);
+    finish(exited == pid_ ? status : -1);
+    return result_;
+}
+
+// status of the exited child, -1 if it could not be collected
+void Checkpoint::finish(int status) noexcept
+{
+    pid_ = -1;
+    if (status == -1 || !WIFEXITED(status))
+        result_ = SnapshotError::Io;
+    else
+        result_ = static_cast<SnapshotError>(WEXITSTATUS(status));
+
+    // The snapshot holds everything up to journalSequence_, the journal does not need it anymore
+    if (result_ == SnapshotError::None && journal_ != nullptr)
+        journal_->truncate(journalSequence_);
+}
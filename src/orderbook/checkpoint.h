@@ -0,0 +1,74 @@
+#pragma once
+
+#include "journal.h"
+#include "snapshot.h"
+#include <cstdint>
+#include <filesystem>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Snapshot of a book taken without stopping it: start() forks the process and
+// the child writes the snapshot from its copy of the book while the parent
+// keeps matching. The kernel shares the memory of both processes copy-on-write,
+// so the parent only pauses for fork() (copying the page tables) and pays for
+// the pages it changes while the child is still writing.
+// The snapshot records the last journal entry applied to the book. Once it is
+// complete the journal is truncated up to that entry, recovery loads the
+// snapshot and replays JournalReader::entriesAfter(journalSequence).
+// The child only saves the snapshot and leaves with _exit, it does not touch
+// the journal or anything else the parent's threads own.
+// Other threads (e.g. the journal writer) may hold the allocator's or stdio's
+// locks at the fork, and the child only gets a copy of the thread that forked,
+// so it must stick to async-signal-safe calls: the paths and the write buffer
+// are prepared before fork(), the child walks the book without allocating and
+// writes with open, write, fsync and rename (see SnapshotWriter)
+class Checkpoint
+{
+public:
+    // Checkpoint of `book` as of the last entry appended to `journal`
+    template <typename Book>
+    static Checkpoint start(const Book& book, const std::filesystem::path& path, Journal& journal) noexcept
+    {
+        std::uint64_t sequence = journal.lastSequence();
+        SnapshotWriter writer{path};
+        pid_t pid = ::fork();
+        if (pid == 0)
+            ::_exit(static_cast<int>(book.saveSnapshot(writer, sequence)));
+        return Checkpoint{pid, sequence, &journal};
+    }
+
+    // Checkpoint of a book that is not journaled
+    template <typename Book>
+    static Checkpoint start(const Book& book, const std::filesystem::path& path) noexcept
+    {
+        SnapshotWriter writer{path};
+        pid_t pid = ::fork();
+        if (pid == 0)
+            ::_exit(static_cast<int>(book.saveSnapshot(writer)));
+        return Checkpoint{pid, 0, nullptr};
+    }
+
+    // Waits for a child that is still writing
+    ~Checkpoint();
+    Checkpoint(Checkpoint&& other) noexcept;
+    Checkpoint& operator=(Checkpoint&&) = delete;
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    // True once the child has exited, result() is then final. Does not block
+    bool done() noexcept;
+    // Blocks until the child has exited
+    SnapshotError wait() noexcept;
+    // Io if the process could not be forked or the child did not exit normally
+    SnapshotError result() const noexcept { return result_; }
+    std::uint64_t journalSequence() const noexcept { return journalSequence_; }
+
+private:
+    pid_t pid_;
+    std::uint64_t journalSequence_;
+    Journal* journal_;
+    SnapshotError result_{SnapshotError::None};
+
+    Checkpoint(pid_t pid, std::uint64_t journalSequence, Journal* journal) noexcept;
+    void finish(int status) noexcept;
+};
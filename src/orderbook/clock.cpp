@@ -0,0 +1,45 @@
+#include "clock.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ORDERBOOK_HAS_TSC 1
+#else
+#define ORDERBOOK_HAS_TSC 0
+#endif
+
+uint64_t TscClock::cycles() noexcept
+{
+#if ORDERBOOK_HAS_TSC
+    return __rdtsc();
+#else
+    // Without a TSC a "cycle" is a steady_clock nanosecond
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+static double calibrate() noexcept
+{
+#if ORDERBOOK_HAS_TSC
+    using namespace std::chrono;
+    constexpr auto window = milliseconds{10};
+
+    auto startTime = steady_clock::now();
+    uint64_t startCycles = TscClock::cycles();
+    auto endTime = startTime;
+    while (endTime - startTime < window)
+        endTime = steady_clock::now();
+    uint64_t endCycles = TscClock::cycles();
+
+    auto elapsed = duration_cast<duration<double, std::micro>>(endTime - startTime).count();
+    return static_cast<double>(endCycles - startCycles) / elapsed;
+#else
+    using period = std::chrono::steady_clock::period;
+    return static_cast<double>(period::den) / period::num / 1'000'000.0;
+#endif
+}
+
+double TscClock::cyclesPerMicrosecond() noexcept
+{
+    static const double rate = calibrate();
+    return rate;
+}
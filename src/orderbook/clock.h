@@ -0,0 +1,63 @@
+#pragma once
+
+#include "usings.h"
+#include <chrono>
+#include <cstdint>
+
+// Time sources the book stamps new orders with. A clock is any type with
+// `microsec_t now() noexcept`, the book owns one instance and exposes it through
+// clock(), so a clock that has to be driven from outside (ManualClock) can be.
+
+// Wall clock read on every call, a vDSO call at best and a syscall under some
+// clocksources
+struct SystemClock {
+    microsec_t now() const noexcept
+    {
+        return std::chrono::duration_cast<microsec_t>(std::chrono::system_clock::now().time_since_epoch());
+    }
+};
+
+// Reads the CPU timestamp counter and converts the cycles elapsed since
+// construction with a rate measured once per process (see cyclesPerMicrosecond).
+// The system clock is read once at construction, so the values are comparable
+// with SystemClock but drift from it over hours. Needs an invariant TSC, which
+// every x86 CPU of the last decade has. On other architectures it falls back to
+// steady_clock
+class TscClock
+{
+public:
+    TscClock() noexcept
+        : baseTime_{SystemClock{}.now()}
+        , baseCycles_{cycles()}
+        , microsPerCycle_{1.0 / cyclesPerMicrosecond()}
+    {
+    }
+
+    microsec_t now() const noexcept
+    {
+        auto elapsed = static_cast<double>(cycles() - baseCycles_) * microsPerCycle_;
+        return baseTime_ + microsec_t{static_cast<int64_t>(elapsed)};
+    }
+
+    static uint64_t cycles() noexcept;
+    // Measured against steady_clock on the first call (about 10ms), cached after
+    static double cyclesPerMicrosecond() noexcept;
+
+private:
+    microsec_t baseTime_;
+    uint64_t baseCycles_;
+    double microsPerCycle_;
+};
+
+// Only moves when told to. Replays drive it from the command stream so that two
+// runs over the same input produce the same book, tests use it to control time
+class ManualClock
+{
+public:
+    microsec_t now() const noexcept { return now_; }
+    void set(microsec_t time) noexcept { now_ = time; }
+    void advance(microsec_t delta) noexcept { now_ += delta; }
+
+private:
+    microsec_t now_{0};
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "fenwick_tree.h"
+#include "memoryStats.h"
+#include "types.h"
+#include "usings.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Cumulative resting volume of one side of the book, kept in two Fenwick trees
+// (volume and price * volume) over a window of ticks. Index 0 is the best end of
+// the window: the lowest price for asks, the highest for bids, so a prefix is
+// "at this price or better". Adding, removing and both queries are O(log window).
+//
+// The window is moved (and doubled when needed) when a price outside of it is
+// added while everything resting is inside. If a price does not fit into
+// maxWindow, or the window can not move because other volume already lies
+// outside, its volume is only counted in outsideVolume_ and the index stops
+// being exact until that volume is gone. Callers fall back to walking the levels
+// while exact() is false
+class DepthIndex
+{
+public:
+    static constexpr size_t defaultWindow = 1ull << 12;
+    static constexpr size_t maxWindow = 1ull << 20;
+
+    explicit DepthIndex(Side side, size_t window = defaultWindow)
+        : side_{side}
+        , volume_(std::bit_ceil(std::max<size_t>(window, 1)), 0)
+        , volumeTree_{volume_.size()}
+        , notionalTree_{volume_.size()}
+    {
+    }
+
+    bool exact() const { return outsideVolume_ == 0; }
+    size_t window() const { return volume_.size(); }
+    size_t memoryBytes() const
+    {
+        return heapBytes::vector(volume_) + volumeTree_.memory_bytes() + notionalTree_.memory_bytes();
+    }
+
+    void add(price_t price, quantity_t quantity)
+    {
+        int64_t idx = toIdx(price);
+        if (!inWindow(idx)) {
+            if (!exact() || !recenter(price)) {
+                outsideVolume_ += quantity;
+                return;
+            }
+            idx = toIdx(price);
+        }
+        update(static_cast<size_t>(idx), price, static_cast<int64_t>(quantity));
+    }
+
+    // `price` must have been added with at least `quantity` before
+    void remove(price_t price, quantity_t quantity)
+    {
+        int64_t idx = toIdx(price);
+        if (!inWindow(idx)) {
+            outsideVolume_ -= quantity;
+            return;
+        }
+        update(static_cast<size_t>(idx), price, -static_cast<int64_t>(quantity));
+    }
+
+    // Volume resting at `price` or better, only valid while exact()
+    uint64_t volumeUpTo(price_t price) const
+    {
+        int64_t idx = toIdx(price);
+        if (idx < 0)
+            return 0;
+        return volumeTree_.prefix_sum(std::min<size_t>(static_cast<size_t>(idx), window() - 1));
+    }
+
+    // Price * quantity of taking `quantity` from the best level onwards, empty if
+    // the side holds less. Only valid while exact()
+    std::optional<notional_t> costToFill(uint64_t quantity) const
+    {
+        size_t idx = volumeTree_.lower_bound(static_cast<int64_t>(quantity));
+        if (idx == fenwick_tree<int64_t>::npos)
+            return std::nullopt;
+        if (idx == 0)
+            return static_cast<notional_t>(quantity) * toPrice(0);
+
+        uint64_t volumeBefore = volumeTree_.prefix_sum(idx - 1);
+        notional_t costBefore = notionalTree_.prefix_sum(idx - 1);
+        return costBefore + static_cast<notional_t>(quantity - volumeBefore) * toPrice(idx);
+    }
+
+    // Volume at every tick from `best` to `worst` (a price at or behind it), best
+    // first. Empty unless exact() and both prices lie inside the window
+    std::span<const int64_t> ticks(price_t best, price_t worst) const
+    {
+        int64_t first = toIdx(best);
+        int64_t last = toIdx(worst);
+        if (!exact() || last < first || !inWindow(first) || !inWindow(last))
+            return {};
+        return std::span<const int64_t>{volume_}.subspan(static_cast<size_t>(first),
+                                                         static_cast<size_t>(last - first + 1));
+    }
+
+private:
+    Side side_;
+    // Price of index 0, the window covers origin_ upwards for asks and downwards for bids
+    int64_t origin_{0};
+    std::vector<int64_t> volume_;
+    fenwick_tree<int64_t> volumeTree_;
+    fenwick_tree<notional_t> notionalTree_;
+    uint64_t outsideVolume_{0};
+    size_t occupied_{0};
+
+    int64_t toIdx(price_t price) const { return side_ == Side::Sell ? price - origin_ : origin_ - price; }
+    price_t toPrice(size_t idx) const
+    {
+        int64_t offset = static_cast<int64_t>(idx);
+        return static_cast<price_t>(side_ == Side::Sell ? origin_ + offset : origin_ - offset);
+    }
+    bool inWindow(int64_t idx) const { return idx >= 0 && idx < static_cast<int64_t>(window()); }
+
+    void update(size_t idx, price_t price, int64_t delta)
+    {
+        if (volume_[idx] == 0)
+            occupied_++;
+        volume_[idx] += delta;
+        if (volume_[idx] == 0)
+            occupied_--;
+
+        volumeTree_.add(idx, delta);
+        notionalTree_.add(idx, delta * price);
+    }
+
+    // Moves the window so that it covers every occupied tick and `price`, leaving
+    // the same amount of free ticks on both ends. False if that needs more than maxWindow
+    bool recenter(price_t price)
+    {
+        int64_t low = price;
+        int64_t high = price;
+        if (occupied_ > 0) {
+            for (size_t idx = 0; idx < window(); ++idx) {
+                if (volume_[idx] != 0) {
+                    low = std::min<int64_t>(low, toPrice(idx));
+                    high = std::max<int64_t>(high, toPrice(idx));
+                }
+            }
+        }
+
+        size_t span = static_cast<size_t>(high - low + 1);
+        if (span > maxWindow)
+            return false;
+        size_t window = volume_.size();
+        while (window < 2 * span && window < maxWindow)
+            window *= 2;
+
+        int64_t padding = static_cast<int64_t>((window - span) / 2);
+        int64_t origin = side_ == Side::Sell ? low - padding : high + padding;
+
+        std::vector<int64_t> volume(window, 0);
+        std::vector<notional_t> notional(window, 0);
+        for (size_t idx = 0; idx < volume_.size(); ++idx) {
+            if (volume_[idx] == 0)
+                continue;
+            price_t levelPrice = toPrice(idx);
+            size_t newIdx = static_cast<size_t>(side_ == Side::Sell ? levelPrice - origin : origin - levelPrice);
+            volume[newIdx] = volume_[idx];
+            notional[newIdx] = volume_[idx] * levelPrice;
+        }
+
+        origin_ = origin;
+        volumeTree_ = fenwick_tree<int64_t>{volume};
+        notionalTree_ = fenwick_tree<notional_t>{notional};
+        volume_ = std::move(volume);
+        return true;
+    }
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "events.h"
+#include "orderbook.h"
+#include "types.h"
+#include "usings.h"
+#include <functional>
+#include <map>
+#include <span>
+
+// Copy of a book's depth kept by a market data consumer from the LevelUpdates
+// the book publishes (see LevelUpdateCollector). Applying an update is one map
+// operation, so following the book costs O(changes) per command instead of the
+// O(levels) copy of BasicOrderbook::fullDepth*.
+// Updates must be applied in sequence order, apply() refuses an update that
+// does not follow the last one and leaves the copy untouched, the consumer then
+// has to start over from a snapshot
+class DepthReplica
+{
+public:
+    bool apply(const LevelUpdate& update)
+    {
+        if (update.sequence != sequence_ + 1)
+            return false;
+        sequence_ = update.sequence;
+
+        if (update.side == Side::Sell)
+            set(ask_, update);
+        else
+            set(bid_, update);
+        return true;
+    }
+
+    // Stops at the first update that is out of sequence
+    bool apply(std::span<const LevelUpdate> updates)
+    {
+        for (const auto& update : updates)
+            if (!apply(update))
+                return false;
+        return true;
+    }
+
+    uint64_t sequence() const { return sequence_; }
+    levels_t fullDepthAsk() const { return depth(ask_); }
+    levels_t fullDepthBid() const { return depth(bid_); }
+
+private:
+    struct Level {
+        uint32_t volume;
+        uint32_t orderCnt;
+    };
+
+    // Best price first, as in the book
+    std::map<price_t, Level> ask_;
+    std::map<price_t, Level, std::greater<>> bid_;
+    uint64_t sequence_{0};
+
+    template <typename Map>
+    static void set(Map& side, const LevelUpdate& update)
+    {
+        if (update.orderCnt == 0)
+            side.erase(update.price);
+        else
+            side[update.price] = Level{.volume = update.volume, .orderCnt = update.orderCnt};
+    }
+
+    template <typename Map>
+    static levels_t depth(const Map& side)
+    {
+        levels_t levels;
+        levels.reserve(side.size());
+        for (const auto& [price, level] : side)
+            levels.push_back(LevelView{.price = price, .volume = level.volume, .orderCnt = level.orderCnt});
+        return levels;
+    }
+};
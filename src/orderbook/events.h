@@ -0,0 +1,146 @@
+#pragma once
+
+#include "trade.h"
+#include "types.h"
+#include "usings.h"
+#include <cstdint>
+#include <vector>
+
+struct OrderInfo {
+    price_t price;
+    quantity_t quantity;
+    Side side;
+    OrderType type;
+};
+
+// State of one price level after a command changed it, volume and orderCnt are
+// 0 if the level is gone. sequence grows by one with every update of a book,
+// so a consumer can tell that it missed one
+struct LevelUpdate {
+    uint64_t sequence;
+    price_t price;
+    uint32_t volume;
+    uint32_t orderCnt;
+    Side side;
+};
+
+enum class OrderEventType : std::uint8_t {
+    // Order started resting at the back of its level. An iceberg whose clip was
+    // filled gets Filled and then Added again with its next clip
+    Added,
+    // Part of the displayed quantity of a resting order traded
+    Executed,
+    // The rest of the displayed quantity traded, the order left its level
+    Filled,
+    // Resting order was cancelled, expired or replaced by a modify, quantity is
+    // what it still displayed
+    Cancelled,
+    // Displayed quantity of a resting order was lowered in place, it kept its
+    // queue position
+    Amended,
+};
+
+// Change to one resting order, the market by order (L3) view of the book.
+// Applied in sequence order they rebuild every level queue (see OrderReplica).
+// sequence grows by one with every event of a book, separately from the
+// LevelUpdate sequence
+struct OrderEvent {
+    uint64_t sequence;
+    orderId_t orderId;
+    price_t price;
+    // Added: displayed quantity, Executed and Filled: traded quantity,
+    // Cancelled: removed quantity, Amended: new displayed quantity
+    quantity_t quantity;
+    // Added only: number of orders ahead of this one at its level
+    uint32_t queuePosition;
+    OrderEventType type;
+    Side side;
+};
+
+// Base for execution listeners passed to the book. Every hook is an empty
+// inline function, a listener derives from EventSink and hides the hooks it
+// cares about. The book takes the listener type as a template parameter, so the
+// calls are resolved at compile time and hooks that are not hidden compile to
+// nothing. Hooks are called from noexcept book functions and must not throw.
+// EventSink on its own discards every event
+struct EventSink {
+    // Order passed the checks and is about to be matched
+    void onAccept(orderId_t, const OrderInfo&) {}
+    void onTrade(const Trade&) {}
+    // Resting order was cancelled, or the unfilled rest of an order that may
+    // not rest on the book (market, FAK) was dropped
+    void onCancel(orderId_t, quantity_t) {}
+    // Pending stop order reached its trigger and is about to be matched as the
+    // order in info (Market for Stop, GoodTillCancel for StopLimit orders)
+    void onTrigger(orderId_t, const OrderInfo&) {}
+    // Displayed clip of a resting iceberg order was filled, the next clip of
+    // `quantity` is shown and the order moved to the back of its level
+    void onRefresh(orderId_t, quantity_t) {}
+    // Resting order was changed in place and kept its id and queue position
+    void onAmend(orderId_t, const OrderInfo&) {}
+    // Command was refused without touching the book, orderId is the id of the
+    // refused order (0 for adds that failed validation)
+    void onReject(orderId_t, RejectReason) {}
+    // Sent after each change of a level, with its state at that point. One
+    // command can change a level more than once (a modify that re-adds at the
+    // same price, stops it triggers, an uncross), every change is sent
+    void onLevelChange(const LevelUpdate&) {}
+    // Sent for every change to a resting order, in the order they happen
+    void onOrderEvent(const OrderEvent&) {}
+};
+
+// Keeps the trades and the accepted (or amended) order info of the commands sent since the
+// last clear(). The trade buffer keeps its capacity, so reusing one collector
+// across commands does not allocate once it has seen the largest sweep
+class ExecutionCollector : public EventSink
+{
+public:
+    void onAccept(orderId_t, const OrderInfo& info) { info_ = info; }
+    void onAmend(orderId_t, const OrderInfo& info) { info_ = info; }
+    void onTrade(const Trade& trade) { trades_.push_back(trade); }
+
+    void clear()
+    {
+        trades_.clear();
+        info_ = {};
+    }
+    trades_t& trades() { return trades_; }
+    const trades_t& trades() const { return trades_; }
+    const OrderInfo& info() const { return info_; }
+
+private:
+    trades_t trades_;
+    OrderInfo info_{};
+};
+
+// Collects the level updates of the commands sent since the last clear(), the
+// batch a market data publisher sends after each command. Keeps its capacity
+// across clears like ExecutionCollector
+class LevelUpdateCollector : public EventSink
+{
+public:
+    void onLevelChange(const LevelUpdate& update) { updates_.push_back(update); }
+
+    void clear() { updates_.clear(); }
+    const std::vector<LevelUpdate>& updates() const { return updates_; }
+
+private:
+    std::vector<LevelUpdate> updates_;
+};
+
+// Collects the order events of the commands sent since the last clear(), the
+// batch a market by order publisher sends after each command. Reserve for the
+// largest batch up front and the book never allocates on its behalf
+class OrderEventCollector : public EventSink
+{
+public:
+    explicit OrderEventCollector(size_t capacity = 0) { events_.reserve(capacity); }
+
+    void onOrderEvent(const OrderEvent& event) { events_.push_back(event); }
+
+    void clear() { events_.clear(); }
+    const std::vector<OrderEvent>& events() const { return events_; }
+
+private:
+    std::vector<OrderEvent> events_;
+};
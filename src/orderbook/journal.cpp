@@ -0,0 +1,211 @@
+#include "journal.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <system_error>
+#include <unistd.h>
+
+std::uint32_t JournalEntry::computeChecksum() const noexcept
+{
+    JournalEntry copy = *this;
+    copy.checksum = 0;
+    std::array<std::uint64_t, sizeof(JournalEntry) / sizeof(std::uint64_t)> words;
+    std::memcpy(words.data(), &copy, sizeof(copy));
+
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::uint64_t word : words)
+        hash = (hash ^ word) * 1099511628211ull;
+    return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+Journal::Journal(const std::filesystem::path& path, Options options)
+    : options_{options}
+    , queue_{options.queueCapacity}
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw std::system_error(errno, std::system_category(), "Journal::Journal -> open");
+
+    // Blocks are reserved up front, so a sync only has to write the data
+    // instead of also growing the file
+    allocated_ = std::max(options_.preallocate, sizeof(JournalHeader));
+    JournalHeader header{};
+    int error = ::posix_fallocate(fd_, 0, static_cast<off_t>(allocated_));
+    if (error == 0 && ::pwrite(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+        error = errno;
+    if (error == 0 && ::fdatasync(fd_) != 0)
+        error = errno;
+    // The new file only survives a power loss once its directory entry is synced
+    if (error == 0 && !syncDirectory(path.has_parent_path() ? path.parent_path().c_str() : "."))
+        error = errno;
+    if (error != 0) {
+        ::close(fd_);
+        std::filesystem::remove(path);
+        throw std::system_error(error, std::system_category(), "Journal::Journal -> preallocate");
+    }
+
+    writer_ = std::thread{[this] { run(); }};
+}
+
+Journal::~Journal()
+{
+    stop_.store(true, std::memory_order_release);
+    writer_.join();
+    // Drop the preallocated tail, readers stop at the first missing entry either way
+    if (ok())
+        ::ftruncate(fd_, static_cast<off_t>(offset_));
+    ::close(fd_);
+}
+
+std::uint64_t Journal::append(JournalEntry entry) noexcept
+{
+    entry.sequence = ++sequence_;
+    if (!queue_.push(entry)) {
+        stalls_++;
+        while (!queue_.push(entry))
+            std::this_thread::yield();
+    }
+    return entry.sequence;
+}
+
+void Journal::truncate(std::uint64_t sequence) noexcept
+{
+    truncateTo_.store(std::max(truncateTo_.load(std::memory_order_relaxed), sequence), std::memory_order_release);
+}
+
+bool Journal::waitDurable(std::uint64_t sequence) const noexcept
+{
+    while (durableSequence() < sequence) {
+        if (!ok())
+            return false;
+        std::this_thread::sleep_for(options_.window / 4);
+    }
+    return true;
+}
+
+void Journal::run() noexcept
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<JournalEntry> batch;
+    batch.reserve(options_.batchSize);
+    std::uint64_t written = 0;
+    std::uint64_t truncated = 0;
+    size_t unsynced = 0;
+    clock::time_point oldestUnsynced{};
+
+    while (true) {
+        // Read before draining, everything appended before the stop request is in the queue by now
+        bool stopping = stop_.load(std::memory_order_acquire);
+
+        JournalEntry entry;
+        while (batch.size() < options_.batchSize && queue_.pop(entry)) {
+            entry.checksum = entry.computeChecksum();
+            batch.push_back(entry);
+        }
+        bool idle = batch.empty();
+        if (!idle && ok()) {
+            if (unsynced == 0)
+                oldestUnsynced = clock::now();
+            if (write(batch)) {
+                written = batch.back().sequence;
+                unsynced += batch.size();
+            } else {
+                failed_.store(true, std::memory_order_release);
+            }
+        }
+        batch.clear();
+
+        bool drained = stopping && queue_.empty();
+        bool due = unsynced >= options_.batchSize || (unsynced > 0 && clock::now() - oldestUnsynced >= options_.window);
+        if (ok() && unsynced > 0 && (due || drained)) {
+            if (::fdatasync(fd_) == 0) {
+                durable_.store(written, std::memory_order_release);
+                unsynced = 0;
+            } else {
+                failed_.store(true, std::memory_order_release);
+            }
+        }
+
+        // Only entries that were written, a later write would bring the others back
+        std::uint64_t truncateTo = std::min(truncateTo_.load(std::memory_order_acquire), written);
+        if (ok() && truncateTo > truncated) {
+            punch(truncated, truncateTo);
+            truncated = truncateTo;
+        }
+
+        if (drained)
+            return;
+        if (idle)
+            std::this_thread::sleep_for(std::chrono::microseconds{20});
+    }
+}
+
+bool Journal::write(std::span<const JournalEntry> entries) noexcept
+{
+    size_t bytes = entries.size_bytes();
+    if (offset_ + bytes > allocated_) {
+        size_t grow = std::max(options_.preallocate, bytes);
+        if (::posix_fallocate(fd_, static_cast<off_t>(allocated_), static_cast<off_t>(grow)) != 0)
+            return false;
+        allocated_ += grow;
+    }
+
+    const char* data = reinterpret_cast<const char*>(entries.data());
+    while (bytes > 0) {
+        ssize_t done = ::pwrite(fd_, data, bytes, static_cast<off_t>(offset_));
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return false;
+        data += done;
+        bytes -= static_cast<size_t>(done);
+        offset_ += static_cast<size_t>(done);
+    }
+    return true;
+}
+
+// Entries (from, to] read back as zeros, a file system without hole punching keeps them
+void Journal::punch(std::uint64_t from, std::uint64_t to) noexcept
+{
+    auto offset = static_cast<off_t>(sizeof(JournalHeader) + from * sizeof(JournalEntry));
+    auto length = static_cast<off_t>((to - from) * sizeof(JournalEntry));
+    ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length);
+}
+
+JournalReader::JournalReader(const std::filesystem::path& path) noexcept
+    : file_{path}
+{
+    auto bytes = file_.bytes();
+    if (!file_.ok() || bytes.size() < sizeof(JournalHeader))
+        return;
+
+    JournalHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != JournalHeader::expectedMagic || header.version != JournalHeader::currentVersion ||
+        header.entrySize != sizeof(JournalEntry))
+        return;
+    ok_ = true;
+
+    // The mapping is page aligned and the header is one entry long
+    std::span<const JournalEntry> all{reinterpret_cast<const JournalEntry*>(bytes.data() + sizeof(header)),
+                                      (bytes.size() - sizeof(header)) / sizeof(JournalEntry)};
+    // Truncated entries read as zeros
+    size_t first = 0;
+    while (first < all.size() && all[first].sequence == 0)
+        first++;
+    size_t last = first;
+    while (last < all.size() && all[last].sequence == all[first].sequence + (last - first) &&
+           all[last].checksum == all[last].computeChecksum())
+        last++;
+    entries_ = all.subspan(first, last - first);
+}
+
+std::optional<std::span<const JournalEntry>> JournalReader::entriesAfter(std::uint64_t sequence) const noexcept
+{
+    if (entries_.empty())
+        return entries_;
+    std::uint64_t first = entries_.front().sequence;
+    if (first > sequence + 1)
+        return std::nullopt;
+    return entries_.subspan(std::min<size_t>(sequence + 1 - first, entries_.size()));
+}
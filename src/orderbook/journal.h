@@ -0,0 +1,341 @@
+#pragma once
+
+#include "SPSCQueue.h"
+#include "orderbook.h"
+#include "snapshot.h"
+#include "types.h"
+#include "usings.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <thread>
+
+// What a journal entry did to the book
+enum class JournalOp : std::uint8_t { Add, Cancel, Modify, Expire, CloseSession, StartAuction, Uncross };
+
+// One command that changed a book, one cache line per entry. Fields the
+// command does not use keep the bad values of Command
+struct JournalEntry {
+    std::uint64_t sequence; // 1, 2, ... in the order the commands were applied
+    std::int64_t time;      // clock of the book when the command was applied, microseconds, 0 for cancels
+    orderId_t target;       // order a cancel or modify refers to
+    orderId_t orderId;      // id the book gave the (new) order, 0 if there is none
+    std::int64_t expiry;    // microseconds, GoodTillDate adds only
+    price_t price;
+    quantity_t quantity;
+    price_t trigger;        // stop adds only
+    quantity_t peak;        // iceberg adds only
+    std::uint32_t checksum; // filled in by the writer thread
+    JournalOp op;
+    OrderType type;
+    Side side;
+    std::array<std::uint8_t, 1> reserved{};
+
+    static JournalEntry from(JournalOp op, const Command& command, orderId_t orderId, microsec_t time) noexcept
+    {
+        return JournalEntry{.sequence = 0,
+                            .time = time.count(),
+                            .target = command.oid,
+                            .orderId = orderId,
+                            .expiry = command.expiry.count(),
+                            .price = command.price,
+                            .quantity = command.quantity,
+                            .trigger = command.trigger,
+                            .peak = command.peak,
+                            .checksum = 0,
+                            .op = op,
+                            .type = command.type,
+                            .side = command.side};
+    }
+
+    Command command() const noexcept
+    {
+        Command command;
+        command.action = op == JournalOp::Add ? Actions::ADD
+                         : op == JournalOp::Cancel ? Actions::CANCEL
+                         : op == JournalOp::Modify ? Actions::MODIFY
+                                                   : Actions::NULLACTION;
+        command.oid = target;
+        command.type = type;
+        command.quantity = quantity;
+        command.price = price;
+        command.side = side;
+        command.expiry = microsec_t{expiry};
+        command.trigger = trigger;
+        command.peak = peak;
+        return command;
+    }
+
+    // FNV-1a over the 64 bit words of the entry with the checksum zeroed, tells a
+    // torn tail from a written entry
+    std::uint32_t computeChecksum() const noexcept;
+};
+
+static_assert(sizeof(JournalEntry) == 64 && std::is_trivially_copyable_v<JournalEntry>);
+
+struct JournalHeader {
+    static constexpr std::array<char, 8> expectedMagic{'O', 'B', 'J', 'R', 'N', 'L', '\0', '\0'};
+    static constexpr std::uint32_t currentVersion = 3;
+
+    std::array<char, 8> magic{expectedMagic};
+    std::uint32_t version{currentVersion};
+    std::uint32_t entrySize{sizeof(JournalEntry)};
+    std::array<std::uint8_t, 48> reserved{};
+};
+
+static_assert(sizeof(JournalHeader) == sizeof(JournalEntry), "entries stay aligned to their size");
+
+// Append only command log. The engine thread hands entries to a writer thread
+// through an SPSCQueue, the writer appends them to a file that is preallocated
+// in large chunks and makes them durable with one fdatasync per group: when
+// batchSize entries are waiting or the oldest unsynced entry is `window` old.
+// durableSequence() tells the engine which entries survive a crash, so replies
+// can be held back until then without the matching thread ever waiting on disk.
+// The constructor creates the file and throws std::system_error if it can not,
+// a journal never overwrites an existing file
+class Journal
+{
+public:
+    struct Options {
+        size_t queueCapacity = 1ull << 16;
+        size_t batchSize = 1024;
+        std::chrono::microseconds window{500};
+        size_t preallocate = 64ull << 20; // bytes
+    };
+
+    explicit Journal(const std::filesystem::path& path) : Journal(path, Options{}) {}
+    Journal(const std::filesystem::path& path, Options options);
+    // Writes and syncs everything that was appended, then closes the file
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Engine thread only. Numbers the entry, queues it and returns its sequence.
+    // Spins while the queue is full, which only happens if the writer fell a
+    // whole queue behind
+    std::uint64_t append(JournalEntry entry) noexcept;
+
+    // Last entry that is on disk, entries are synced in sequence order
+    std::uint64_t durableSequence() const noexcept { return durable_.load(std::memory_order_acquire); }
+    std::uint64_t lastSequence() const noexcept { return sequence_; }
+    // Blocks until `sequence` is durable, false if the writer failed before that
+    bool waitDurable(std::uint64_t sequence) const noexcept;
+    // False once a write or sync failed, nothing after the last durable entry is written from then on
+    bool ok() const noexcept { return !failed_.load(std::memory_order_acquire); }
+    // How often append() found the queue full
+    std::uint64_t stalls() const noexcept { return stalls_; }
+
+    // Drops the entries up to `sequence` once a snapshot holds them (see
+    // Checkpoint). The writer punches them out of the file, which frees their
+    // blocks without moving the entries after them
+    void truncate(std::uint64_t sequence) noexcept;
+
+private:
+    Options options_;
+    int fd_{-1};
+    SPSCQueue<JournalEntry> queue_;
+    std::uint64_t sequence_{0};
+    std::uint64_t stalls_{0};
+    // Writer thread state
+    size_t offset_{sizeof(JournalHeader)};
+    size_t allocated_{0};
+    alignas(cacheline_size) std::atomic<std::uint64_t> durable_{0};
+    std::atomic<std::uint64_t> truncateTo_{0};
+    std::atomic<bool> failed_{false};
+    std::atomic<bool> stop_{false};
+    std::thread writer_;
+
+    void run() noexcept;
+    bool write(std::span<const JournalEntry> entries) noexcept;
+    void punch(std::uint64_t from, std::uint64_t to) noexcept;
+};
+
+// The entries of a journal file from the first one that was not truncated up
+// to the first one that is missing, out of sequence or torn (written by a crash
+// in the middle of a write). The file is mapped, entries point into the mapping
+// and stay valid while the reader lives
+class JournalReader
+{
+public:
+    explicit JournalReader(const std::filesystem::path& path) noexcept;
+
+    // False if the file could not be read or is not a journal
+    bool ok() const noexcept { return ok_; }
+    std::span<const JournalEntry> entries() const noexcept { return entries_; }
+    // The entries after `sequence`, e.g. the journalSequence of the snapshot a
+    // book was loaded from. Empty if the journal was truncated past `sequence`
+    // and does not continue it
+    std::optional<std::span<const JournalEntry>> entriesAfter(std::uint64_t sequence) const noexcept;
+
+private:
+    MappedFile file_;
+    std::span<const JournalEntry> entries_;
+    bool ok_{false};
+};
+
+// Runs commands through a book and journals the ones that changed it or used up
+// an order id: accepted adds and modifies, adds and modifies refused after the
+// order was numbered (FAK/FOK), cancels of resting orders and expiry runs.
+// Commands refused before touching the book are not journaled
+template <typename Book>
+class JournaledBook
+{
+public:
+    JournaledBook(Book& book, Journal& journal)
+        : book_{book}
+        , journal_{journal}
+    {
+    }
+
+    // The status of a cancel carries the cancelled id
+    template <typename Sink>
+    OrderStatus apply(const Command& command, Sink& sink) noexcept
+    {
+        if (command.action == Actions::ADD) {
+            microsec_t time = book_.clock().now();
+            OrderStatus status;
+            if (Order::isStop(command.type))
+                status = book_.addStopOrder(command.quantity, command.trigger, command.price, command.type,
+                                            command.side, sink);
+            else if (command.peak != 0)
+                status = book_.addIcebergOrder(command.quantity, command.peak, command.price, command.type,
+                                               command.side, command.expiry, sink);
+            else
+                status = book_.addOrder(command.quantity, command.price, command.type, command.side,
+                                        command.expiry, sink);
+            if (status.orderId != 0)
+                journal_.append(JournalEntry::from(JournalOp::Add, command, status.orderId, time));
+            return status;
+        }
+        if (command.action == Actions::CANCEL) {
+            RejectReason reason = book_.cancelOrder(command.oid, sink);
+            if (reason == RejectReason::None)
+                journal_.append(JournalEntry::from(JournalOp::Cancel, command, 0, microsec_t{0}));
+            return OrderStatus{.orderId = command.oid, .reason = reason};
+        }
+        if (command.action == Actions::MODIFY) {
+            microsec_t time = book_.clock().now();
+            auto status = book_.modifyOrder(command.oid, command.modifications(), sink);
+            // A replaced order gets a new id even if the replacement is refused
+            if (status.accepted() || status.orderId != command.oid)
+                journal_.append(JournalEntry::from(JournalOp::Modify, command, status.orderId, time));
+            return status;
+        }
+        // NULLACTION, an unparsed line
+        return OrderStatus{.reason = RejectReason::BadType};
+    }
+
+    template <typename Sink>
+    void expireOrders(Sink& sink) noexcept
+    {
+        journal_.append(JournalEntry::from(JournalOp::Expire, Command{}, 0, book_.clock().now()));
+        book_.expireOrders(sink);
+    }
+
+    template <typename Sink>
+    void closeSession(Sink& sink) noexcept
+    {
+        journal_.append(JournalEntry::from(JournalOp::CloseSession, Command{}, 0, book_.clock().now()));
+        book_.closeSession(sink);
+    }
+
+    void startAuction() noexcept
+    {
+        journal_.append(JournalEntry::from(JournalOp::StartAuction, Command{}, 0, book_.clock().now()));
+        book_.startAuction();
+    }
+
+    // The entry keeps the equilibrium price (badValues::price if nothing crossed), replays check it
+    template <typename Sink>
+    std::optional<Equilibrium> uncross(Sink& sink) noexcept
+    {
+        microsec_t time = book_.clock().now();
+        std::optional<Equilibrium> result = book_.uncross(sink);
+        Command command;
+        command.price = result.has_value() ? result->price : badValues::price;
+        journal_.append(JournalEntry::from(JournalOp::Uncross, command, 0, time));
+        return result;
+    }
+
+    Book& book() noexcept { return book_; }
+
+private:
+    Book& book_;
+    Journal& journal_;
+};
+
+struct JournalReplay {
+    // Entries applied before the first one that did not reproduce
+    std::uint64_t applied{0};
+    // False if an entry got a different id or result than when it was journaled,
+    // i.e. the journal does not continue the state the book was in
+    bool consistent{true};
+};
+
+// Applies journaled commands to `book`, which has to be in the state the
+// journal started from (empty, or loaded from the snapshot taken at that
+// point). Books with a clock that can be set (ManualClock) are moved to the
+// journaled time of every entry and end up exactly as the journaled book was,
+// other books apply the entries at their current time
+template <typename Book, typename Sink>
+JournalReplay replayJournal(std::span<const JournalEntry> entries, Book& book, Sink& sink) noexcept
+{
+    JournalReplay result;
+    for (const JournalEntry& entry : entries) {
+        // Cancels do not depend on the time and do not carry it
+        if constexpr (requires { book.clock().set(microsec_t{}); })
+            if (entry.op != JournalOp::Cancel)
+                book.clock().set(microsec_t{entry.time});
+
+        Command command = entry.command();
+        bool reproduced = true;
+        switch (entry.op) {
+        case JournalOp::Add:
+            if (Order::isStop(command.type))
+                reproduced = book.addStopOrder(command.quantity, command.trigger, command.price, command.type,
+                                               command.side, sink)
+                                 .orderId == entry.orderId;
+            else if (command.peak != 0)
+                reproduced = book.addIcebergOrder(command.quantity, command.peak, command.price, command.type,
+                                                  command.side, command.expiry, sink)
+                                 .orderId == entry.orderId;
+            else
+                reproduced = book.addOrder(command.quantity, command.price, command.type, command.side,
+                                           command.expiry, sink)
+                                 .orderId == entry.orderId;
+            break;
+        case JournalOp::Cancel:
+            reproduced = book.cancelOrder(command.oid, sink) == RejectReason::None;
+            break;
+        case JournalOp::Modify:
+            reproduced = book.modifyOrder(command.oid, command.modifications(), sink).orderId == entry.orderId;
+            break;
+        case JournalOp::Expire:
+            book.expireOrders(sink);
+            break;
+        case JournalOp::CloseSession:
+            book.closeSession(sink);
+            break;
+        case JournalOp::StartAuction:
+            book.startAuction();
+            break;
+        case JournalOp::Uncross: {
+            std::optional<Equilibrium> equilibrium = book.uncross(sink);
+            reproduced = equilibrium.has_value() ? equilibrium->price == entry.price : entry.price == badValues::price;
+            break;
+        }
+        }
+
+        if (!reproduced) {
+            result.consistent = false;
+            return result;
+        }
+        result.applied++;
+    }
+    return result;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Heap bytes held by a book, see BasicOrderbook::memoryStats. Tree and hash
+// nodes are counted from the element count with the libstdc++ node layouts,
+// everything else from the sizes actually allocated. Allocator headers and the
+// book object itself are not counted
+struct MemoryStats {
+    // Bytes held now and the most held at once. The peak of a part made of two
+    // sides or of several books is the sum of their peaks, which bounds it
+    struct Usage {
+        size_t bytes{0};
+        size_t peak{0};
+
+        Usage& operator+=(const Usage& other)
+        {
+            bytes += other.bytes;
+            peak += other.peak;
+            return *this;
+        }
+    };
+
+    // Price levels of both sides: tree nodes, or ladders and their occupancy bitmaps
+    Usage levels;
+    // Pool nodes holding a resting order
+    Usage orders;
+    // Order index pages holding a live id, and the page directory
+    Usage index;
+    // Pool nodes and index pages that were used and are free again, and the part
+    // of the storage arena not handed out yet. None of it is handed back to the
+    // system, this is what the book keeps to regrow to its peak
+    size_t freePools{0};
+    // Depth index windows, expiry schedules, pending stops and scratch buffers
+    size_t other{0};
+
+    size_t total() const { return levels.bytes + orders.bytes + index.bytes + freePools + other; }
+
+    MemoryStats& operator+=(const MemoryStats& stats)
+    {
+        levels += stats.levels;
+        orders += stats.orders;
+        index += stats.index;
+        freePools += stats.freePools;
+        other += stats.other;
+        return *this;
+    }
+};
+
+namespace heapBytes
+{
+    // Red-black tree node: colour and parent, left and right links in front of the value
+    template <typename Value>
+    constexpr size_t treeNode = 4 * sizeof(void*) + sizeof(Value);
+    // Hash node: next link in front of the value, hashes of integer keys are not cached
+    template <typename Value>
+    constexpr size_t hashNode = sizeof(void*) + sizeof(Value);
+
+    template <typename T>
+    size_t vector(const std::vector<T>& values)
+    {
+        return values.capacity() * sizeof(T);
+    }
+} // namespace heapBytes
@@ -1,58 +1,172 @@
 #pragma once
 
 #include "types.h"
-#include <list>
-#include <stdexcept>
+#include <algorithm>
 
-class Order
+// Fields of a resting order the matching loop reads for every fill. OrderPool
+// keeps them in a dense array next to the queue links, apart from OrderCold.
+// Price and side fill what would be padding, with them a cancel does not read
+// the cold fields either
+struct OrderHot {
+    orderId_t orderId;
+    quantity_t remainingQuantity;
+    quantity_t hidden;
+    price_t price;
+    Side side;
+};
+
+struct OrderCold {
+    quantity_t initialQuantity;
+    quantity_t peak;
+    OrderType type;
+    microsec_t opentime;
+    microsec_t expiry;
+};
+
+// Accessors and state changes of an order, shared by Order and OrderView.
+// Derived provides hot() and cold().
+// Orders are only built from fields that passed validate(), nothing in here
+// checks its arguments again.
+// An iceberg order (peak != 0) only displays up to `peak` of its quantity while
+// it rests, the rest is hidden. The remaining quantity is the displayed part,
+// the one the book matches against, and refresh() shows the next clip once it
+// is filled. Until the order rests (hideReserve()) all of it is displayed
+template <typename Derived>
+class OrderFields
 {
 public:
-    Order(orderId_t orderid, quantity_t quantity, price_t price, OrderType type, Side side, microsec_t opentime)
-        : orderid_{orderid}
-        , initialQuantity_{quantity}
-        , remainingQuantity_{quantity}
-        , price_{price}
-        , type_{type}
-        , side_{side}
-        , opentime_{opentime}
-    {
-        if (quantity <= 0 || quantity == badValues::quantity)
-            throw std::invalid_argument("bad quantity");
+    static constexpr RejectReason validate(quantity_t quantity, price_t price, OrderType type, Side side) noexcept
+    {
+        if (quantity == 0 || quantity == badValues::quantity)
+            return RejectReason::BadQuantity;
         if (type == OrderType::Bad)
-            throw std::invalid_argument("order has to have a type");
+            return RejectReason::BadType;
         if (price == badValues::price)
-            throw std::invalid_argument("bad price");
-        if (side == Side::Bad)
-            throw std::invalid_argument("bad side");
+            return RejectReason::BadPrice;
+        if (side != Side::Buy && side != Side::Sell)
+            return RejectReason::BadSide;
+        return RejectReason::None;
+    }
+
+    // Whether the unfilled rest of an order of this type stays on the book
+    static constexpr bool canRest(OrderType type) noexcept
+    {
+        return type == OrderType::GoodTillCancel || type == OrderType::GoodTillEOD || type == OrderType::GoodTillDate;
+    }
+
+    // Whether an order of this type waits for a trigger price before it is matched
+    static constexpr bool isStop(OrderType type) noexcept
+    {
+        return type == OrderType::Stop || type == OrderType::StopLimit;
+    }
+
+    orderId_t getOrderId() const { return hot().orderId; }
+    quantity_t getInitialQuantity() const { return cold().initialQuantity; }
+    quantity_t getRemainingQuantity() const { return hot().remainingQuantity; }
+    price_t getPrice() const { return hot().price; }
+    OrderType getType() const { return cold().type; }
+    Side getSide() const { return hot().side; }
+    microsec_t getOpenTime() const { return cold().opentime; }
+    // Only set for GoodTillDate orders
+    microsec_t getExpiry() const { return cold().expiry; }
+
+    // Displayed size of an iceberg order, 0 for other orders
+    quantity_t getPeak() const { return cold().peak; }
+    quantity_t getHiddenQuantity() const { return hot().hidden; }
+    // Displayed and hidden quantity
+    quantity_t getOpenQuantity() const { return hot().remainingQuantity + hot().hidden; }
+
+    quantity_t getFilled() const { return getInitialQuantity() - getOpenQuantity(); }
+    // Only the displayed quantity, an iceberg may still hold hidden quantity
+    bool isFullyFilled() const { return hot().remainingQuantity == 0; }
+    // quantity must not be larger than the remaining quantity
+    void fill(quantity_t quantity) noexcept { hot().remainingQuantity -= quantity; }
+    // Lowers the open quantity in place, the filled quantity stays the same.
+    // Hidden quantity goes first. quantity must not be larger than the open quantity
+    void reduceRemaining(quantity_t quantity) noexcept
+    {
+        OrderHot& h = hot();
+        cold().initialQuantity -= getOpenQuantity() - quantity;
+        h.hidden = quantity > h.remainingQuantity ? quantity - h.remainingQuantity : 0;
+        h.remainingQuantity = std::min(h.remainingQuantity, quantity);
+    }
+
+    // Called when an iceberg starts resting, hides everything above the peak
+    void hideReserve() noexcept
+    {
+        quantity_t remaining = hot().remainingQuantity;
+        hide(remaining - std::min(remaining, cold().peak));
+    }
+    // Moves quantity from the displayed to the hidden part, quantity must not be
+    // larger than the remaining quantity
+    void hide(quantity_t quantity) noexcept
+    {
+        hot().remainingQuantity -= quantity;
+        hot().hidden += quantity;
+    }
+    // Shows the next clip of a filled iceberg and returns its size
+    quantity_t refresh() noexcept
+    {
+        OrderHot& h = hot();
+        h.remainingQuantity = std::min(cold().peak, h.hidden);
+        h.hidden -= h.remainingQuantity;
+        return h.remainingQuantity;
     }
 
-    orderId_t getOrderId() const { return orderid_; }
-    quantity_t getInitialQuantity() const { return initialQuantity_; }
-    quantity_t getRemainingQuantity() const { return remainingQuantity_; }
-    price_t getPrice() const { return price_; }
-    OrderType getType() const { return type_; }
-    Side getSide() const { return side_; }
-    microsec_t getOpenTime() const { return opentime_; }
+private:
+    decltype(auto) hot() const { return static_cast<const Derived&>(*this).hot(); }
+    decltype(auto) cold() const { return static_cast<const Derived&>(*this).cold(); }
+    decltype(auto) hot() { return static_cast<Derived&>(*this).hot(); }
+    decltype(auto) cold() { return static_cast<Derived&>(*this).cold(); }
+};
 
-    quantity_t getFilled() const { return initialQuantity_ - remainingQuantity_; }
-    bool isFullyFilled() const { return remainingQuantity_ == 0; }
-    void fill(quantity_t quantity)
+// Order that owns its fields, used to build orders and outside of the book
+class Order : public OrderFields<Order>
+{
+public:
+    Order(orderId_t orderid, quantity_t quantity, price_t price, OrderType type, Side side, microsec_t opentime,
+          microsec_t expiry = microsec_t{0}, quantity_t peak = 0) noexcept
+        : hot_{.orderId = orderid, .remainingQuantity = quantity, .hidden = 0, .price = price, .side = side}
+        , cold_{.initialQuantity = quantity, .peak = peak, .type = type, .opentime = opentime, .expiry = expiry}
     {
-        if (quantity > remainingQuantity_)
-            throw std::invalid_argument("fill: invalid quantities");
+    }
+
+    OrderHot& hot() { return hot_; }
+    const OrderHot& hot() const { return hot_; }
+    OrderCold& cold() { return cold_; }
+    const OrderCold& cold() const { return cold_; }
 
-        remainingQuantity_ -= quantity;
+private:
+    OrderHot hot_;
+    OrderCold cold_;
+};
+
+// Order stored in an OrderPool, refers to its hot and cold fields in place.
+// Hot is OrderHot or const OrderHot, Cold likewise
+template <typename Hot, typename Cold>
+class OrderView : public OrderFields<OrderView<Hot, Cold>>
+{
+public:
+    OrderView(Hot& hot, Cold& cold) noexcept
+        : hot_{&hot}
+        , cold_{&cold}
+    {
+    }
+    // Read only view of a mutable order
+    template <typename H, typename C>
+    OrderView(const OrderView<H, C>& other) noexcept
+        : hot_{&other.hot()}
+        , cold_{&other.cold()}
+    {
     }
 
+    Hot& hot() const { return *hot_; }
+    Cold& cold() const { return *cold_; }
+
 private:
-    orderId_t orderid_;
-    quantity_t initialQuantity_;
-    quantity_t remainingQuantity_;
-    price_t price_;
-    OrderType type_;
-    Side side_;
-    microsec_t opentime_;
+    Hot* hot_;
+    Cold* cold_;
 };
 
-using orderPtr_t = std::shared_ptr<Order>;
-using orderPtrs_t = std::list<orderPtr_t>;
+using OrderRef = OrderView<OrderHot, OrderCold>;
+using ConstOrderRef = OrderView<const OrderHot, const OrderCold>;
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "arena.h"
+#include "memoryStats.h"
+#include "orderPool.h"
+#include "usings.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Maps order ids to pool handles. Ids are handed out sequentially by the book,
+// so instead of hashing, the id is split into a page number (id >> pageShift)
+// and a slot inside that page. Pages are allocated when the first id lands in
+// them and recycled once every order in them is gone and newer ids have moved
+// on to later pages. Each slot remembers the page number it was written for
+// (its generation), so an id pointing into a recycled page is never confused
+// with the order that reuses the slot. Pages come from `arena` while it has
+// room, then from the heap
+class OrderIndex
+{
+public:
+    static constexpr size_t pageShift = 12;
+    static constexpr size_t pageSize = 1ull << pageShift;
+
+    explicit OrderIndex(PageArena* arena = nullptr)
+        : arena_{arena}
+    {
+    }
+
+    // Arena bytes needed to index `orders` orders with consecutive ids, wherever
+    // the first one falls in a page
+    static constexpr size_t bytesFor(size_t orders) { return ((orders + pageSize - 1) / pageSize + 1) * sizeof(Page); }
+
+    size_t size() const { return size_; }
+    bool contains(orderId_t orderId) const { return find(orderId) != badValues::orderHandle; }
+
+    // Pages holding a live id and the directory, which never shrinks
+    MemoryStats::Usage memoryUse() const
+    {
+        size_t directory = heapBytes::vector(directory_);
+        return {.bytes = usedPages_ * sizeof(Page) + directory, .peak = peakPages_ * sizeof(Page) + directory};
+    }
+    // Emptied pages kept for reuse
+    size_t freeBytes() const { return freePages_.size() * sizeof(Page) + heapBytes::vector(freePages_); }
+
+    // badValues::orderHandle if the order is not in the index
+    orderHandle_t find(orderId_t orderId) const
+    {
+        size_t pageIdx = orderId >> pageShift;
+        if (pageIdx >= directory_.size() || !directory_[pageIdx])
+            return badValues::orderHandle;
+
+        const Slot& slot = directory_[pageIdx]->slots[orderId & (pageSize - 1)];
+        return slot.generation == generation(orderId) ? slot.handle : badValues::orderHandle;
+    }
+
+    // Pulls the slot of orderId into the cache ahead of a find()
+    void prefetch(orderId_t orderId) const
+    {
+        size_t pageIdx = orderId >> pageShift;
+        if (pageIdx < directory_.size() && directory_[pageIdx])
+            __builtin_prefetch(&directory_[pageIdx]->slots[orderId & (pageSize - 1)]);
+    }
+
+    // Overwrites the handle if the order is already in the index
+    void insert(orderId_t orderId, orderHandle_t handle)
+    {
+        size_t pageIdx = orderId >> pageShift;
+        if (pageIdx >= directory_.size())
+            directory_.resize(pageIdx + 1);
+        if (!directory_[pageIdx]) {
+            directory_[pageIdx] = newPage();
+            peakPages_ = std::max(peakPages_, ++usedPages_);
+        }
+        if (pageIdx > highestPage_) {
+            // The previous newest page may have emptied while it was still being written
+            releaseIfEmpty(highestPage_);
+            highestPage_ = pageIdx;
+        }
+
+        Page& page = *directory_[pageIdx];
+        Slot& slot = page.slots[orderId & (pageSize - 1)];
+        if (slot.handle == badValues::orderHandle) {
+            page.live++;
+            size_++;
+        }
+        slot.handle = handle;
+        slot.generation = generation(orderId);
+    }
+
+    void erase(orderId_t orderId)
+    {
+        size_t pageIdx = orderId >> pageShift;
+        if (pageIdx >= directory_.size() || !directory_[pageIdx])
+            return;
+
+        Page& page = *directory_[pageIdx];
+        Slot& slot = page.slots[orderId & (pageSize - 1)];
+        if (slot.handle == badValues::orderHandle || slot.generation != generation(orderId))
+            return;
+
+        slot.handle = badValues::orderHandle;
+        page.live--;
+        size_--;
+
+        // Ids only grow, an empty page behind the newest one will not be written again
+        if (pageIdx < highestPage_)
+            releaseIfEmpty(pageIdx);
+    }
+
+private:
+    struct Slot {
+        orderHandle_t handle{badValues::orderHandle};
+        std::uint32_t generation{0};
+    };
+    struct Page {
+        std::array<Slot, pageSize> slots{};
+        std::uint32_t live{0};
+    };
+    // Pages from the arena are only destroyed, the arena unmaps them
+    struct PageDeleter {
+        const PageArena* arena{nullptr};
+
+        void operator()(Page* page) const
+        {
+            if (arena != nullptr && arena->owns(page))
+                std::destroy_at(page);
+            else
+                delete page;
+        }
+    };
+    using pagePtr_t = std::unique_ptr<Page, PageDeleter>;
+
+    PageArena* arena_{nullptr};
+    std::vector<pagePtr_t> directory_;
+    std::vector<pagePtr_t> freePages_;
+    size_t highestPage_{0};
+    size_t size_{0};
+    // Pages in the directory now and at most
+    size_t usedPages_{0};
+    size_t peakPages_{0};
+
+    static std::uint32_t generation(orderId_t orderId) { return static_cast<std::uint32_t>(orderId >> pageShift); }
+
+    void releaseIfEmpty(size_t pageIdx)
+    {
+        if (pageIdx < directory_.size() && directory_[pageIdx] && directory_[pageIdx]->live == 0) {
+            freePages_.push_back(std::move(directory_[pageIdx]));
+            usedPages_--;
+        }
+    }
+
+    pagePtr_t newPage()
+    {
+        if (freePages_.empty()) {
+            if (arena_ != nullptr)
+                if (void* page = arena_->allocate(sizeof(Page), alignof(Page)))
+                    return pagePtr_t{::new (page) Page{}, PageDeleter{arena_}};
+            return pagePtr_t{new Page{}, PageDeleter{arena_}};
+        }
+
+        // Recycled pages only contain erased slots, their stale generations are rejected by find()
+        auto page = std::move(freePages_.back());
+        freePages_.pop_back();
+        return page;
+    }
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "arena.h"
+#include "memoryStats.h"
+#include "order.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using orderHandle_t = std::uint32_t;
+
+namespace badValues
+{
+    constexpr inline orderHandle_t orderHandle = std::numeric_limits<orderHandle_t>::max();
+} // namespace badValues
+
+// FIFO of resting orders at one price level. Orders are linked through the
+// nodes of the OrderPool they were allocated from, so the queue itself is
+// only the two ends
+struct OrderQueue {
+    orderHandle_t head{badValues::orderHandle};
+    orderHandle_t tail{badValues::orderHandle};
+
+    bool empty() const { return head == badValues::orderHandle; }
+};
+
+// Slab of order nodes. Memory is handed out in fixed size pages that are never
+// moved or returned until the pool is destroyed, freed nodes are recycled
+// through an intrusive free list, so once the pool has grown to the size of
+// the book, acquiring and releasing orders does not touch the heap.
+// A page keeps the hot half of its orders (OrderHot and the queue links) in one
+// array and the cold half in another, so walking a level queue only reads the
+// 32 byte hot nodes. operator[] returns a view over both halves.
+// Pages come from `arena` while it has room, then from the heap
+class OrderPool
+{
+public:
+    static constexpr size_t pageShift = 12;
+    static constexpr size_t pageSize = 1ull << pageShift;
+
+    explicit OrderPool(size_t reserved = 0, PageArena* arena = nullptr)
+        : arena_{arena}
+    {
+        reserve(reserved);
+    }
+    ~OrderPool()
+    {
+        for (auto page : pages_)
+            if (arena_ == nullptr || !arena_->owns(page))
+                traits::deallocate(allocator_, page, 1);
+    }
+    OrderPool(const OrderPool&) = delete;
+    OrderPool& operator=(const OrderPool&) = delete;
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return pages_.size() * pageSize; }
+    // Arena bytes needed to hold `orders` orders
+    static constexpr size_t bytesFor(size_t orders) { return (orders + pageSize - 1) / pageSize * sizeof(Page); }
+
+    // Nodes holding an order. Nodes are handed out front to back and only
+    // reused once freed, so the first never used one is the most held at once
+    MemoryStats::Usage memoryUse() const { return {.bytes = size_ * nodeBytes(), .peak = bumpNext_ * nodeBytes()}; }
+    // Nodes allocated but not holding an order
+    size_t freeBytes() const { return (capacity() - size_) * nodeBytes(); }
+
+    void reserve(size_t orders)
+    {
+        while (capacity() < orders)
+            pages_.push_back(newPage());
+    }
+
+    // Constructs an order in a free node and returns its handle
+    template <typename... Args>
+    orderHandle_t acquire(Args&&... args)
+    {
+        Order order(std::forward<Args>(args)...);
+        bool recycled = freeHead_ != badValues::orderHandle;
+        if (!recycled && bumpNext_ == capacity())
+            pages_.push_back(newPage());
+
+        orderHandle_t handle = recycled ? freeHead_ : static_cast<orderHandle_t>(bumpNext_);
+        HotNode& n = hot(handle);
+        // Free list link lives in the node that is about to be overwritten
+        orderHandle_t nextFree = recycled ? n.next : badValues::orderHandle;
+
+        std::construct_at(&n, HotNode{.order = order.hot(),
+                                      .prev = badValues::orderHandle,
+                                      .next = badValues::orderHandle});
+        std::construct_at(&cold(handle), order.cold());
+
+        if (recycled)
+            freeHead_ = nextFree;
+        else
+            bumpNext_++;
+        size_++;
+        return handle;
+    }
+
+    // Handle must not be linked into any queue
+    void release(orderHandle_t handle)
+    {
+        hot(handle).next = freeHead_;
+        freeHead_ = handle;
+        size_--;
+    }
+
+    OrderRef operator[](orderHandle_t handle) { return OrderRef{hot(handle).order, cold(handle)}; }
+    ConstOrderRef operator[](orderHandle_t handle) const { return ConstOrderRef{hot(handle).order, cold(handle)}; }
+    orderHandle_t next(orderHandle_t handle) const { return hot(handle).next; }
+    void prefetch(orderHandle_t handle) const
+    {
+        __builtin_prefetch(&hot(handle));
+        __builtin_prefetch(&cold(handle));
+    }
+
+    void pushBack(OrderQueue& queue, orderHandle_t handle)
+    {
+        HotNode& n = hot(handle);
+        n.prev = queue.tail;
+        n.next = badValues::orderHandle;
+
+        if (queue.empty())
+            queue.head = handle;
+        else
+            hot(queue.tail).next = handle;
+        queue.tail = handle;
+    }
+
+    void unlink(OrderQueue& queue, orderHandle_t handle)
+    {
+        HotNode& n = hot(handle);
+        if (n.prev == badValues::orderHandle)
+            queue.head = n.next;
+        else
+            hot(n.prev).next = n.next;
+
+        if (n.next == badValues::orderHandle)
+            queue.tail = n.prev;
+        else
+            hot(n.next).prev = n.prev;
+
+        n.prev = badValues::orderHandle;
+        n.next = badValues::orderHandle;
+    }
+
+private:
+    // Two nodes per cache line, a node never straddles one
+    struct alignas(32) HotNode {
+        OrderHot order;
+        orderHandle_t prev;
+        orderHandle_t next;
+    };
+    struct Page {
+        HotNode hot[pageSize];
+        OrderCold cold[pageSize];
+    };
+    using allocator_t = std::allocator<Page>;
+    using traits = std::allocator_traits<allocator_t>;
+    static_assert(sizeof(HotNode) == 32);
+    static_assert(std::is_trivially_destructible_v<OrderHot> && std::is_trivially_destructible_v<OrderCold>,
+                  "pages are freed without destroying live orders");
+
+    allocator_t allocator_{};
+    PageArena* arena_{nullptr};
+    std::vector<Page*> pages_;
+    orderHandle_t freeHead_{badValues::orderHandle};
+    size_t bumpNext_{0}; // first node that was never handed out
+    size_t size_{0};
+
+    static constexpr size_t nodeBytes() { return sizeof(Page) / pageSize; }
+
+    Page* newPage()
+    {
+        if (arena_ != nullptr)
+            if (void* page = arena_->allocate(sizeof(Page), alignof(Page)))
+                return static_cast<Page*>(page);
+        return traits::allocate(allocator_, 1);
+    }
+
+    HotNode& hot(orderHandle_t handle) { return pages_[handle >> pageShift]->hot[handle & (pageSize - 1)]; }
+    const HotNode& hot(orderHandle_t handle) const
+    {
+        return pages_[handle >> pageShift]->hot[handle & (pageSize - 1)];
+    }
+    OrderCold& cold(orderHandle_t handle) { return pages_[handle >> pageShift]->cold[handle & (pageSize - 1)]; }
+    const OrderCold& cold(orderHandle_t handle) const
+    {
+        return pages_[handle >> pageShift]->cold[handle & (pageSize - 1)];
+    }
+};
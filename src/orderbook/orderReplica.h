@@ -0,0 +1,157 @@
+#pragma once
+
+#include "events.h"
+#include "orderbook.h"
+#include "types.h"
+#include "usings.h"
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Order by order copy of a book kept by a market by order consumer from the
+// OrderEvents the book publishes (see OrderEventCollector). Every event is a
+// constant number of map and list operations, so the consumer follows every
+// level queue at O(events) per command instead of asking the book for depth.
+// Events must be applied in sequence order, apply() refuses an event that does
+// not follow the last one or does not fit the copy (unknown order, queue
+// position other than the back of the level) and leaves the copy untouched,
+// the consumer then has to start over from a snapshot
+class OrderReplica
+{
+public:
+    bool apply(const OrderEvent& event)
+    {
+        if (event.sequence != sequence_ + 1)
+            return false;
+        if (!(event.side == Side::Sell ? apply(ask_, event) : apply(bid_, event)))
+            return false;
+        sequence_ = event.sequence;
+        return true;
+    }
+
+    // Stops at the first event that is refused
+    bool apply(std::span<const OrderEvent> events)
+    {
+        for (const auto& event : events)
+            if (!apply(event))
+                return false;
+        return true;
+    }
+
+    uint64_t sequence() const { return sequence_; }
+    size_t size() const { return orders_.size(); }
+    // Displayed quantity of a resting order, empty if it is not on the book
+    std::optional<quantity_t> quantity(orderId_t orderId) const
+    {
+        auto it = orders_.find(orderId);
+        return it == orders_.end() ? std::nullopt : std::optional{it->second.quantity};
+    }
+    // Ids of the orders at one level from the front of the queue
+    std::vector<orderId_t> queue(Side side, price_t price) const
+    {
+        return side == Side::Sell ? queue(ask_, price) : queue(bid_, price);
+    }
+    levels_t fullDepthAsk() const { return depth(ask_); }
+    levels_t fullDepthBid() const { return depth(bid_); }
+
+private:
+    struct Level {
+        std::list<orderId_t> queue;
+        uint32_t volume{0};
+    };
+    struct Entry {
+        price_t price;
+        quantity_t quantity;
+        std::list<orderId_t>::iterator position;
+    };
+
+    // Best price first, as in the book
+    std::map<price_t, Level> ask_;
+    std::map<price_t, Level, std::greater<>> bid_;
+    std::unordered_map<orderId_t, Entry> orders_;
+    uint64_t sequence_{0};
+
+    template <typename Map>
+    bool apply(Map& side, const OrderEvent& event)
+    {
+        if (event.type == OrderEventType::Added) {
+            if (orders_.contains(event.orderId))
+                return false;
+            Level& level = side[event.price];
+            if (event.queuePosition != level.queue.size()) {
+                if (level.queue.empty())
+                    side.erase(event.price);
+                return false;
+            }
+            level.queue.push_back(event.orderId);
+            level.volume += event.quantity;
+            orders_.emplace(event.orderId, Entry{.price = event.price,
+                                                 .quantity = event.quantity,
+                                                 .position = std::prev(level.queue.end())});
+            return true;
+        }
+
+        auto it = orders_.find(event.orderId);
+        if (it == orders_.end() || it->second.price != event.price)
+            return false;
+        Entry& entry = it->second;
+        auto levelIt = side.find(event.price);
+        if (levelIt == side.end())
+            return false;
+        Level& level = levelIt->second;
+
+        switch (event.type) {
+        case OrderEventType::Executed:
+            if (event.quantity >= entry.quantity)
+                return false;
+            entry.quantity -= event.quantity;
+            level.volume -= event.quantity;
+            return true;
+        case OrderEventType::Amended:
+            if (event.quantity > entry.quantity)
+                return false;
+            level.volume -= entry.quantity - event.quantity;
+            entry.quantity = event.quantity;
+            return true;
+        case OrderEventType::Filled:
+        case OrderEventType::Cancelled:
+            if (event.quantity != entry.quantity)
+                return false;
+            level.volume -= entry.quantity;
+            level.queue.erase(entry.position);
+            orders_.erase(it);
+            if (level.queue.empty())
+                side.erase(levelIt);
+            return true;
+        case OrderEventType::Added:
+            break;
+        }
+        return false;
+    }
+
+    template <typename Map>
+    static std::vector<orderId_t> queue(const Map& side, price_t price)
+    {
+        auto it = side.find(price);
+        if (it == side.end())
+            return {};
+        return {it->second.queue.begin(), it->second.queue.end()};
+    }
+
+    template <typename Map>
+    static levels_t depth(const Map& side)
+    {
+        levels_t levels;
+        levels.reserve(side.size());
+        for (const auto& [price, level] : side)
+            levels.push_back(LevelView{.price = price,
+                                       .volume = level.volume,
+                                       .orderCnt = static_cast<uint32_t>(level.queue.size())});
+        return levels;
+    }
+};
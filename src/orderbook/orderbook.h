@@ -1,66 +1,1472 @@
 #pragma once
 
+#include "arena.h"
+#include "auction.h"
+#include "clock.h"
+#include "depthIndex.h"
+#include "events.h"
+#include "memoryStats.h"
 #include "order.h"
+#include "orderIndex.h"
+#include "orderPool.h"
+#include "priceLevels.h"
+#include "snapshot.h"
+#include "stopIndex.h"
+#include "timer_wheel.h"
 #include "trade.h"
 #include "types.h"
 #include "usings.h"
-#include <functional>
-#include <map>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <limits>
 #include <optional>
-#include <unordered_map>
-
-/* TODO: make better return types. Run unit tests, some fail currently because of cancelOrder changes
-    It is not allowed to throw from the orderbook, fix that, e.g. remove all throws and protect against them */
+#include <ranges>
+#include <span>
+#include <tuple>
 
 struct LevelView {
     price_t price;
     uint32_t volume;
     uint32_t orderCnt;
+
+    bool operator==(const LevelView&) const = default;
 };
 using levels_t = std::vector<LevelView>;
 
-struct OrderInfo {
-    price_t price;
-    quantity_t quantity;
-    Side side;
-    OrderType type;
+// Result of an add or modify. orderId is the id the order got, it is also set
+// for orders refused after they were numbered (FAK/FOK), 0 if validation failed
+struct OrderStatus {
+    orderId_t orderId{0};
+    RejectReason reason{RejectReason::None};
+
+    bool accepted() const { return reason == RejectReason::None; }
 };
 
-class Orderbook
+// Levels is the side container (see priceLevels.h), e.g. MapLevels or TickLevels.
+// Clock stamps new orders (see clock.h), the default reads the TSC.
+// Mutating calls report what happened through a listener deriving from
+// EventSink (see events.h), the tuple returning overloads are a thin adapter
+// over them that collects the trades into a new vector.
+// Nothing in the book throws: bad input is refused with a RejectReason before
+// anything is touched, so every member is noexcept (running out of memory
+// terminates)
+template <template <Side> class Levels, typename Clock = TscClock>
+class BasicOrderbook
 {
 public:
-    std::tuple<orderId_t, trades_t, OrderInfo> addOrder(quantity_t quantity, price_t price, OrderType type, Side side);
-    void cancelOrder(orderId_t orderId);
-    std::tuple<orderId_t, trades_t, OrderInfo> modifyOrder(orderId_t orderId, ModifyOrder modifications);
-    std::optional<price_t> bestAsk() const;
-    std::optional<price_t> bestBid() const;
-    levels_t fullDepthAsk() const { return fullDepth(Side::Sell); }
-    levels_t fullDepthBid() const { return fullDepth(Side::Buy); }
+    BasicOrderbook() = default;
+    // Resting orders and the order index are placed in one arena sized for
+    // storage.orders (see StorageOptions and PageArena), the pool pages for them
+    // are taken from it right away. Orders past that come from the heap. Levels
+    // always do: ladders are reallocated when they move and tree nodes are freed
+    // one by one, which an arena can not take back
+    explicit BasicOrderbook(const StorageOptions& storage) noexcept;
+    // Empty (capacity() 0) for books built without StorageOptions
+    const PageArena& arena() const noexcept { return arena_; }
+
+    template <typename Sink>
+    OrderStatus addOrder(quantity_t quantity, price_t price, OrderType type, Side side, Sink& sink) noexcept;
+    // `expiry` is only used by GoodTillDate orders and has to be after clock().now()
+    template <typename Sink>
+    OrderStatus addOrder(quantity_t quantity, price_t price, OrderType type, Side side, microsec_t expiry,
+                         Sink& sink) noexcept;
+    // Matched like any other order, the rest then only displays `peak` of its
+    // quantity (see Order). Once the displayed clip is filled, the next one is
+    // shown and the order moves to the back of its level, reusing its node, id
+    // and index entry. Hidden quantity is not part of the level volume, so it is
+    // not in the depth and is not counted by availableVolume and costToFill. It is
+    // counted when a FillOrKill order checks whether it can be filled, since
+    // matching trades through the refreshed clips. Only types that can rest may be icebergs
+    template <typename Sink>
+    OrderStatus addIcebergOrder(quantity_t quantity, quantity_t peak, price_t price, OrderType type, Side side,
+                                microsec_t expiry, Sink& sink) noexcept;
+    // Stop orders (Order::isStop) wait off the book until a trade is at or through
+    // `trigger` (at or above it for buys, at or below for sells), then they are
+    // matched as a Market order (Stop) or as a GoodTillCancel order at `price`
+    // (StopLimit, `price` is ignored for Stop orders). A stop whose trigger the
+    // last trade already reached is matched right away. Stops triggered by one
+    // command are matched after it, in the order they were triggered: buy stops
+    // from the lowest trigger, sell stops from the highest, same triggers in
+    // arrival order. Trades of a triggered order can trigger more stops, they
+    // are matched after the ones already triggered
+    template <typename Sink>
+    OrderStatus addStopOrder(quantity_t quantity, price_t trigger, price_t price, OrderType type, Side side,
+                             Sink& sink) noexcept;
+    // Also cancels pending stops
+    template <typename Sink>
+    RejectReason cancelOrder(orderId_t orderId, Sink& sink) noexcept;
+    // Quantity reductions that keep price, side and type are applied in place and
+    // keep the id and queue position, anything else cancels and re-adds the order.
+    // Invalid modifications are refused before the order is touched. The status
+    // holds the id of the (possibly new) order. Pending stops can not be modified
+    // (UnknownOrder) and resting orders can not be turned into stops (BadTrigger).
+    // The quantity of an iceberg is its open (displayed and hidden) quantity, a
+    // replaced iceberg keeps its peak
+    template <typename Sink>
+    OrderStatus modifyOrder(orderId_t orderId, ModifyOrder modifications, Sink& sink) noexcept;
+
+    // Runs the commands in order. While a command is matched, the index slots and
+    // order nodes of cancels and modifies a few commands ahead (and the levels of
+    // adds) are prefetched, so their cache misses overlap with useful work
+    template <typename Sink>
+    void process(std::span<const Command> commands, Sink& sink) noexcept;
+
+    // Cancels every GoodTillDate order whose expiry is not after clock().now().
+    // Orders are scheduled in a timing wheel when they start resting, the due ones
+    // are purged level by level (see purgeOrders)
+    template <typename Sink>
+    void expireOrders(Sink& sink) noexcept;
+    // Cancels every resting GoodTillEOD order and the GoodTillDate orders that are due
+    template <typename Sink>
+    void closeSession(Sink& sink) noexcept;
+
+    // Call auction, e.g. at the open or the close. Until uncross() orders are only
+    // collected: orders that can rest are rested at their price even if they
+    // cross, orders that have to match right away (Market, FAK, FOK and Stop
+    // orders) are refused with InAuction. Cancels, modifies and expiries work as usual
+    void startAuction() noexcept { auction_ = true; }
+    bool inAuction() const noexcept { return auction_; }
+    // Price the book would uncross at now, empty if it is not crossed. The
+    // candidates are the level prices from the best ask to the best bid, see
+    // AuctionSearch for the one picked (the reference is the last trade price).
+    // Volumes are open quantities: the uncross shows the next clip of an iceberg
+    // it fills, so its hidden quantity trades too
+    std::optional<Equilibrium> equilibrium() const noexcept;
+    // Ends the auction and trades the equilibrium volume at the equilibrium price
+    // in one pass: the best bid and the best ask order, in price then time
+    // priority, trade until one of them is filled. Returns the equilibrium, empty
+    // if nothing crossed. Stops the uncross triggered are matched after it
+    template <typename Sink>
+    std::optional<Equilibrium> uncross(Sink& sink) noexcept;
+
+    // Writes every resting order and the id counter to `path` (see snapshot.h).
+    // An older snapshot at `path` is only replaced once the new one is complete.
+    // `journalSequence` is the last journal entry applied to the book, recovery
+    // replays the journal from the entry after it (see journal.h)
+    SnapshotError saveSnapshot(const std::filesystem::path& path, std::uint64_t journalSequence = 0) const noexcept
+    {
+        SnapshotWriter writer{path};
+        return saveSnapshot(writer, journalSequence);
+    }
+    // Same through a writer prepared up front. Walking the book does not
+    // allocate, so this can run in the child of a fork() (see Checkpoint)
+    SnapshotError saveSnapshot(SnapshotWriter& writer, std::uint64_t journalSequence = 0) const noexcept;
+    // Rebuilds the book saved at `path` without matching anything: the file is
+    // mapped, checked, and read once front to back, appending every order to its
+    // level, then the orders are indexed, their expiries scheduled and the
+    // pending stops queued again. Only loads into a book that has not numbered an
+    // order yet and leaves the book untouched if it fails. No LevelUpdates are
+    // published, the sequence continues from the saved book
+    SnapshotError loadSnapshot(const std::filesystem::path& path) noexcept;
+
+    // Adapters, the tuple is empty ({0, {}, {}}) if the order was rejected
+    std::tuple<orderId_t, trades_t, OrderInfo> addOrder(quantity_t quantity, price_t price, OrderType type,
+                                                        Side side) noexcept;
+    RejectReason cancelOrder(orderId_t orderId) noexcept;
+    std::tuple<orderId_t, trades_t, OrderInfo> modifyOrder(orderId_t orderId, ModifyOrder modifications) noexcept;
+    std::optional<price_t> bestAsk() const noexcept;
+    std::optional<price_t> bestBid() const noexcept;
+    levels_t fullDepthAsk() const noexcept { return fullDepth(Side::Sell); }
+    levels_t fullDepthBid() const noexcept { return fullDepth(Side::Buy); }
+    // Writes the best min(n, out.size()) levels of `side` into `out`, best first,
+    // and returns how many were written. Does not allocate
+    size_t topDepth(Side side, size_t n, std::span<LevelView> out) const noexcept;
+    // The best cachedLevels levels of `side`. The copy is only refreshed when a
+    // level inside it changed since the last call, so asking after every
+    // command is cheap while the top of the book is quiet. Valid until the next
+    // mutating call
+    std::span<const LevelView> cachedTopDepth(Side side) const noexcept;
+    static constexpr size_t cachedLevels = 10;
+    size_t pendingStops() const noexcept { return stops_.size(); }
+    size_t restingOrders() const noexcept { return orders_.size(); }
+    // Heap bytes held by the book by part, with the high-water marks of the
+    // parts that shrink. Walks nothing but the pending stops, cheap enough to
+    // sample between commands
+    MemoryStats memoryStats() const noexcept;
+
+    // Pre-trade queries from the point of view of an incoming order on `side`,
+    // both are answered from the opposite side of the book.
+    // Volume an order on `side` limited at `limitPrice` could trade right now
+    uint64_t availableVolume(Side side, price_t limitPrice) const noexcept;
+    // Price * quantity of sweeping `quantity` from the best opposite level onwards,
+    // empty if the opposite side holds less than that
+    std::optional<notional_t> costToFill(Side side, uint64_t quantity) const noexcept;
+
+    Clock& clock() noexcept { return clock_; }
+    const Clock& clock() const noexcept { return clock_; }
 
 private:
-    struct InternalOrderInfo {
-        orderPtr_t order_;
-        orderPtrs_t::iterator location_;
-    };
-    struct LevelData {
-        uint32_t volume = 0;
-        uint32_t orderCnt = 0;
+    Levels<Side::Sell> ask_;
+    Levels<Side::Buy> bid_;
+    DepthIndex askDepth_{Side::Sell};
+    DepthIndex bidDepth_{Side::Buy};
+    // Hidden quantity of the resting icebergs of each side, the sum of PriceLevel::hidden
+    uint64_t askHidden_{0};
+    uint64_t bidHidden_{0};
+    // Declared ahead of the pool and the index, it has to outlive them
+    PageArena arena_;
+    OrderIndex orders_;
+    OrderPool pool_;
+    Clock clock_;
+
+    // Resting order that may expire. Cancelled, filled or replaced orders are not
+    // taken out of the schedules, their entries are skipped when they come due
+    struct ExpiringOrder {
+        orderId_t orderId;
+        orderHandle_t handle;
+        price_t price;
+        Side side;
     };
+    // GoodTillDate orders keyed by their expiry in microseconds
+    timer_wheel<ExpiringOrder> expiries_;
+    // GoodTillEOD orders rested during the current session
+    std::vector<ExpiringOrder> sessionOrders_;
+    std::vector<ExpiringOrder> expiring_;
+
+    // Stops waiting for their trigger, and the ones triggered by the current
+    // command that still have to be matched
+    StopIndex stops_;
+    std::vector<StopOrder> triggered_;
+    // Price of the last trade, stops trigger against it
+    std::optional<price_t> lastTradePrice_;
+    // Orders rest without matching while set, see startAuction
+    bool auction_{false};
+    mutable AuctionSearch auctionSearch_;
 
-    std::map<price_t, orderPtrs_t, std::less<price_t>> ask_;
-    std::map<price_t, orderPtrs_t, std::greater<price_t>> bid_;
-    std::map<price_t, LevelData> levelData_;
-    std::unordered_map<orderId_t, InternalOrderInfo> orders_;
+    // How many commands ahead process() prefetches the order node, the index slot
+    // is prefetched twice as far ahead so that it is cached when the handle is read
+    static constexpr size_t prefetchDistance = 8;
 
     // TODO: change defualt to 0 when orderId_t strong type is implemented. now id == 0 means that order was rejected
     orderId_t lastOrderId_{1};
+    // Sequence number of the last LevelUpdate
+    uint64_t levelSequence_{0};
+    // Sequence number of the last OrderEvent
+    uint64_t orderSequence_{0};
+
+    struct TopDepthCache {
+        std::array<LevelView, cachedLevels> levels{};
+        size_t size{0};
+        bool stale{true};
+    };
+    // Filled lazily by cachedTopDepth(), marked stale by publishLevel()
+    mutable TopDepthCache askTop_;
+    mutable TopDepthCache bidTop_;
+
+    orderHandle_t newOrder(quantity_t quantity, price_t price, OrderType type, Side side, microsec_t expiry,
+                           quantity_t peak) noexcept;
+    // addOrder and addIcebergOrder, peak is 0 for orders that are not icebergs
+    template <typename Sink>
+    OrderStatus submitOrder(quantity_t quantity, quantity_t peak, price_t price, OrderType type, Side side,
+                            microsec_t expiry, Sink& sink) noexcept;
+    // Picks the side once, everything below matchOrder<S> is compiled separately
+    // for buy and sell orders and does not look at the side of the order again
+    template <typename Sink>
+    void matchOrder(orderHandle_t handle, Sink& sink) noexcept;
+    template <Side S, typename Sink>
+    void matchOrder(orderHandle_t handle, Sink& sink) noexcept;
+    template <Side S, typename Sink>
+    void matchAgainst(OrderRef order, Sink& sink) noexcept;
+    // Fills `quantity` of `resting`, the first order of `level` (the level at `price`
+    // of side S), then shows the next clip of an iceberg or removes a filled order
+    template <Side S, typename Sink>
+    void fillFront(PriceLevel& level, price_t price, OrderRef resting, quantity_t quantity, Sink& sink) noexcept;
+    // Matches the stops the last trade triggered, see addStopOrder
+    template <typename Sink>
+    void triggerStops(Sink& sink) noexcept;
+    void processAddedOrder(orderHandle_t handle) noexcept;
+    bool canBeFullyFilled(price_t price, quantity_t quantity, Side side) const noexcept;
+    bool doesCrossSpread(price_t price, Side side) const noexcept;
+    template <Side S>
+    bool canBeFullyFilled(price_t price, quantity_t quantity) const noexcept;
+    template <Side S>
+    bool doesCrossSpread(price_t price) const noexcept;
+    template <Side S>
+    uint64_t availableVolume(price_t limitPrice) const noexcept;
+    template <Side S, typename Sink>
+    void addAtOrderPrice(orderHandle_t handle, Sink& sink) noexcept;
+    template <typename Sink>
+    void reduceInPlace(orderHandle_t handle, quantity_t quantity, Sink& sink) noexcept;
+    // Reports the current state of a level that was just changed, call before erasing an emptied level
+    template <typename Sink>
+    void publishLevel(Side side, price_t price, const PriceLevel& level, Sink& sink) noexcept;
+    template <typename Sink>
+    void publishOrder(OrderEventType type, ConstOrderRef order, quantity_t quantity, Sink& sink,
+                      uint32_t queuePosition = 0) noexcept;
+    template <typename Sink>
+    void purgeOrders(std::vector<ExpiringOrder>& orders, Sink& sink) noexcept;
+    void groupByLevel(std::vector<ExpiringOrder>& orders) noexcept;
+    bool validSnapshot(const SnapshotHeader& header, std::span<const SnapshotOrder> resting,
+                       std::span<const SnapshotOrder> stops) const noexcept;
+    levels_t fullDepth(Side side) const noexcept;
+    void prefetchIndex(const Command& command) const noexcept;
+    void prefetchOrder(const Command& command) const noexcept;
+    // Order::validate plus whether the side container can hold the price
+    RejectReason checkOrder(quantity_t quantity, price_t price, OrderType type, Side side, microsec_t expiry,
+                            quantity_t peak = 0) const noexcept;
+    TopDepthCache& topCacheOf(Side side) const { return side == Side::Sell ? askTop_ : bidTop_; }
+    DepthIndex& depthOf(Side side) { return side == Side::Sell ? askDepth_ : bidDepth_; }
+    const DepthIndex& depthOf(Side side) const { return side == Side::Sell ? askDepth_ : bidDepth_; }
+    uint64_t& hiddenOf(Side side) { return side == Side::Sell ? askHidden_ : bidHidden_; }
 
-    orderPtr_t newOrder(quantity_t quantity, price_t price, OrderType type, Side side);
-    trades_t matchOrder(orderPtr_t order);
-    microsec_t getCurrTime() const;
-    void processAddedOrder(orderPtr_t order);
-    bool canBeFullyFilled(price_t price, quantity_t quantity, Side side) const;
-    bool doesCrossSpread(price_t price, Side side) const;
-    void addAtOrderPrice(orderPtr_t order);
-    levels_t fullDepth(Side side) const;
+    // Whether an order on side S limited at `limit` may trade with a level at `price`
+    // of the other side. Market orders are limited at the worst price of their side
+    template <Side S>
+    static constexpr bool reaches(price_t limit, price_t price) noexcept
+    {
+        return !priceOrder_t<opposite(S)>{}(limit, price);
+    }
+    template <Side S>
+    static constexpr price_t worstPrice = S == Side::Buy ? std::numeric_limits<price_t>::max()
+                                                         : std::numeric_limits<price_t>::min();
+
+    template <Side S>
+    auto& levelsOf() noexcept
+    {
+        if constexpr (S == Side::Sell)
+            return ask_;
+        else
+            return bid_;
+    }
+    template <Side S>
+    const auto& levelsOf() const noexcept
+    {
+        if constexpr (S == Side::Sell)
+            return ask_;
+        else
+            return bid_;
+    }
+    template <Side S>
+    DepthIndex& depthOf() noexcept
+    {
+        return S == Side::Sell ? askDepth_ : bidDepth_;
+    }
+    template <Side S>
+    const DepthIndex& depthOf() const noexcept
+    {
+        return S == Side::Sell ? askDepth_ : bidDepth_;
+    }
+    template <Side S>
+    uint64_t& hiddenOf() noexcept
+    {
+        return S == Side::Sell ? askHidden_ : bidHidden_;
+    }
+    template <Side S>
+    uint64_t hiddenOf() const noexcept
+    {
+        return S == Side::Sell ? askHidden_ : bidHidden_;
+    }
+
+    // Calls fn with the side container of `side`, which must be Buy or Sell
+    template <typename Fn>
+    void withLevels(Side side, Fn&& fn) noexcept
+    {
+        if (side == Side::Sell)
+            fn(ask_);
+        else
+            fn(bid_);
+    }
+    template <typename Fn>
+    void withLevels(Side side, Fn&& fn) const noexcept
+    {
+        if (side == Side::Sell)
+            fn(ask_);
+        else
+            fn(bid_);
+    }
 };
+
+using Orderbook = BasicOrderbook<MapLevels>;
+using LadderOrderbook = BasicOrderbook<TickLevels>;
+// Time only moves when the owner sets it, for deterministic replays
+using ManualClockOrderbook = BasicOrderbook<MapLevels, ManualClock>;
+
+// PRIVATE FUNCTION IMPLEMENTATIONS
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::matchOrder(orderHandle_t handle, Sink& sink) noexcept
+{
+    if (pool_[handle].getSide() == Side::Buy)
+        matchOrder<Side::Buy>(handle, sink);
+    else
+        matchOrder<Side::Sell>(handle, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S, typename Sink>
+void BasicOrderbook<Levels, Clock>::matchOrder(orderHandle_t handle, Sink& sink) noexcept
+{
+    OrderRef order = pool_[handle];
+    if (!auction_)
+        matchAgainst<S>(order, sink);
+
+    // For orders that are fine to rest on the book, fill orders that have a
+    // valid price and leave the rest on the book
+    if (!order.isFullyFilled() && Order::canRest(order.getType())) {
+        if (order.getPeak() != 0)
+            order.hideReserve();
+        addAtOrderPrice<S>(handle, sink);
+        processAddedOrder(handle);
+        return;
+    }
+
+    if (!order.isFullyFilled())
+        sink.onCancel(order.getOrderId(), order.getRemainingQuantity());
+    pool_.release(handle);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S, typename Sink>
+void BasicOrderbook<Levels, Clock>::matchAgainst(OrderRef order, Sink& sink) noexcept
+{
+    constexpr Side other = opposite(S);
+    auto& levels = levelsOf<other>();
+    orderId_t orderId = order.getOrderId();
+    price_t limit = order.getType() == OrderType::Market ? worstPrice<S> : order.getPrice();
+
+    while (!levels.empty() && !order.isFullyFilled()) {
+        price_t currPrice = levels.bestPrice();
+        if (!reaches<S>(limit, currPrice))
+            break;
+
+        PriceLevel& level = levels.best();
+        OrderQueue& orders = level.orders;
+        while (!orders.empty() && !order.isFullyFilled()) {
+            OrderRef resting = pool_[orders.head];
+            quantity_t toFill = std::min(order.getRemainingQuantity(), resting.getRemainingQuantity());
+
+            Trade trade;
+            if constexpr (S == Side::Buy)
+                trade = newTrade(orderId, resting.getOrderId(), toFill, currPrice);
+            else
+                trade = newTrade(resting.getOrderId(), orderId, toFill, currPrice);
+
+            order.fill(toFill);
+            sink.onTrade(trade);
+            fillFront<other>(level, currPrice, resting, toFill, sink);
+        }
+
+        lastTradePrice_ = currPrice;
+        publishLevel(other, currPrice, level, sink);
+        if (orders.empty())
+            levels.erase(currPrice);
+    }
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S, typename Sink>
+void BasicOrderbook<Levels, Clock>::fillFront(PriceLevel& level, price_t price, OrderRef resting, quantity_t quantity,
+                                              Sink& sink) noexcept
+{
+    OrderQueue& orders = level.orders;
+    orderHandle_t handle = orders.head;
+    resting.fill(quantity);
+    publishOrder(resting.isFullyFilled() ? OrderEventType::Filled : OrderEventType::Executed, resting, quantity,
+                 sink);
+    level.volume -= quantity;
+    depthOf<S>().remove(price, quantity);
+
+    if (resting.isFullyFilled() && resting.getHiddenQuantity() != 0) {
+        // Iceberg shows its next clip behind the rest of the level, same node and id
+        quantity_t clip = resting.refresh();
+        pool_.unlink(orders, handle);
+        pool_.pushBack(orders, handle);
+        level.volume += clip;
+        level.hidden -= clip;
+        hiddenOf<S>() -= clip;
+        depthOf<S>().add(price, clip);
+        sink.onRefresh(resting.getOrderId(), clip);
+        publishOrder(OrderEventType::Added, resting, clip, sink, level.orderCnt - 1);
+    } else if (resting.isFullyFilled()) {
+        level.orderCnt--;
+        orders_.erase(resting.getOrderId());
+        pool_.unlink(orders, handle);
+        pool_.release(handle);
+    }
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::triggerStops(Sink& sink) noexcept
+{
+    if (stops_.empty() || !lastTradePrice_.has_value())
+        return;
+
+    // Triggered stops queue up in triggered_, each one is matched and the price
+    // of its last trade checked against the pending stops before the next one
+    for (size_t next = 0;; ++next) {
+        stops_.popTriggered(lastTradePrice_.value(), triggered_);
+        if (next == triggered_.size())
+            break;
+
+        StopOrder stop = triggered_[next];
+        OrderType type = stop.type == OrderType::StopLimit ? OrderType::GoodTillCancel : OrderType::Market;
+        // The limit fitted the side container when the stop was added, the
+        // container may have moved since
+        if (checkOrder(stop.quantity, stop.price, type, stop.side, microsec_t{0}) != RejectReason::None) {
+            sink.onCancel(stop.orderId, stop.quantity);
+            continue;
+        }
+
+        orderHandle_t handle = pool_.acquire(stop.orderId, stop.quantity, stop.price, type, stop.side, stop.openTime);
+        sink.onTrigger(stop.orderId, OrderInfo{.price = stop.price, .quantity = stop.quantity, .side = stop.side,
+                                               .type = type});
+        matchOrder(handle, sink);
+    }
+    triggered_.clear();
+}
+
+template <template <Side> class Levels, typename Clock>
+void BasicOrderbook<Levels, Clock>::processAddedOrder(orderHandle_t handle) noexcept
+{
+    ConstOrderRef order = pool_[handle];
+    orders_.insert(order.getOrderId(), handle);
+
+    ExpiringOrder entry{
+        .orderId = order.getOrderId(), .handle = handle, .price = order.getPrice(), .side = order.getSide()};
+    if (order.getType() == OrderType::GoodTillDate)
+        expiries_.insert(static_cast<uint64_t>(order.getExpiry().count()), entry);
+    else if (order.getType() == OrderType::GoodTillEOD)
+        sessionOrders_.push_back(entry);
+}
+
+template <template <Side> class Levels, typename Clock>
+bool BasicOrderbook<Levels, Clock>::canBeFullyFilled(price_t price, quantity_t quantity, Side side) const noexcept
+{
+    return side == Side::Buy ? canBeFullyFilled<Side::Buy>(price, quantity)
+                             : canBeFullyFilled<Side::Sell>(price, quantity);
+}
+
+template <template <Side> class Levels, typename Clock>
+bool BasicOrderbook<Levels, Clock>::doesCrossSpread(price_t price, Side side) const noexcept
+{
+    return side == Side::Buy ? doesCrossSpread<Side::Buy>(price) : doesCrossSpread<Side::Sell>(price);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S>
+bool BasicOrderbook<Levels, Clock>::canBeFullyFilled(price_t price, quantity_t quantity) const noexcept
+{
+    if (!doesCrossSpread<S>(price))
+        return false;
+    if (availableVolume<S>(price) >= quantity)
+        return true;
+    if (hiddenOf<opposite(S)>() == 0)
+        return false;
+
+    // Matching shows the next clips of icebergs it reaches, so their hidden
+    // quantity fills the order as well
+    uint64_t volume = 0;
+    levelsOf<opposite(S)>().forEach([&](price_t levelPrice, const PriceLevel& level) {
+        if (!reaches<S>(price, levelPrice))
+            return false;
+        volume += uint64_t{level.volume} + level.hidden;
+        return volume < quantity;
+    });
+    return volume >= quantity;
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S>
+bool BasicOrderbook<Levels, Clock>::doesCrossSpread(price_t price) const noexcept
+{
+    const auto& levels = levelsOf<opposite(S)>();
+    return !levels.empty() && reaches<S>(price, levels.bestPrice());
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S, typename Sink>
+void BasicOrderbook<Levels, Clock>::addAtOrderPrice(orderHandle_t handle, Sink& sink) noexcept
+{
+    ConstOrderRef order = pool_[handle];
+    PriceLevel& level = levelsOf<S>()[order.getPrice()];
+    pool_.pushBack(level.orders, handle);
+    level.volume += order.getRemainingQuantity();
+    level.orderCnt++;
+    level.hidden += order.getHiddenQuantity();
+    hiddenOf<S>() += order.getHiddenQuantity();
+    publishLevel(S, order.getPrice(), level, sink);
+    publishOrder(OrderEventType::Added, order, order.getRemainingQuantity(), sink, level.orderCnt - 1);
+    depthOf<S>().add(order.getPrice(), order.getRemainingQuantity());
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::reduceInPlace(orderHandle_t handle, quantity_t quantity, Sink& sink) noexcept
+{
+    OrderRef order = pool_[handle];
+    // Hidden quantity of an iceberg goes first
+    quantity_t shown = order.getRemainingQuantity();
+    quantity_t hidden = order.getHiddenQuantity();
+    order.reduceRemaining(quantity);
+    quantity_t delta = shown - order.getRemainingQuantity();
+    quantity_t hiddenDelta = hidden - order.getHiddenQuantity();
+
+    withLevels(order.getSide(), [&](auto& levels) {
+        PriceLevel& level = *levels.find(order.getPrice());
+        level.volume -= delta;
+        level.hidden -= hiddenDelta;
+        publishLevel(order.getSide(), order.getPrice(), level, sink);
+    });
+    depthOf(order.getSide()).remove(order.getPrice(), delta);
+    hiddenOf(order.getSide()) -= hiddenDelta;
+    publishOrder(OrderEventType::Amended, order, order.getRemainingQuantity(), sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::publishLevel(Side side, price_t price, const PriceLevel& level,
+                                                 Sink& sink) noexcept
+{
+    // Anything at or better than the worst cached level (or anywhere, while the
+    // side has fewer levels than the cache holds) changes the top of the book
+    TopDepthCache& top = topCacheOf(side);
+    if (!top.stale && (top.size < cachedLevels || (side == Side::Sell ? price <= top.levels[top.size - 1].price
+                                                                      : price >= top.levels[top.size - 1].price)))
+        top.stale = true;
+
+    sink.onLevelChange(LevelUpdate{.sequence = ++levelSequence_,
+                                   .price = price,
+                                   .volume = level.volume,
+                                   .orderCnt = level.orderCnt,
+                                   .side = side});
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::publishOrder(OrderEventType type, ConstOrderRef order, quantity_t quantity,
+                                                 Sink& sink, uint32_t queuePosition) noexcept
+{
+    sink.onOrderEvent(OrderEvent{.sequence = ++orderSequence_,
+                                 .orderId = order.getOrderId(),
+                                 .price = order.getPrice(),
+                                 .quantity = quantity,
+                                 .queuePosition = queuePosition,
+                                 .type = type,
+                                 .side = order.getSide()});
+}
+
+// Cancels the orders that are still resting, grouped by level (bids from the
+// lowest price, then asks), so every level is looked up, updated and (if it
+// empties) erased once per purge instead of once per order. Within a level the
+// orders are cancelled in the order they are listed. Clears `orders`
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::purgeOrders(std::vector<ExpiringOrder>& orders, Sink& sink) noexcept
+{
+    std::erase_if(orders, [&](const ExpiringOrder& entry) { return orders_.find(entry.orderId) != entry.handle; });
+    groupByLevel(orders);
+
+    for (size_t first = 0; first < orders.size();) {
+        Side side = orders[first].side;
+        price_t price = orders[first].price;
+        size_t last = first;
+        uint64_t volume = 0;
+        uint64_t hidden = 0;
+
+        withLevels(side, [&](auto& levels) {
+            PriceLevel& level = *levels.find(price);
+            for (; last < orders.size() && orders[last].side == side && orders[last].price == price; ++last) {
+                const ExpiringOrder& entry = orders[last];
+                ConstOrderRef order = pool_[entry.handle];
+                volume += order.getRemainingQuantity();
+                hidden += order.getHiddenQuantity();
+                sink.onCancel(entry.orderId, order.getOpenQuantity());
+                publishOrder(OrderEventType::Cancelled, order, order.getRemainingQuantity(), sink);
+                orders_.erase(entry.orderId);
+                pool_.unlink(level.orders, entry.handle);
+                pool_.release(entry.handle);
+            }
+            level.volume -= static_cast<uint32_t>(volume);
+            level.orderCnt -= static_cast<uint32_t>(last - first);
+            level.hidden -= static_cast<uint32_t>(hidden);
+            publishLevel(side, price, level, sink);
+            if (level.orders.empty())
+                levels.erase(price);
+        });
+        depthOf(side).remove(price, static_cast<quantity_t>(volume));
+        hiddenOf(side) -= hidden;
+        first = last;
+    }
+    orders.clear();
+}
+
+// Stable counting sort on (side, price) over the price range of the entries.
+// Falls back to std::stable_sort if the range is much wider than the number of entries
+template <template <Side> class Levels, typename Clock>
+void BasicOrderbook<Levels, Clock>::groupByLevel(std::vector<ExpiringOrder>& orders) noexcept
+{
+    if (orders.size() < 2)
+        return;
+
+    auto [low, high] = std::ranges::minmax(orders | std::views::transform(&ExpiringOrder::price));
+    size_t range = static_cast<size_t>(static_cast<int64_t>(high) - low + 1);
+    auto key = [&](const ExpiringOrder& entry) {
+        return static_cast<size_t>(entry.price - low) + (entry.side == Side::Sell ? range : 0);
+    };
+
+    if (range > 4 * orders.size() + 1024) {
+        std::ranges::stable_sort(orders, {}, key);
+        return;
+    }
+
+    std::vector<uint32_t> offsets(2 * range + 1, 0);
+    for (const auto& entry : orders)
+        offsets[key(entry) + 1]++;
+    for (size_t i = 1; i < offsets.size(); ++i)
+        offsets[i] += offsets[i - 1];
+
+    std::vector<ExpiringOrder> grouped(orders.size());
+    for (const auto& entry : orders)
+        grouped[offsets[key(entry)]++] = entry;
+    orders.swap(grouped);
+}
+
+// Everything loadSnapshot relies on: every resting record could rest on this
+// book (only icebergs hide quantity), the sides do not cross, every stop record
+// is a stop that was never filled and no id is above the saved id counter
+template <template <Side> class Levels, typename Clock>
+bool BasicOrderbook<Levels, Clock>::validSnapshot(const SnapshotHeader& header, std::span<const SnapshotOrder> resting,
+                                                  std::span<const SnapshotOrder> stops) const noexcept
+{
+    for (const SnapshotOrder& record : stops) {
+        if (Order::validate(record.remainingQuantity, record.price, record.type, record.side) != RejectReason::None ||
+            !Order::isStop(record.type) || record.remainingQuantity != record.initialQuantity ||
+            record.hiddenQuantity != 0 || record.peak != 0 ||
+            record.expiry < std::numeric_limits<price_t>::min() ||
+            record.expiry > std::numeric_limits<price_t>::max() || record.expiry == badValues::price ||
+            record.orderId == 0 || record.orderId > header.lastOrderId)
+            return false;
+    }
+
+    std::array<price_t, 2> low{std::numeric_limits<price_t>::max(), std::numeric_limits<price_t>::max()};
+    std::array<price_t, 2> high{std::numeric_limits<price_t>::min(), std::numeric_limits<price_t>::min()};
+    for (const SnapshotOrder& record : resting) {
+        if (Order::validate(record.remainingQuantity, record.price, record.type, record.side) != RejectReason::None ||
+            !Order::canRest(record.type) ||
+            uint64_t{record.remainingQuantity} + record.hiddenQuantity > record.initialQuantity ||
+            (record.peak == 0 && record.hiddenQuantity != 0) ||
+            (record.peak != 0 && record.remainingQuantity > record.peak) ||
+            record.orderId == 0 || record.orderId > header.lastOrderId)
+            return false;
+
+        size_t idx = record.side == Side::Sell ? 1 : 0;
+        low[idx] = std::min(low[idx], record.price);
+        high[idx] = std::max(high[idx], record.price);
+    }
+
+    // Every id indexes one order, a repeated one would leave the other unreachable
+    std::vector<orderId_t> ids;
+    ids.reserve(resting.size() + stops.size());
+    for (const SnapshotOrder& record : resting)
+        ids.push_back(record.orderId);
+    for (const SnapshotOrder& record : stops)
+        ids.push_back(record.orderId);
+    std::ranges::sort(ids);
+    if (std::ranges::adjacent_find(ids) != ids.end())
+        return false;
+
+    // Each side has to hold its price range, checked on an empty container of the same kind
+    auto fits = [](const auto& levels, price_t lowPrice, price_t highPrice) {
+        std::remove_cvref_t<decltype(levels)> probe;
+        probe[lowPrice];
+        return probe.fits(highPrice);
+    };
+    bool hasBids = low[0] <= high[0];
+    bool hasAsks = low[1] <= high[1];
+    if ((hasBids && !fits(bid_, low[0], high[0])) || (hasAsks && !fits(ask_, low[1], high[1])))
+        return false;
+    // Only a book in an auction may be crossed
+    return !hasBids || !hasAsks || high[0] < low[1] || header.inAuction != 0;
+}
+
+template <template <Side> class Levels, typename Clock>
+levels_t BasicOrderbook<Levels, Clock>::fullDepth(Side side) const noexcept
+{
+    levels_t levels;
+    withLevels(side, [&](const auto& sideLevels) {
+        levels.reserve(sideLevels.size());
+        sideLevels.forEach([&](price_t price, const PriceLevel& level) {
+            levels.push_back(LevelView{.price = price, .volume = level.volume, .orderCnt = level.orderCnt});
+            return true;
+        });
+    });
+
+    return levels;
+}
+
+template <template <Side> class Levels, typename Clock>
+orderHandle_t BasicOrderbook<Levels, Clock>::newOrder(quantity_t quantity, price_t price, OrderType type, Side side,
+                                                      microsec_t expiry, quantity_t peak) noexcept
+{
+    return pool_.acquire(++lastOrderId_, quantity, price, type, side, clock_.now(), expiry, peak);
+}
+
+template <template <Side> class Levels, typename Clock>
+void BasicOrderbook<Levels, Clock>::prefetchIndex(const Command& command) const noexcept
+{
+    if (command.action == Actions::CANCEL || command.action == Actions::MODIFY)
+        orders_.prefetch(command.oid);
+}
+
+template <template <Side> class Levels, typename Clock>
+void BasicOrderbook<Levels, Clock>::prefetchOrder(const Command& command) const noexcept
+{
+    if (command.action == Actions::ADD) {
+        if (command.side == Side::Buy || command.side == Side::Sell)
+            withLevels(command.side, [&](const auto& levels) { levels.prefetch(command.price); });
+    } else if (command.action == Actions::CANCEL || command.action == Actions::MODIFY) {
+        orderHandle_t handle = orders_.find(command.oid);
+        if (handle != badValues::orderHandle)
+            pool_.prefetch(handle);
+    }
+}
+
+template <template <Side> class Levels, typename Clock>
+RejectReason BasicOrderbook<Levels, Clock>::checkOrder(quantity_t quantity, price_t price, OrderType type, Side side,
+                                                       microsec_t expiry, quantity_t peak) const noexcept
+{
+    RejectReason reason = Order::validate(quantity, price, type, side);
+    if (reason != RejectReason::None)
+        return reason;
+    // Commands parsed or replayed without a peak carry the bad value
+    if (peak == badValues::quantity)
+        return RejectReason::BadQuantity;
+    if (peak != 0 && !Order::canRest(type))
+        return RejectReason::BadType;
+    // Stops only get to the book through addStopOrder, which checks the order they turn into
+    if (Order::isStop(type))
+        return RejectReason::BadTrigger;
+    if (type == OrderType::GoodTillDate && expiry <= clock_.now())
+        return RejectReason::BadExpiry;
+    if (auction_ && !Order::canRest(type))
+        return RejectReason::InAuction;
+
+    // Only orders that may rest on the book need a level at their price
+    bool fits = true;
+    if (Order::canRest(type))
+        withLevels(side, [&](const auto& levels) { fits = levels.fits(price); });
+    return fits ? RejectReason::None : RejectReason::PriceOutOfRange;
+}
+
+// PUBLIC FUNCTION IMPLEMENTATIONS
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+OrderStatus BasicOrderbook<Levels, Clock>::addOrder(quantity_t quantity, price_t price, OrderType type, Side side,
+                                                    Sink& sink) noexcept
+{
+    return addOrder(quantity, price, type, side, microsec_t{0}, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+OrderStatus BasicOrderbook<Levels, Clock>::addOrder(quantity_t quantity, price_t price, OrderType type, Side side,
+                                                    microsec_t expiry, Sink& sink) noexcept
+{
+    return submitOrder(quantity, 0, price, type, side, expiry, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+OrderStatus BasicOrderbook<Levels, Clock>::addIcebergOrder(quantity_t quantity, quantity_t peak, price_t price,
+                                                           OrderType type, Side side, microsec_t expiry,
+                                                           Sink& sink) noexcept
+{
+    // checkOrder refuses the bad value, 0 would make it a plain order
+    if (peak == 0) {
+        sink.onReject(0, RejectReason::BadQuantity);
+        return OrderStatus{.reason = RejectReason::BadQuantity};
+    }
+    return submitOrder(quantity, peak, price, type, side, expiry, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+OrderStatus BasicOrderbook<Levels, Clock>::submitOrder(quantity_t quantity, quantity_t peak, price_t price,
+                                                       OrderType type, Side side, microsec_t expiry,
+                                                       Sink& sink) noexcept
+{
+    RejectReason reason = checkOrder(quantity, price, type, side, expiry, peak);
+    if (reason != RejectReason::None) {
+        sink.onReject(0, reason);
+        return OrderStatus{.reason = reason};
+    }
+    if (type != OrderType::GoodTillDate)
+        expiry = microsec_t{0};
+
+    orderHandle_t handle = newOrder(quantity, price, type, side, expiry, peak);
+    orderId_t orderId = pool_[handle].getOrderId();
+
+    if (type == OrderType::FillAndKill && !doesCrossSpread(price, side))
+        reason = RejectReason::NotCrossing;
+    else if (type == OrderType::FillOrKill && !canBeFullyFilled(price, quantity, side))
+        reason = RejectReason::InsufficientLiquidity;
+    if (reason != RejectReason::None) {
+        pool_.release(handle);
+        sink.onReject(orderId, reason);
+        return OrderStatus{.orderId = orderId, .reason = reason};
+    }
+
+    // TODO: use OrderInfo in args as well instead of 4 different variables
+    sink.onAccept(orderId, OrderInfo{.price = price, .quantity = quantity, .side = side, .type = type});
+    matchOrder(handle, sink);
+    triggerStops(sink);
+    return OrderStatus{.orderId = orderId};
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+OrderStatus BasicOrderbook<Levels, Clock>::addStopOrder(quantity_t quantity, price_t trigger, price_t price,
+                                                        OrderType type, Side side, Sink& sink) noexcept
+{
+    if (type == OrderType::Stop)
+        price = trigger;
+    RejectReason reason = RejectReason::None;
+    if (!Order::isStop(type))
+        reason = RejectReason::BadType;
+    else if (trigger == badValues::price)
+        reason = RejectReason::BadTrigger;
+    else
+        reason = checkOrder(quantity, price,
+                            type == OrderType::StopLimit ? OrderType::GoodTillCancel : OrderType::Market, side,
+                            microsec_t{0});
+    if (reason != RejectReason::None) {
+        sink.onReject(0, reason);
+        return OrderStatus{.reason = reason};
+    }
+
+    orderId_t orderId = ++lastOrderId_;
+    sink.onAccept(orderId, OrderInfo{.price = price, .quantity = quantity, .side = side, .type = type});
+    stops_.insert(StopOrder{.orderId = orderId,
+                            .openTime = clock_.now(),
+                            .trigger = trigger,
+                            .price = price,
+                            .quantity = quantity,
+                            .type = type,
+                            .side = side});
+    triggerStops(sink);
+    return OrderStatus{.orderId = orderId};
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+RejectReason BasicOrderbook<Levels, Clock>::cancelOrder(orderId_t orderId, Sink& sink) noexcept
+{
+    orderHandle_t handle = orders_.find(orderId);
+    if (handle == badValues::orderHandle) {
+        if (auto stop = stops_.erase(orderId)) {
+            sink.onCancel(orderId, stop->quantity);
+            return RejectReason::None;
+        }
+        sink.onReject(orderId, RejectReason::UnknownOrder);
+        return RejectReason::UnknownOrder;
+    }
+    orders_.erase(orderId);
+
+    ConstOrderRef order = pool_[handle];
+    price_t price = order.getPrice();
+
+    withLevels(order.getSide(), [&](auto& levels) {
+        PriceLevel& level = *levels.find(price);
+        pool_.unlink(level.orders, handle);
+        level.volume -= order.getRemainingQuantity();
+        level.orderCnt--;
+        level.hidden -= order.getHiddenQuantity();
+        publishLevel(order.getSide(), price, level, sink);
+        if (level.orders.empty())
+            levels.erase(price);
+    });
+    depthOf(order.getSide()).remove(price, order.getRemainingQuantity());
+    hiddenOf(order.getSide()) -= order.getHiddenQuantity();
+    sink.onCancel(orderId, order.getOpenQuantity());
+    publishOrder(OrderEventType::Cancelled, order, order.getRemainingQuantity(), sink);
+    pool_.release(handle);
+    return RejectReason::None;
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+OrderStatus BasicOrderbook<Levels, Clock>::modifyOrder(orderId_t orderId, ModifyOrder modifications,
+                                                       Sink& sink) noexcept
+{
+    orderHandle_t handle = orders_.find(orderId);
+    if (handle == badValues::orderHandle) {
+        sink.onReject(orderId, RejectReason::UnknownOrder);
+        return OrderStatus{.orderId = orderId, .reason = RejectReason::UnknownOrder};
+    }
+
+    ConstOrderRef oldOrder = pool_[handle];
+
+    quantity_t quantity =
+        modifications.quantity.has_value() ? modifications.quantity.value() : oldOrder.getOpenQuantity();
+    price_t price = modifications.price.has_value() ? modifications.price.value() : oldOrder.getPrice();
+    OrderType type = modifications.type.has_value() ? modifications.type.value() : oldOrder.getType();
+    Side side = modifications.side.has_value() ? modifications.side.value() : oldOrder.getSide();
+    // A replaced order keeps its expiry and peak
+    microsec_t expiry = oldOrder.getExpiry();
+    quantity_t peak = oldOrder.getPeak();
+
+    RejectReason reason = checkOrder(quantity, price, type, side, expiry, peak);
+    if (reason != RejectReason::None) {
+        sink.onReject(orderId, reason);
+        return OrderStatus{.orderId = orderId, .reason = reason};
+    }
+
+    if (price == oldOrder.getPrice() && side == oldOrder.getSide() && type == oldOrder.getType() &&
+        quantity <= oldOrder.getOpenQuantity()) {
+        reduceInPlace(handle, quantity, sink);
+        sink.onAmend(orderId, OrderInfo{.price = price, .quantity = quantity, .side = side, .type = type});
+        return OrderStatus{.orderId = orderId};
+    }
+
+    cancelOrder(orderId, sink);
+    return submitOrder(quantity, peak, price, type, side, expiry, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::process(std::span<const Command> commands, Sink& sink) noexcept
+{
+    for (size_t i = 0; i < commands.size(); ++i) {
+        if (i + 2 * prefetchDistance < commands.size())
+            prefetchIndex(commands[i + 2 * prefetchDistance]);
+        if (i + prefetchDistance < commands.size())
+            prefetchOrder(commands[i + prefetchDistance]);
+
+        const Command& command = commands[i];
+        if (command.action == Actions::ADD && Order::isStop(command.type))
+            addStopOrder(command.quantity, command.trigger, command.price, command.type, command.side, sink);
+        else if (command.action == Actions::ADD)
+            submitOrder(command.quantity, command.peak, command.price, command.type, command.side, command.expiry,
+                        sink);
+        else if (command.action == Actions::CANCEL)
+            cancelOrder(command.oid, sink);
+        else if (command.action == Actions::MODIFY)
+            modifyOrder(command.oid, command.modifications(), sink);
+    }
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::expireOrders(Sink& sink) noexcept
+{
+    auto now = static_cast<uint64_t>(clock_.now().count());
+    expiries_.advance(now, [&](const ExpiringOrder& entry) { expiring_.push_back(entry); });
+    purgeOrders(expiring_, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+void BasicOrderbook<Levels, Clock>::closeSession(Sink& sink) noexcept
+{
+    purgeOrders(sessionOrders_, sink);
+    expireOrders(sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+std::optional<Equilibrium> BasicOrderbook<Levels, Clock>::equilibrium() const noexcept
+{
+    if (ask_.empty() || bid_.empty() || bid_.bestPrice() < ask_.bestPrice())
+        return std::nullopt;
+    price_t low = ask_.bestPrice();
+    price_t high = bid_.bestPrice();
+
+    std::span<const int64_t> askTicks = askDepth_.ticks(low, high);
+    std::span<const int64_t> bidTicks = bidDepth_.ticks(high, low);
+    if (!askTicks.empty() && !bidTicks.empty()) {
+        // One candidate per tick, bidTicks runs from the top down
+        size_t count = askTicks.size();
+        auctionSearch_.resize(count);
+        std::span<price_t> prices = auctionSearch_.prices();
+        std::span<int64_t> asks = auctionSearch_.asks();
+        std::span<int64_t> bids = auctionSearch_.bids();
+        // The index only holds displayed quantity. With icebergs resting, the
+        // volume of every tick is staged in asks and bids (bids from the top down
+        // like bidTicks) and the hidden quantity is added level by level on the
+        // sides that hold any
+        bool hidden = askHidden_ != 0 || bidHidden_ != 0;
+        if (hidden) {
+            std::ranges::copy(askTicks, asks.begin());
+            std::ranges::copy(bidTicks, bids.begin());
+            if (askHidden_ != 0)
+                ask_.forEach([&](price_t price, const PriceLevel& level) {
+                    if (price > high)
+                        return false;
+                    asks[static_cast<size_t>(price - low)] += level.hidden;
+                    return true;
+                });
+            if (bidHidden_ != 0)
+                bid_.forEach([&](price_t price, const PriceLevel& level) {
+                    if (price < low)
+                        return false;
+                    bids[static_cast<size_t>(high - price)] += level.hidden;
+                    return true;
+                });
+            askTicks = asks;
+            std::ranges::reverse(bids);
+        }
+
+        // Ticks without a level on either side get no ask volume, which keeps them from being picked
+        int64_t volume = 0;
+        for (size_t i = 0; i < count; ++i) {
+            volume += askTicks[i];
+            prices[i] = low + static_cast<price_t>(i);
+            asks[i] = volume;
+        }
+        volume = 0;
+        for (size_t i = count; i-- > 0;) {
+            int64_t bidTick = hidden ? bids[i] : bidTicks[count - 1 - i];
+            volume += bidTick;
+            bids[i] = volume;
+            if (asks[i] == (i == 0 ? 0 : asks[i - 1]) && bidTick == 0)
+                asks[i] = 0;
+        }
+        return auctionSearch_.pick(lastTradePrice_);
+    }
+
+    // Some volume lies outside of the index windows, merge the crossed levels of both sides instead,
+    // counting the open (displayed and hidden) volume of each level
+    struct OpenLevel {
+        price_t price;
+        int64_t volume;
+    };
+    std::vector<OpenLevel> askLevels;
+    std::vector<OpenLevel> bidLevels;
+    auto openLevel = [](price_t price, const PriceLevel& level) {
+        return OpenLevel{.price = price, .volume = int64_t{level.volume} + level.hidden};
+    };
+    ask_.forEach([&](price_t price, const PriceLevel& level) {
+        if (price > high)
+            return false;
+        askLevels.push_back(openLevel(price, level));
+        return true;
+    });
+    bid_.forEach([&](price_t price, const PriceLevel& level) {
+        if (price < low)
+            return false;
+        bidLevels.push_back(openLevel(price, level));
+        return true;
+    });
+    std::ranges::reverse(bidLevels);
+
+    auctionSearch_.resize(askLevels.size() + bidLevels.size());
+    std::span<price_t> prices = auctionSearch_.prices();
+    std::span<int64_t> asks = auctionSearch_.asks();
+    std::span<int64_t> bids = auctionSearch_.bids();
+    size_t count = 0;
+    int64_t volume = 0;
+    for (size_t a = 0, b = 0; a < askLevels.size() || b < bidLevels.size(); ++count) {
+        price_t price = b == bidLevels.size() || (a < askLevels.size() && askLevels[a].price < bidLevels[b].price)
+                            ? askLevels[a].price
+                            : bidLevels[b].price;
+        bids[count] = 0;
+        if (a < askLevels.size() && askLevels[a].price == price)
+            volume += askLevels[a++].volume;
+        if (b < bidLevels.size() && bidLevels[b].price == price)
+            bids[count] = bidLevels[b++].volume;
+        prices[count] = price;
+        asks[count] = volume;
+    }
+    auctionSearch_.resize(count);
+    volume = 0;
+    for (size_t i = count; i-- > 0;) {
+        volume += bids[i];
+        bids[i] = volume;
+    }
+    return auctionSearch_.pick(lastTradePrice_);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <typename Sink>
+std::optional<Equilibrium> BasicOrderbook<Levels, Clock>::uncross(Sink& sink) noexcept
+{
+    auction_ = false;
+    std::optional<Equilibrium> result = equilibrium();
+    if (!result.has_value())
+        return result;
+
+    // Each pass trades the best bid level against the best ask level until one of
+    // them is empty, a level is published once it is empty or the volume is done
+    price_t price = result->price;
+    uint64_t left = result->volume;
+    while (left > 0) {
+        price_t bidPrice = bid_.bestPrice();
+        price_t askPrice = ask_.bestPrice();
+        PriceLevel& bidLevel = bid_.best();
+        PriceLevel& askLevel = ask_.best();
+        while (left > 0 && !bidLevel.orders.empty() && !askLevel.orders.empty()) {
+            OrderRef buy = pool_[bidLevel.orders.head];
+            OrderRef sell = pool_[askLevel.orders.head];
+            quantity_t quantity = static_cast<quantity_t>(
+                std::min<uint64_t>({buy.getRemainingQuantity(), sell.getRemainingQuantity(), left}));
+            sink.onTrade(newTrade(buy.getOrderId(), sell.getOrderId(), quantity, price));
+            fillFront<Side::Buy>(bidLevel, bidPrice, buy, quantity, sink);
+            fillFront<Side::Sell>(askLevel, askPrice, sell, quantity, sink);
+            left -= quantity;
+        }
+
+        if (bidLevel.orders.empty() || left == 0) {
+            publishLevel(Side::Buy, bidPrice, bidLevel, sink);
+            if (bidLevel.orders.empty())
+                bid_.erase(bidPrice);
+        }
+        if (askLevel.orders.empty() || left == 0) {
+            publishLevel(Side::Sell, askPrice, askLevel, sink);
+            if (askLevel.orders.empty())
+                ask_.erase(askPrice);
+        }
+    }
+
+    lastTradePrice_ = price;
+    triggerStops(sink);
+    return result;
+}
+
+template <template <Side> class Levels, typename Clock>
+SnapshotError BasicOrderbook<Levels, Clock>::saveSnapshot(SnapshotWriter& writer,
+                                                          std::uint64_t journalSequence) const noexcept
+{
+    writer.start();
+    auto writeSide = [&](const auto& levels) {
+        levels.forEach([&](price_t, const PriceLevel& level) {
+            for (orderHandle_t handle = level.orders.head; handle != badValues::orderHandle;
+                 handle = pool_.next(handle))
+                writer.append(SnapshotOrder::from(pool_[handle]));
+            return writer.ok();
+        });
+    };
+    writeSide(bid_);
+    writeSide(ask_);
+    stops_.forEach([&](const StopOrder& stop) { writer.append(SnapshotOrder::from(stop)); });
+
+    SnapshotHeader header{};
+    header.lastOrderId = lastOrderId_;
+    header.levelSequence = levelSequence_;
+    header.orderSequence = orderSequence_;
+    header.lastTradePrice = lastTradePrice_.value_or(badValues::price);
+    header.journalSequence = journalSequence;
+    header.inAuction = auction_;
+    return writer.commit(header);
+}
+
+template <template <Side> class Levels, typename Clock>
+SnapshotError BasicOrderbook<Levels, Clock>::loadSnapshot(const std::filesystem::path& path) noexcept
+{
+    if (lastOrderId_ != 1 || pool_.size() != 0)
+        return SnapshotError::BookInUse;
+
+    MappedFile file{path};
+    if (!file.ok())
+        return SnapshotError::Io;
+
+    auto bytes = file.bytes();
+    SnapshotHeader header;
+    if (bytes.size() < sizeof(header))
+        return SnapshotError::BadFormat;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (!header.matches(bytes.size()))
+        return SnapshotError::BadFormat;
+    // The mapping is page aligned and the header keeps the records aligned
+    std::span<const SnapshotOrder> all{reinterpret_cast<const SnapshotOrder*>(bytes.data() + sizeof(header)),
+                                       header.orderCount};
+    // Pending stops follow the resting orders
+    auto firstStop = std::ranges::find_if(all, [](const SnapshotOrder& record) { return Order::isStop(record.type); });
+    auto records = all.first(static_cast<size_t>(firstStop - all.begin()));
+    auto stops = all.subspan(records.size());
+    if (!validSnapshot(header, records, stops))
+        return SnapshotError::BadFormat;
+
+    // Orders of a level are next to each other in the file, so like in
+    // purgeOrders every level is looked up and updated once
+    pool_.reserve(records.size());
+    std::vector<orderHandle_t> handles(records.size());
+    for (size_t first = 0; first < records.size();) {
+        Side side = records[first].side;
+        price_t price = records[first].price;
+        size_t last = first;
+        uint64_t volume = 0;
+        uint64_t hidden = 0;
+
+        withLevels(side, [&](auto& levels) {
+            PriceLevel& level = levels[price];
+            for (; last < records.size() && records[last].side == side && records[last].price == price; ++last) {
+                orderHandle_t handle = pool_.acquire(records[last].toOrder());
+                pool_.pushBack(level.orders, handle);
+                handles[last] = handle;
+                volume += records[last].remainingQuantity;
+                hidden += records[last].hiddenQuantity;
+            }
+            level.volume += static_cast<uint32_t>(volume);
+            level.orderCnt += static_cast<uint32_t>(last - first);
+            level.hidden += static_cast<uint32_t>(hidden);
+        });
+        depthOf(side).add(price, static_cast<quantity_t>(volume));
+        hiddenOf(side) += hidden;
+        first = last;
+    }
+    // Ids are in queue order, so index inserts land on random pages. In a loop of
+    // their own the misses overlap, interleaved with the linking above they did
+    // not and took most of the load
+    for (orderHandle_t handle : handles)
+        processAddedOrder(handle);
+    // Saved in trigger order, inserting them in file order restores the queues
+    for (const SnapshotOrder& record : stops)
+        stops_.insert(record.toStop());
+
+    lastOrderId_ = header.lastOrderId;
+    levelSequence_ = header.levelSequence;
+    orderSequence_ = header.orderSequence;
+    if (header.lastTradePrice != badValues::price)
+        lastTradePrice_ = header.lastTradePrice;
+    auction_ = header.inAuction != 0;
+    askTop_.stale = true;
+    bidTop_.stale = true;
+    return SnapshotError::None;
+}
+
+template <template <Side> class Levels, typename Clock>
+std::tuple<orderId_t, trades_t, OrderInfo> BasicOrderbook<Levels, Clock>::addOrder(quantity_t quantity, price_t price,
+                                                                                   OrderType type, Side side) noexcept
+{
+    ExecutionCollector collector;
+    OrderStatus status = addOrder(quantity, price, type, side, collector);
+    if (!status.accepted())
+        return {};
+    return {status.orderId, std::move(collector.trades()), collector.info()};
+}
+
+template <template <Side> class Levels, typename Clock>
+RejectReason BasicOrderbook<Levels, Clock>::cancelOrder(orderId_t orderId) noexcept
+{
+    EventSink sink;
+    return cancelOrder(orderId, sink);
+}
+
+template <template <Side> class Levels, typename Clock>
+std::tuple<orderId_t, trades_t, OrderInfo>
+BasicOrderbook<Levels, Clock>::modifyOrder(orderId_t orderId, ModifyOrder modifications) noexcept
+{
+    ExecutionCollector collector;
+    OrderStatus status = modifyOrder(orderId, modifications, collector);
+    if (!status.accepted())
+        return {};
+    return {status.orderId, std::move(collector.trades()), collector.info()};
+}
+
+template <template <Side> class Levels, typename Clock>
+std::optional<price_t> BasicOrderbook<Levels, Clock>::bestAsk() const noexcept
+{
+    if (ask_.empty())
+        return {};
+    return ask_.bestPrice();
+}
+
+template <template <Side> class Levels, typename Clock>
+std::optional<price_t> BasicOrderbook<Levels, Clock>::bestBid() const noexcept
+{
+    if (bid_.empty())
+        return {};
+    return bid_.bestPrice();
+}
+
+template <template <Side> class Levels, typename Clock>
+size_t BasicOrderbook<Levels, Clock>::topDepth(Side side, size_t n, std::span<LevelView> out) const noexcept
+{
+    n = std::min(n, out.size());
+    size_t written = 0;
+    if (n == 0)
+        return 0;
+
+    withLevels(side, [&](const auto& sideLevels) {
+        sideLevels.forEach([&](price_t price, const PriceLevel& level) {
+            out[written++] = LevelView{.price = price, .volume = level.volume, .orderCnt = level.orderCnt};
+            return written < n;
+        });
+    });
+    return written;
+}
+
+template <template <Side> class Levels, typename Clock>
+std::span<const LevelView> BasicOrderbook<Levels, Clock>::cachedTopDepth(Side side) const noexcept
+{
+    TopDepthCache& top = topCacheOf(side);
+    if (top.stale) {
+        top.size = topDepth(side, cachedLevels, top.levels);
+        top.stale = false;
+    }
+    return std::span<const LevelView>{top.levels.data(), top.size};
+}
+
+template <template <Side> class Levels, typename Clock>
+uint64_t BasicOrderbook<Levels, Clock>::availableVolume(Side side, price_t limitPrice) const noexcept
+{
+    return side == Side::Buy ? availableVolume<Side::Buy>(limitPrice) : availableVolume<Side::Sell>(limitPrice);
+}
+
+template <template <Side> class Levels, typename Clock>
+template <Side S>
+uint64_t BasicOrderbook<Levels, Clock>::availableVolume(price_t limitPrice) const noexcept
+{
+    const DepthIndex& depth = depthOf<opposite(S)>();
+    if (depth.exact())
+        return depth.volumeUpTo(limitPrice);
+
+    // Some volume lies outside of the index window, walk the opposite side from
+    // its best level until the limit price is passed
+    uint64_t volume = 0;
+    levelsOf<opposite(S)>().forEach([&](price_t levelPrice, const PriceLevel& level) {
+        if (!reaches<S>(limitPrice, levelPrice))
+            return false;
+        volume += level.volume;
+        return true;
+    });
+    return volume;
+}
+
+template <template <Side> class Levels, typename Clock>
+std::optional<notional_t> BasicOrderbook<Levels, Clock>::costToFill(Side side, uint64_t quantity) const noexcept
+{
+    const DepthIndex& depth = depthOf(opposite(side));
+    if (depth.exact())
+        return depth.costToFill(quantity);
+
+    notional_t cost = 0;
+    withLevels(opposite(side), [&](const auto& levels) {
+        levels.forEach([&](price_t levelPrice, const PriceLevel& level) {
+            uint64_t take = std::min<uint64_t>(quantity, level.volume);
+            cost += static_cast<notional_t>(take) * levelPrice;
+            quantity -= take;
+            return quantity > 0;
+        });
+    });
+    if (quantity > 0)
+        return std::nullopt;
+    return cost;
+}
+
+template <template <Side> class Levels, typename Clock>
+BasicOrderbook<Levels, Clock>::BasicOrderbook(const StorageOptions& storage) noexcept
+    : arena_{OrderPool::bytesFor(storage.orders) + OrderIndex::bytesFor(storage.orders), storage.backing,
+             storage.prefault, storage.lock}
+    , orders_{&arena_}
+    , pool_{storage.orders, &arena_}
+{
+}
+
+template <template <Side> class Levels, typename Clock>
+MemoryStats BasicOrderbook<Levels, Clock>::memoryStats() const noexcept
+{
+    MemoryStats stats{.levels = ask_.memoryUse(), .orders = pool_.memoryUse(), .index = orders_.memoryUse()};
+    stats.levels += bid_.memoryUse();
+    stats.freePools = pool_.freeBytes() + orders_.freeBytes() + (arena_.capacity() - arena_.used());
+    stats.other = askDepth_.memoryBytes() + bidDepth_.memoryBytes() + expiries_.memory_bytes() +
+                  heapBytes::vector(sessionOrders_) + heapBytes::vector(expiring_) + stops_.memoryBytes() +
+                  heapBytes::vector(triggered_) + auctionSearch_.memoryBytes();
+    return stats;
+}
+
+extern template class BasicOrderbook<MapLevels>;
+extern template class BasicOrderbook<TickLevels>;
+extern template class BasicOrderbook<MapLevels, ManualClock>;
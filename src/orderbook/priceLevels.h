@@ -0,0 +1,235 @@
+#pragma once
+
+#include "hierarchical_bitmap.h"
+#include "memoryStats.h"
+#include "orderPool.h"
+#include "types.h"
+#include "usings.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+// Resting orders at one price together with the aggregates published in LevelView.
+// `hidden` is the hidden quantity of the icebergs at this price, it is not published
+struct PriceLevel {
+    OrderQueue orders;
+    uint32_t volume = 0;
+    uint32_t orderCnt = 0;
+    uint32_t hidden = 0;
+};
+
+// One side of the book. Both containers below expose the same interface and are
+// plugged into BasicOrderbook as a template parameter:
+//   empty(), size()          - number of non-empty levels
+//   bestPrice(), best()      - best level, side must not be empty
+//   find(price)              - nullptr if there is no level at this price
+//   operator[](price)        - finds or creates the level
+//   erase(price)             - removes the level at this price
+//   forEach(fn)              - visits (price, level) from the best level, stops when fn returns false
+//   prefetch(price)          - hint that the level at this price is about to be used
+//   fits(price)              - false if operator[] can not create a level at this price
+//   memoryUse()              - heap bytes held now and at the peak, see MemoryStats
+
+// Orders the prices of side S from the best one, lowest ask or highest bid
+template <Side S>
+using priceOrder_t = std::conditional_t<S == Side::Sell, std::less<price_t>, std::greater<price_t>>;
+
+// Levels stored in a red-black tree ordered from the best price
+template <Side S>
+class MapLevels
+{
+public:
+    using compare_t = priceOrder_t<S>;
+
+    bool empty() const { return levels_.empty(); }
+    size_t size() const { return levels_.size(); }
+    price_t bestPrice() const { return levels_.begin()->first; }
+    PriceLevel& best() { return levels_.begin()->second; }
+
+    PriceLevel* find(price_t price)
+    {
+        auto it = levels_.find(price);
+        return it == levels_.end() ? nullptr : &it->second;
+    }
+    PriceLevel& operator[](price_t price)
+    {
+        auto [it, added] = levels_.try_emplace(price);
+        if (added)
+            peakSize_ = std::max(peakSize_, levels_.size());
+        return it->second;
+    }
+    void erase(price_t price) { levels_.erase(price); }
+    // Finding the node is the expensive part, there is nothing to prefetch ahead of it
+    void prefetch(price_t) const {}
+    bool fits(price_t) const { return true; }
+    MemoryStats::Usage memoryUse() const
+    {
+        return {.bytes = levels_.size() * nodeBytes, .peak = peakSize_ * nodeBytes};
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (const auto& [price, level] : levels_)
+            if (!fn(price, level))
+                return;
+    }
+
+private:
+    using map_t = std::map<price_t, PriceLevel, compare_t>;
+    static constexpr size_t nodeBytes = heapBytes::treeNode<typename map_t::value_type>;
+
+    map_t levels_;
+    size_t peakSize_{0};
+};
+
+// Levels stored in a contiguous array indexed by (price - basePrice) with a
+// hierarchical occupancy bitmap, so the best price and the next non-empty level
+// are found with a few bit scans. The window is re-centered (and doubled when
+// needed) when a price outside of it is added. Meant for instruments trading
+// inside a bounded tick band, prices far apart make the window large
+template <Side S>
+class TickLevels
+{
+public:
+    static constexpr size_t defaultWindow = 1ull << 12;
+    static constexpr size_t maxWindow = 1ull << 26;
+
+    explicit TickLevels(size_t window = defaultWindow)
+        : levels_(std::bit_ceil(std::max<size_t>(window, hierarchical_bitmap::word_bits)))
+        , occupied_{levels_.size()}
+    {
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t window() const { return levels_.size(); }
+    // The window only grows, it holds the most now
+    MemoryStats::Usage memoryUse() const
+    {
+        size_t bytes = heapBytes::vector(levels_) + occupied_.memory_bytes();
+        return {.bytes = bytes, .peak = bytes};
+    }
+    price_t bestPrice() const { return toPrice(bestIdx()); }
+    PriceLevel& best() { return levels_[bestIdx()]; }
+
+    PriceLevel* find(price_t price)
+    {
+        int64_t idx = toIdx(price);
+        if (idx < 0 || idx >= static_cast<int64_t>(levels_.size()) || !occupied_.test(idx))
+            return nullptr;
+        return &levels_[idx];
+    }
+
+    // Every occupied level and `price` have to fit into maxWindow ticks
+    bool fits(price_t price) const
+    {
+        if (empty())
+            return true;
+        int64_t low = std::min<int64_t>(price, toPrice(occupied_.find_first()));
+        int64_t high = std::max<int64_t>(price, toPrice(occupied_.find_last()));
+        return static_cast<size_t>(high - low + 1) <= maxWindow;
+    }
+
+    // price must fit()
+    PriceLevel& operator[](price_t price)
+    {
+        int64_t idx = toIdx(price);
+        if (idx < 0 || idx >= static_cast<int64_t>(levels_.size())) {
+            recenter(price);
+            idx = toIdx(price);
+        }
+
+        if (!occupied_.test(idx)) {
+            occupied_.set(idx);
+            size_++;
+        }
+        return levels_[idx];
+    }
+
+    void erase(price_t price)
+    {
+        int64_t idx = toIdx(price);
+        if (idx < 0 || idx >= static_cast<int64_t>(levels_.size()) || !occupied_.test(idx))
+            return;
+
+        levels_[idx] = PriceLevel{};
+        occupied_.reset(idx);
+        size_--;
+    }
+
+    void prefetch(price_t price) const
+    {
+        int64_t idx = toIdx(price);
+        if (idx >= 0 && idx < static_cast<int64_t>(levels_.size()))
+            __builtin_prefetch(&levels_[idx]);
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (size_t idx = bestIdx(); idx != hierarchical_bitmap::npos; idx = nextIdx(idx))
+            if (!fn(toPrice(idx), levels_[idx]))
+                return;
+    }
+
+private:
+    std::vector<PriceLevel> levels_;
+    hierarchical_bitmap occupied_;
+    int64_t basePrice_{0};
+    size_t size_{0};
+
+    int64_t toIdx(price_t price) const { return static_cast<int64_t>(price) - basePrice_; }
+    price_t toPrice(size_t idx) const { return static_cast<price_t>(basePrice_ + static_cast<int64_t>(idx)); }
+
+    // Asks are walked from the lowest index up, bids from the highest down
+    size_t bestIdx() const
+    {
+        if constexpr (S == Side::Sell)
+            return occupied_.find_first();
+        else
+            return occupied_.find_last();
+    }
+    size_t nextIdx(size_t idx) const
+    {
+        if constexpr (S == Side::Sell)
+            return occupied_.find_next(idx + 1);
+        else
+            return idx == 0 ? hierarchical_bitmap::npos : occupied_.find_prev(idx - 1);
+    }
+
+    // Moves the window so that it covers every occupied level and `price`,
+    // leaving the same amount of free ticks on both ends
+    void recenter(price_t price)
+    {
+        int64_t low = price;
+        int64_t high = price;
+        if (!empty()) {
+            low = std::min(low, basePrice_ + static_cast<int64_t>(occupied_.find_first()));
+            high = std::max(high, basePrice_ + static_cast<int64_t>(occupied_.find_last()));
+        }
+
+        size_t span = static_cast<size_t>(high - low + 1);
+        size_t window = levels_.size();
+        while (window < 2 * span && window < maxWindow)
+            window *= 2;
+
+        int64_t newBase = low - static_cast<int64_t>((window - span) / 2);
+        std::vector<PriceLevel> levels(window);
+        hierarchical_bitmap occupied{window};
+        for (size_t idx = occupied_.find_first(); idx != hierarchical_bitmap::npos;
+             idx = occupied_.find_next(idx + 1)) {
+            size_t newIdx = static_cast<size_t>(basePrice_ + static_cast<int64_t>(idx) - newBase);
+            levels[newIdx] = levels_[idx];
+            occupied.set(newIdx);
+        }
+
+        levels_ = std::move(levels);
+        occupied_ = std::move(occupied);
+        basePrice_ = newBase;
+    }
+};
@@ -0,0 +1,156 @@
+#include "snapshot.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool SnapshotHeader::matches(size_t fileSize) const noexcept
+{
+    if (magic != expectedMagic || version != currentVersion || recordSize != sizeof(SnapshotOrder) ||
+        fileSize < sizeof(SnapshotHeader))
+        return false;
+    size_t recordBytes = fileSize - sizeof(SnapshotHeader);
+    return recordBytes % sizeof(SnapshotOrder) == 0 && orderCount == recordBytes / sizeof(SnapshotOrder);
+}
+
+std::optional<SnapshotHeader> readSnapshotHeader(const std::filesystem::path& path) noexcept
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return std::nullopt;
+
+    SnapshotHeader header;
+    bool read = std::fread(&header, sizeof(header), 1, file) == 1;
+    std::fclose(file);
+    std::error_code error;
+    auto fileSize = std::filesystem::file_size(path, error);
+    if (!read || error || !header.matches(fileSize))
+        return std::nullopt;
+    return header;
+}
+
+namespace
+{
+    // write() until everything is written, short writes and signals retry
+    bool writeAll(int fd, const void* data, size_t size) noexcept
+    {
+        auto bytes = static_cast<const std::byte*>(data);
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+} // namespace
+
+bool syncDirectory(const char* directory) noexcept
+{
+    int fd = ::open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool synced = ::fsync(fd) == 0;
+    return ::close(fd) == 0 && synced;
+}
+
+SnapshotWriter::SnapshotWriter(const std::filesystem::path& path) noexcept
+    : path_{path.string()}
+    , tmpPath_{path_ + ".tmp"}
+    , directory_{path.has_parent_path() ? path.parent_path().string() : std::string{"."}}
+{
+    buffer_.reserve(bufferedRecords);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (fd_ < 0)
+        return;
+    // Not committed, the previous snapshot at path_ stays untouched
+    ::close(fd_);
+    ::unlink(tmpPath_.c_str());
+}
+
+void SnapshotWriter::start() noexcept
+{
+    fd_ = ::open(tmpPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    // The header is only known once every record was written, leave room for it
+    SnapshotHeader placeholder{};
+    if (fd_ >= 0 && !writeAll(fd_, &placeholder, sizeof(placeholder)))
+        failed_ = true;
+}
+
+void SnapshotWriter::append(const SnapshotOrder& record) noexcept
+{
+    buffer_.push_back(record);
+    written_++;
+    if (buffer_.size() == bufferedRecords)
+        flush();
+}
+
+void SnapshotWriter::flush() noexcept
+{
+    if (ok() && !writeAll(fd_, buffer_.data(), buffer_.size() * sizeof(SnapshotOrder)))
+        failed_ = true;
+    buffer_.clear();
+}
+
+SnapshotError SnapshotWriter::commit(SnapshotHeader header) noexcept
+{
+    flush();
+    header.recordSize = sizeof(SnapshotOrder);
+    header.orderCount = written_;
+    if (!ok() || ::lseek(fd_, 0, SEEK_SET) != 0 || !writeAll(fd_, &header, sizeof(header)) || ::fsync(fd_) != 0) {
+        failed_ = true;
+        return SnapshotError::Io;
+    }
+
+    bool closed = ::close(fd_) == 0;
+    fd_ = -1;
+    if (!closed || ::rename(tmpPath_.c_str(), path_.c_str()) != 0) {
+        ::unlink(tmpPath_.c_str());
+        return SnapshotError::Io;
+    }
+    // Until the directory is synced the rename may not survive a power loss,
+    // callers must not drop what the snapshot replaces (e.g. the journal) before
+    return syncDirectory(directory_.c_str()) ? SnapshotError::None : SnapshotError::Io;
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path) noexcept
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info{};
+    if (::fstat(fd, &info) == 0) {
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ == 0) {
+            ok_ = true;
+        } else {
+            // The whole file is read front to back right away, fault it in with one call
+            void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (data != MAP_FAILED) {
+                ::madvise(data, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const std::byte*>(data);
+                ok_ = true;
+            } else {
+                size_ = 0;
+            }
+        }
+    }
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+        ::munmap(const_cast<std::byte*>(data_), size_);
+}
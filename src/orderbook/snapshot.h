@@ -0,0 +1,206 @@
+#pragma once
+
+#include "order.h"
+#include "stopIndex.h"
+#include "types.h"
+#include "usings.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Layout of the files written by BasicOrderbook::saveSnapshot: a SnapshotHeader
+// followed by orderCount SnapshotOrder records. Bids come first, then asks,
+// each side from its best level and each level in queue order, so the position
+// of a record in the file is the queue position of its order. The pending stops
+// come last, in the order they would trigger (see StopIndex). Numbers are
+// stored in the byte order of the machine that wrote the file
+
+enum class SnapshotError : std::uint8_t {
+    None,
+    // The file could not be opened, mapped or written
+    Io,
+    // Not a snapshot, written with another layout or version, truncated, or
+    // holding an order that can not rest on the book
+    BadFormat,
+    // Snapshots are only loaded into a book that has not numbered any order yet
+    BookInUse,
+};
+
+constexpr std::string_view toString(SnapshotError error)
+{
+    switch (error) {
+    case SnapshotError::None:
+        return "none";
+    case SnapshotError::Io:
+        return "i/o error";
+    case SnapshotError::BadFormat:
+        return "bad snapshot format";
+    case SnapshotError::BookInUse:
+        return "book in use";
+    }
+    return "unknown error";
+}
+
+struct SnapshotHeader {
+    static constexpr std::array<char, 8> expectedMagic{'O', 'B', 'S', 'N', 'A', 'P', '\0', '\0'};
+    // Bumped whenever the header or SnapshotOrder change
+    static constexpr std::uint32_t currentVersion = 6;
+
+    std::array<char, 8> magic{expectedMagic};
+    std::uint32_t version{currentVersion};
+    std::uint32_t recordSize;
+    std::uint64_t orderCount;
+    orderId_t lastOrderId;
+    std::uint64_t levelSequence;
+    std::uint64_t orderSequence;
+    // Last journal entry (see journal.h) contained in the snapshot, 0 if the book was not journaled
+    std::uint64_t journalSequence;
+    // Stops trigger against it, badValues::price if the book has not traded yet
+    price_t lastTradePrice;
+    // 1 if the book was in a call auction, its orders may cross
+    std::uint8_t inAuction;
+    std::array<std::uint8_t, 3> reserved{};
+
+    // Magic, version and record layout are the current ones and a file of
+    // `fileSize` bytes holds exactly orderCount records
+    bool matches(size_t fileSize) const noexcept;
+};
+
+struct SnapshotOrder {
+    orderId_t orderId;
+    std::int64_t openTime; // microseconds
+    std::int64_t expiry;   // microseconds, GoodTillDate only. The trigger price of stops
+    price_t price;
+    quantity_t initialQuantity;
+    quantity_t remainingQuantity; // displayed part of icebergs
+    quantity_t hiddenQuantity;
+    quantity_t peak; // icebergs only
+    OrderType type;
+    Side side;
+    // Keeps the padding zeroed so equal books give identical files
+    std::array<std::uint8_t, 10> reserved{};
+
+    // Order, or an OrderView into a pool
+    template <typename Derived>
+    static SnapshotOrder from(const OrderFields<Derived>& order) noexcept
+    {
+        return SnapshotOrder{.orderId = order.getOrderId(),
+                             .openTime = order.getOpenTime().count(),
+                             .expiry = order.getExpiry().count(),
+                             .price = order.getPrice(),
+                             .initialQuantity = order.getInitialQuantity(),
+                             .remainingQuantity = order.getRemainingQuantity(),
+                             .hiddenQuantity = order.getHiddenQuantity(),
+                             .peak = order.getPeak(),
+                             .type = order.getType(),
+                             .side = order.getSide()};
+    }
+
+    static SnapshotOrder from(const StopOrder& stop) noexcept
+    {
+        return SnapshotOrder{.orderId = stop.orderId,
+                             .openTime = stop.openTime.count(),
+                             .expiry = stop.trigger,
+                             .price = stop.price,
+                             .initialQuantity = stop.quantity,
+                             .remainingQuantity = stop.quantity,
+                             .hiddenQuantity = 0,
+                             .peak = 0,
+                             .type = stop.type,
+                             .side = stop.side};
+    }
+
+    // Record must have passed BasicOrderbook's checks (remaining + hidden <= initial)
+    Order toOrder() const noexcept
+    {
+        Order order{orderId, initialQuantity, price, type, side, microsec_t{openTime}, microsec_t{expiry}, peak};
+        order.fill(initialQuantity - remainingQuantity - hiddenQuantity);
+        order.hide(hiddenQuantity);
+        return order;
+    }
+
+    // Record of a pending stop that passed BasicOrderbook's checks
+    StopOrder toStop() const noexcept
+    {
+        return StopOrder{.orderId = orderId,
+                         .openTime = microsec_t{openTime},
+                         .trigger = static_cast<price_t>(expiry),
+                         .price = price,
+                         .quantity = remainingQuantity,
+                         .type = type,
+                         .side = side};
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader> && std::is_trivially_copyable_v<SnapshotOrder>);
+static_assert(sizeof(SnapshotOrder) == 56, "no padding the reserved bytes do not cover");
+static_assert(sizeof(SnapshotHeader) % alignof(SnapshotOrder) == 0, "records are read in place after the header");
+
+// Header of the snapshot at `path`, empty if the file can not be read or does not match it
+std::optional<SnapshotHeader> readSnapshotHeader(const std::filesystem::path& path) noexcept;
+
+// fsyncs `directory`, so entries created or renamed in it survive a power loss
+bool syncDirectory(const char* directory) noexcept;
+
+// Writes a snapshot next to its destination (path + ".tmp") and renames it over
+// the destination on commit(), so a crash while saving leaves the previous
+// snapshot in place. Records are buffered and written in large blocks.
+// Everything that allocates (the paths and the buffer) is done by the
+// constructor, start(), append() and commit() only make system calls, so they
+// can run in the child of a fork() (see Checkpoint)
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(const std::filesystem::path& path) noexcept;
+    // Removes the temporary file if this writer created it and did not commit
+    ~SnapshotWriter();
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Creates the temporary file and leaves room for the header
+    void start() noexcept;
+    bool ok() const noexcept { return fd_ >= 0 && !failed_; }
+    void append(const SnapshotOrder& record) noexcept;
+    // Writes `header` in front of the records (with recordSize and orderCount
+    // filled in), syncs the file, moves it to the destination and syncs the
+    // directory, the snapshot is durable once this returns None
+    SnapshotError commit(SnapshotHeader header) noexcept;
+
+private:
+    static constexpr size_t bufferedRecords = 1ull << 14;
+
+    std::string path_;
+    std::string tmpPath_;
+    std::string directory_;
+    int fd_{-1};
+    std::vector<SnapshotOrder> buffer_;
+    std::uint64_t written_{0};
+    bool failed_{false};
+
+    void flush() noexcept;
+};
+
+// Read only mapping of a whole file. An empty file maps to an empty span
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::filesystem::path& path) noexcept;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const noexcept { return ok_; }
+    std::span<const std::byte> bytes() const noexcept { return {data_, size_}; }
+
+private:
+    const std::byte* data_{nullptr};
+    size_t size_{0};
+    bool ok_{false};
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "memoryStats.h"
+#include "types.h"
+#include "usings.h"
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Stop or StopLimit order waiting for its trigger, it is not on the book yet
+struct StopOrder {
+    orderId_t orderId;
+    microsec_t openTime;
+    price_t trigger;
+    // Limit of a StopLimit order, the trigger for Stop orders
+    price_t price;
+    quantity_t quantity;
+    OrderType type;
+    Side side;
+};
+
+// Pending stops of one book, kept off the book in one trigger queue per side.
+// Buy stops trigger once a trade is at or above their trigger, so their queue is
+// ordered from the lowest trigger, sell stops from the highest. A trade only
+// looks at the front of both queues and takes the triggers it crossed, so it
+// costs O(triggered) plus one map lookup per trigger price, however many
+// stops are pending. Stops with the same trigger are kept in arrival order.
+// Cancelled stops are only taken out of the order map, their ids are skipped
+// when their trigger comes up (or dropped when the queues are compacted)
+class StopIndex
+{
+public:
+    bool empty() const { return stops_.empty(); }
+    size_t size() const { return stops_.size(); }
+
+    size_t memoryBytes() const
+    {
+        return stops_.size() * heapBytes::hashNode<decltype(stops_)::value_type> +
+               stops_.bucket_count() * sizeof(void*) + queueBytes(buyTriggers_) + queueBytes(sellTriggers_);
+    }
+
+    void insert(const StopOrder& stop)
+    {
+        stops_.emplace(stop.orderId, stop);
+        if (stop.side == Side::Buy)
+            buyTriggers_[stop.trigger].push_back(stop.orderId);
+        else
+            sellTriggers_[stop.trigger].push_back(stop.orderId);
+        queued_++;
+    }
+
+    // Takes a pending stop out, empty if there is none with this id
+    std::optional<StopOrder> erase(orderId_t orderId)
+    {
+        auto it = stops_.find(orderId);
+        if (it == stops_.end())
+            return std::nullopt;
+        StopOrder stop = it->second;
+        stops_.erase(it);
+        // Keeps the skipped ids below the number of pending stops
+        if (queued_ > 2 * stops_.size() + 1024)
+            compact();
+        return stop;
+    }
+
+    // Appends the stops a trade at `price` triggered to `triggered`: buy stops
+    // with a trigger at or below it from the lowest trigger, then sell stops with
+    // a trigger at or above it from the highest
+    void popTriggered(price_t price, std::vector<StopOrder>& triggered)
+    {
+        popFront(buyTriggers_, [price](price_t trigger) { return trigger <= price; }, triggered);
+        popFront(sellTriggers_, [price](price_t trigger) { return trigger >= price; }, triggered);
+    }
+
+    // Visits the pending stops in the order they would trigger, buy stops first
+    template <typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        auto visit = [&](const auto& triggers) {
+            for (const auto& [trigger, ids] : triggers)
+                for (orderId_t orderId : ids)
+                    if (auto it = stops_.find(orderId); it != stops_.end())
+                        fn(it->second);
+        };
+        visit(buyTriggers_);
+        visit(sellTriggers_);
+    }
+
+private:
+    std::unordered_map<orderId_t, StopOrder> stops_;
+    std::map<price_t, std::vector<orderId_t>, std::less<price_t>> buyTriggers_;
+    std::map<price_t, std::vector<orderId_t>, std::greater<price_t>> sellTriggers_;
+    // Ids in both trigger queues, including the cancelled ones
+    size_t queued_{0};
+
+    template <typename Triggers>
+    static size_t queueBytes(const Triggers& triggers)
+    {
+        size_t bytes = triggers.size() * heapBytes::treeNode<typename Triggers::value_type>;
+        for (const auto& [trigger, ids] : triggers)
+            bytes += heapBytes::vector(ids);
+        return bytes;
+    }
+
+    template <typename Triggers, typename Crossed>
+    void popFront(Triggers& triggers, Crossed crossed, std::vector<StopOrder>& triggered)
+    {
+        while (!triggers.empty() && crossed(triggers.begin()->first)) {
+            for (orderId_t orderId : triggers.begin()->second) {
+                auto it = stops_.find(orderId);
+                if (it == stops_.end())
+                    continue;
+                triggered.push_back(it->second);
+                stops_.erase(it);
+            }
+            queued_ -= triggers.begin()->second.size();
+            triggers.erase(triggers.begin());
+        }
+    }
+
+    void compact()
+    {
+        auto compactSide = [&](auto& triggers) {
+            for (auto it = triggers.begin(); it != triggers.end();) {
+                std::erase_if(it->second, [&](orderId_t orderId) { return !stops_.contains(orderId); });
+                it = it->second.empty() ? triggers.erase(it) : std::next(it);
+            }
+        };
+        compactSide(buyTriggers_);
+        compactSide(sellTriggers_);
+        queued_ = stops_.size();
+    }
+};
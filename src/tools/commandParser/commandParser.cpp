@@ -30,17 +30,30 @@ Command CommandParser::parseLine(const std::string& raw)
         parsedLine += t + " ";
     logger_.debug(std::format("parsed line: {}", parsedLine));
 
-    auto action = strfuncs::lower(tokens[0]);
+    // Optional leading '@<instrument id>', lines without it go to instrument 0
+    instrumentId_t instrument = 0;
+    size_t actionIdx = 0;
+    if (tokens[0].starts_with('@')) {
+        auto parsed = parseInstrument(std::string_view{tokens[0]}.substr(1));
+        if (!parsed.has_value() || tokens.size() < 2)
+            return Command{.action = Actions::NULLACTION};
+        instrument = parsed.value();
+        actionIdx = 1;
+    }
+
+    auto action = strfuncs::lower(tokens[actionIdx]);
     if (str2action_.find(action) == str2action_.end()) {
         logger_.error(std::format("action '{}' invalid", action));
         return Command{.action = Actions::NULLACTION};
     }
 
-    std::vector<std::string> args(tokens.size() - 1);
+    std::vector<std::string> args(tokens.size() - actionIdx - 1);
     for (size_t i = 0; i < args.size(); ++i)
-        args[i] = strfuncs::lower(tokens[i + 1]);
+        args[i] = strfuncs::lower(tokens[actionIdx + i + 1]);
 
-    return processArgs(str2action_.at(action), args);
+    Command command = processArgs(str2action_.at(action), args);
+    command.instrument = instrument;
+    return command;
 }
 
 Command CommandParser::processArgs(Actions action, const std::vector<std::string>& args)
@@ -49,9 +62,11 @@ Command CommandParser::processArgs(Actions action, const std::vector<std::string
         return Command{.action = Actions::NULLACTION};
 
     else if (action == Actions::ADD) {
-        if (args.size() != 4) {
-            logger_.error(
-                std::format("received wrong number of params for action ADD (received {}, expected 4)", args.size()));
+        // GTD orders take their expiry and stop orders their trigger price as the last argument
+        size_t expected = !args.empty() && (args[0] == "gtd" || args[0] == "stop" || args[0] == "stoplimit") ? 5 : 4;
+        if (args.size() != expected) {
+            logger_.error(std::format("received wrong number of params for action ADD (received {}, expected {})",
+                                      args.size(), expected));
             return Command{.action = Actions::NULLACTION};
         }
 
@@ -65,6 +80,18 @@ Command CommandParser::processArgs(Actions action, const std::vector<std::string
         if (command.type == OrderType::Bad || command.quantity == badValues::quantity || command.side == Side::Bad ||
             command.price == badValues::price)
             return Command{.action = Actions::NULLACTION};
+
+        if (command.type == OrderType::GoodTillDate) {
+            auto expiry = parseExpiry(args[4]);
+            if (!expiry.has_value())
+                return Command{.action = Actions::NULLACTION};
+            command.expiry = expiry.value();
+        }
+        if (command.type == OrderType::Stop || command.type == OrderType::StopLimit) {
+            command.trigger = parsePrice(args[4]);
+            if (command.trigger == badValues::price)
+                return Command{.action = Actions::NULLACTION};
+        }
         return command;
 
     } else if (action == Actions::CANCEL) {
@@ -141,6 +168,17 @@ orderId_t CommandParser::parseOrderId(std::string_view id)
     return tmp.value();
 }
 
+std::optional<instrumentId_t> CommandParser::parseInstrument(std::string_view instrument)
+{
+    auto tmp = strfuncs::strToType<instrumentId_t>(instrument);
+    if (!tmp.has_value()) {
+        logger_.error(std::format("Failed to parse instrument id, input: {}", instrument));
+        return std::nullopt;
+    }
+
+    return tmp.value();
+}
+
 OrderType CommandParser::parseOrderType(std::string_view type)
 {
     if (type == "market")
@@ -149,10 +187,16 @@ OrderType CommandParser::parseOrderType(std::string_view type)
         return OrderType::GoodTillCancel;
     else if (type == "gte")
         return OrderType::GoodTillEOD;
+    else if (type == "gtd")
+        return OrderType::GoodTillDate;
     else if (type == "fok")
         return OrderType::FillOrKill;
     else if (type == "fak")
         return OrderType::FillAndKill;
+    else if (type == "stop")
+        return OrderType::Stop;
+    else if (type == "stoplimit")
+        return OrderType::StopLimit;
 
     logger_.error("Invalid order type");
     return OrderType::Bad;
@@ -180,6 +224,17 @@ Side CommandParser::parseSide(std::string_view side)
     return Side::Bad;
 }
 
+std::optional<microsec_t> CommandParser::parseExpiry(std::string_view expiry)
+{
+    auto tmp = strfuncs::strToType<int64_t>(expiry);
+    if (!tmp.has_value()) {
+        logger_.error(std::format("Failed to parse 'expiry' field, input: {}", expiry));
+        return std::nullopt;
+    }
+
+    return microsec_t{tmp.value()};
+}
+
 price_t CommandParser::parsePrice(std::string_view price)
 {
     auto tmp = strfuncs::strToType<price_t>(price);
@@ -196,5 +251,8 @@ const std::unordered_map<std::string, Actions> CommandParser::str2action_{
 const std::unordered_map<OrderType, std::string> CommandParser::type2str_{{OrderType::Market, "MARKET"},
                                                                           {OrderType::GoodTillCancel, "GTC"},
                                                                           {OrderType::GoodTillEOD, "GTE"},
+                                                                          {OrderType::GoodTillDate, "GTD"},
                                                                           {OrderType::FillOrKill, "FOK"},
-                                                                          {OrderType::FillAndKill, "FAK"}};
+                                                                          {OrderType::FillAndKill, "FAK"},
+                                                                          {OrderType::Stop, "STOP"},
+                                                                          {OrderType::StopLimit, "STOPLIMIT"}};
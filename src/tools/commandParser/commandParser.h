@@ -7,18 +7,6 @@
 #include <unordered_map>
 #include <vector>
 
-enum class Actions { ADD, CANCEL, MODIFY, NULLACTION };
-
-struct Command {
-    Actions action{Actions::NULLACTION};
-
-    orderId_t oid = badValues::orderId;
-    OrderType type = OrderType::Bad;
-    quantity_t quantity = badValues::quantity;
-    price_t price = badValues::price;
-    Side side = Side::Bad;
-};
-
 class CommandParser
 {
 public:
@@ -33,8 +21,10 @@ private:
     Command processArgs(Actions action, const std::vector<std::string>& args);
     Command parseLine(const std::string& raw);
     orderId_t parseOrderId(const std::string_view id);
+    std::optional<instrumentId_t> parseInstrument(const std::string_view instrument);
     OrderType parseOrderType(const std::string_view type);
     quantity_t parseQuantity(const std::string_view quantity);
     Side parseSide(const std::string_view side);
     price_t parsePrice(const std::string_view price);
+    std::optional<microsec_t> parseExpiry(const std::string_view expiry);
 };
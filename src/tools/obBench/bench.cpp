@@ -1,10 +1,14 @@
 #include "bench.h"
 #include "strfuncs.h"
 #include "usings.h"
+#include <algorithm>
 #include <chrono>
+#include <span>
 
-Bench::Bench(std::filesystem::path inFp, size_t iterations)
+Bench::Bench(std::filesystem::path inFp, size_t iterations, BookLevels levels, size_t batch)
     : iterations_{iterations}
+    , levels_{levels}
+    , batch_{batch}
 {
     if (!std::filesystem::exists(inFp)) {
         auto mes = std::format("path {} does not exist", inFp.string());
@@ -17,11 +21,27 @@ Bench::Bench(std::filesystem::path inFp, size_t iterations)
 
 BenchResult Bench::run()
 {
+    if (levels_ == BookLevels::Ladder)
+        return runBook<LadderOrderbook>();
+    return runBook<Orderbook>();
+}
+
+template <typename Book>
+BenchResult Bench::runBook()
+{
+    BookManager<Book> books{};
     const auto start = std::chrono::steady_clock::now();
 
     for (size_t i{}; i < iterations_; ++i) {
-        for (auto op : commands_)
-            processCommand(op, ob_);
+        if (batch_ == 0) {
+            for (auto op : commands_)
+                processCommand(op, books);
+            continue;
+        }
+
+        std::span<const Command> commands{commands_};
+        for (size_t first = 0; first < commands.size(); first += batch_)
+            books.process(commands.subspan(first, std::min(batch_, commands.size() - first)), sink_);
     }
 
     const auto end = std::chrono::steady_clock::now();
@@ -36,28 +56,61 @@ BenchResult Bench::run()
     };
 }
 
-void Bench::processCommand(Command& op, Orderbook& book)
+std::vector<MemorySample> Bench::memoryReport(size_t interval)
+{
+    if (levels_ == BookLevels::Ladder)
+        return memoryReportBook<LadderOrderbook>(interval);
+    return memoryReportBook<Orderbook>(interval);
+}
+
+template <typename Book>
+std::vector<MemorySample> Bench::memoryReportBook(size_t interval)
+{
+    BookManager<Book> books{};
+    std::vector<MemorySample> samples;
+    auto sample = [&](size_t commands) {
+        MemorySample s{.commands = commands, .resting_orders = 0, .memory = {}};
+        books.forEach([&](instrumentId_t, const Book& book) {
+            s.resting_orders += book.restingOrders();
+            s.memory += book.memoryStats();
+        });
+        samples.push_back(s);
+    };
+
+    size_t processed = 0;
+    for (size_t i{}; i < iterations_; ++i) {
+        for (auto op : commands_) {
+            processCommand(op, books);
+            if (++processed % interval == 0)
+                sample(processed);
+        }
+    }
+    if (processed % interval != 0 || processed == 0)
+        sample(processed);
+    return samples;
+}
+
+template <typename Book>
+void Bench::processCommand(Command& op, BookManager<Book>& books)
 {
     if (op.action == Actions::NULLACTION)
         return;
 
-    else if (op.action == Actions::ADD) {
-        auto [orderId, trades, orderInfo] = book.addOrder(op.quantity, op.price, op.type, op.side);
+    // Dispatched like BasicOrderbook::process, so both modes run the same workload
+    Book& book = books.book(op.instrument);
+    if (op.action == Actions::ADD && Order::isStop(op.type)) {
+        book.addStopOrder(op.quantity, op.trigger, op.price, op.type, op.side, sink_);
+
+    } else if (op.action == Actions::ADD && op.peak != 0) {
+        book.addIcebergOrder(op.quantity, op.peak, op.price, op.type, op.side, op.expiry, sink_);
+
+    } else if (op.action == Actions::ADD) {
+        book.addOrder(op.quantity, op.price, op.type, op.side, op.expiry, sink_);
 
     } else if (op.action == Actions::CANCEL) {
-        book.cancelOrder(op.oid);
+        book.cancelOrder(op.oid, sink_);
 
     } else if (op.action == Actions::MODIFY) {
-        ModifyOrder mods;
-        if (op.quantity != badValues::quantity)
-            mods.quantity = op.quantity;
-        if (op.price != badValues::price)
-            mods.price = op.price;
-        if (op.side != Side::Bad)
-            mods.side = op.side;
-        if (op.type != OrderType::Bad)
-            mods.type = op.type;
-
-        auto [newOrderId, trades, newOrderInfo] = book.modifyOrder(op.oid, mods);
+        book.modifyOrder(op.oid, op.modifications(), sink_);
     }
 }
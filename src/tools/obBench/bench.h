@@ -1,10 +1,13 @@
 #pragma once
 
+#include "bookManager.h"
 #include "commandParser.h"
 #include "orderbook.h"
 #include <filesystem>
 #include <vector>
 
+enum class BookLevels { Map, Ladder };
+
 struct BenchResult {
     int64_t elapsed_ns;
     double ns_per_command;
@@ -12,19 +15,38 @@ struct BenchResult {
     size_t total_commands;
 };
 
+// State of every book after `commands` commands
+struct MemorySample {
+    size_t commands;
+    size_t resting_orders;
+    MemoryStats memory;
+};
+
 class Bench
 {
 public:
-    Bench(std::filesystem::path inFp, size_t iterations);
+    // batch == 0 sends commands to the book one call at a time, otherwise in
+    // slices of `batch` commands through Orderbook::process
+    Bench(std::filesystem::path inFp, size_t iterations, BookLevels levels = BookLevels::Map, size_t batch = 0);
 
     const size_t commandCount() const { return commands_.size(); }
     BenchResult run();
+    // Replays the workload again on new books, untimed, and samples their memory
+    // every `interval` commands and after the last one
+    std::vector<MemorySample> memoryReport(size_t interval);
 
 private:
-    Orderbook ob_{};
-
     std::vector<Command> commands_;
     size_t iterations_{};
+    BookLevels levels_{};
+    size_t batch_{};
+    // Execution reports are not needed for throughput numbers, this discards them without building a trade vector
+    EventSink sink_{};
 
-    void processCommand(Command& op, Orderbook& book);
+    template <typename Book>
+    BenchResult runBook();
+    template <typename Book>
+    std::vector<MemorySample> memoryReportBook(size_t interval);
+    template <typename Book>
+    void processCommand(Command& op, BookManager<Book>& books);
 };
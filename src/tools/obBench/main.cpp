@@ -1,5 +1,7 @@
 #include "bench.h"
 #include "strfuncs.h"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 
 int main(int argc, char** argv)
@@ -9,6 +11,11 @@ int main(int argc, char** argv)
     // args for replay class, declare them here and process in the loop
     std::string filename = "input.txt";
     size_t iterations = 10000;
+    BookLevels levels = BookLevels::Map;
+    size_t batch = 0;
+    // 0 skips the memory report, otherwise the books are sampled every memReport commands
+    size_t memReport = 0;
+    constexpr size_t defaultMemReport = 100'000;
     LoggerConfig::setLevel(LogLevel::LOG);
 
     // Process user input
@@ -24,7 +31,17 @@ int main(int argc, char** argv)
                 std::cout << "\t--iterations (int): how many times operations from the provided (or defualt) file are "
                              "exectued"
                           << std::endl;
-            } else
+                std::cout << "\t--levels (map | ladder): price level container used by the book, default: map"
+                          << std::endl;
+                std::cout << "\t--batch (int): commands handed to the book per process() call, 0 sends them one "
+                             "by one, default: 0"
+                          << std::endl;
+                std::cout << "\t--mem-report[=int]: after the benchmark, replays the workload and prints the heap "
+                             "bytes of the books per resting order every n commands, default n: "
+                          << defaultMemReport << std::endl;
+            } else if (split[0] == "--mem-report")
+                memReport = defaultMemReport;
+            else
                 std::cout << "Unknown flag: " << std::quoted(split[0]) << std::endl;
 
         } else if (split.size() == 2) {
@@ -32,6 +49,21 @@ int main(int argc, char** argv)
                 filename = split[1];
             else if (split[0] == "--iterations")
                 iterations = strfuncs::strToType<size_t>(split[1]).value();
+            else if (split[0] == "--levels") {
+                auto kind = strfuncs::lower(split[1]);
+                if (kind == "map")
+                    levels = BookLevels::Map;
+                else if (kind == "ladder")
+                    levels = BookLevels::Ladder;
+                else {
+                    std::cout << "Unknown levels kind: " << std::quoted(kind) << ", available ones: 'map', 'ladder'"
+                              << std::endl;
+                    return 1;
+                }
+            } else if (split[0] == "--batch")
+                batch = strfuncs::strToType<size_t>(split[1]).value();
+            else if (split[0] == "--mem-report")
+                memReport = std::max<size_t>(1, strfuncs::strToType<size_t>(split[1]).value());
             else
                 std::cout << "Unknown flag: " << std::quoted(split[0]) << std::endl;
 
@@ -47,7 +79,7 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    Bench bench{DATA_PATH / filename, iterations};
+    Bench bench{DATA_PATH / filename, iterations, levels, batch};
 
     const auto command_count = bench.commandCount();
     const auto total_commands = command_count * iterations;
@@ -57,6 +89,8 @@ int main(int argc, char** argv)
     std::cout << "file: " << filename << '\n';
     std::cout << "commands/iteration: " << command_count << '\n';
     std::cout << "iterations: " << iterations << '\n';
+    std::cout << "levels: " << (levels == BookLevels::Ladder ? "ladder" : "map") << '\n';
+    std::cout << "batch: " << batch << '\n';
     std::cout << "total commands: " << total_commands << '\n';
 
     const auto result = bench.run();
@@ -66,4 +100,29 @@ int main(int argc, char** argv)
     std::cout << "elapsed ns: " << result.elapsed_ns << '\n';
     std::cout << "ns/command: " << std::fixed << std::setprecision(2) << result.ns_per_command << '\n';
     std::cout << "commands/sec: " << std::fixed << std::setprecision(2) << result.commands_per_second << '\n';
+
+    if (memReport == 0)
+        return 0;
+
+    std::cout << "\nMemory report\n";
+    std::cout << "-------------\n";
+    std::cout << std::setw(12) << "commands" << std::setw(12) << "resting" << std::setw(14) << "total bytes"
+              << std::setw(13) << "bytes/order" << std::setw(12) << "levels" << std::setw(12) << "orders"
+              << std::setw(12) << "index" << std::setw(12) << "free" << std::setw(12) << "other" << '\n';
+    MemoryStats last{};
+    for (const auto& sample : bench.memoryReport(memReport)) {
+        const auto& memory = sample.memory;
+        std::cout << std::setw(12) << sample.commands << std::setw(12) << sample.resting_orders << std::setw(14)
+                  << memory.total() << std::setw(13);
+        if (sample.resting_orders == 0)
+            std::cout << "-";
+        else
+            std::cout << std::setprecision(1)
+                      << static_cast<double>(memory.total()) / static_cast<double>(sample.resting_orders);
+        std::cout << std::setw(12) << memory.levels.bytes << std::setw(12) << memory.orders.bytes << std::setw(12)
+                  << memory.index.bytes << std::setw(12) << memory.freePools << std::setw(12) << memory.other << '\n';
+        last = memory;
+    }
+    std::cout << "high-water bytes: levels " << last.levels.peak << ", orders " << last.orders.peak << ", index "
+              << last.index.peak << '\n';
 }
@@ -50,43 +50,50 @@ void Replay::processCommand(Command& op)
     if (op.action == Actions::NULLACTION)
         return;
 
-    else if (op.action == Actions::ADD) {
-        auto [orderId, trades, orderInfo] = ob_.addOrder(op.quantity, op.price, op.type, op.side);
-        logStats(orderId, trades, orderInfo);
+    // Only the book a command reaches can be observed, so only its clock moves
+    // and its GoodTillDate orders whose expiry passed are cancelled before the command
+    ManualClockOrderbook& ob = books_.book(op.instrument);
+    ob.clock().set(microsec_t{++commandCnt_});
+    expired_.orders.clear();
+    ob.expireOrders(expired_);
+    for (auto [orderId, quantity] : expired_.orders)
+        logger_.log(std::format("Order {} expired (instrument {}): qty={}", orderId, op.instrument, quantity));
+
+    if (op.action == Actions::ADD) {
+        collector_.clear();
+        auto status = Order::isStop(op.type)
+                          ? ob.addStopOrder(op.quantity, op.trigger, op.price, op.type, op.side, collector_)
+                          : ob.addOrder(op.quantity, op.price, op.type, op.side, op.expiry, collector_);
+        logStats(op.instrument, status, collector_.trades(), collector_.info());
 
     } else if (op.action == Actions::CANCEL) {
-        ob_.cancelOrder(op.oid);
+        collector_.clear();
+        if (auto reason = ob.cancelOrder(op.oid, collector_); reason != RejectReason::None)
+            logger_.log(std::format("Cancel of order {} rejected: {}", op.oid, toString(reason)));
 
     } else if (op.action == Actions::MODIFY) {
-        ModifyOrder mods;
-        if (op.quantity != badValues::quantity)
-            mods.quantity = op.quantity;
-        if (op.price != badValues::price)
-            mods.price = op.price;
-        if (op.side != Side::Bad)
-            mods.side = op.side;
-        if (op.type != OrderType::Bad)
-            mods.type = op.type;
-
-        auto [newOrderId, trades, newOrderInfo] = ob_.modifyOrder(op.oid, mods);
-        logStats(op.oid, trades, newOrderInfo);
+        collector_.clear();
+        auto status = ob.modifyOrder(op.oid, op.modifications(), collector_);
+        logStats(op.instrument, status, collector_.trades(), collector_.info());
     }
 }
 
-void Replay::logStats(orderId_t orderId, trades_t& trades, OrderInfo info)
+void Replay::logStats(instrumentId_t instrument, OrderStatus status, trades_t& trades, OrderInfo info)
 {
-    if (orderId == badValues::orderId) {
-        logger_.log("Order rejected or order with the provided id did not exist");
+    if (!status.accepted()) {
+        logger_.log(std::format("Order rejected: {}", toString(status.reason)));
         return;
     }
+    orderId_t orderId = status.orderId;
 
     auto typeStr = info.type == OrderType::Bad ? "BAD" : parser_.type2str_.at(info.type);
     auto sideStr = info.side == Side::Buy ? "BUY" : "SELL";
     auto price = info.price;
     auto quantity = info.quantity;
 
-    logger_.log(std::format("New order with id {}:\n\tprice: {}\n\tquantity: {}\n\tside: {}\n\ttype: {}", orderId,
-                            price, quantity, sideStr, typeStr));
+    logger_.log(
+        std::format("New order with id {} (instrument {}):\n\tprice: {}\n\tquantity: {}\n\tside: {}\n\ttype: {}",
+                    orderId, instrument, price, quantity, sideStr, typeStr));
     quantity_t executedQty = 0;
     for (const auto& trade : trades)
         executedQty += trade.quantity;
@@ -1,12 +1,15 @@
 #pragma once
 
 #include "Logger.h"
+#include "bookManager.h"
 #include "commandParser.h"
 #include "orderbook.h"
 #include "types.h"
 #include "usings.h"
 #include <filesystem>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 class Replay
 {
@@ -21,11 +24,23 @@ private:
     std::filesystem::path outputFp_{"/tmp/orderbook/replay_output.txt"};
     Logger logger_{"replay"};
     CommandParser parser_{};
-    Orderbook ob_{};
+    // Orders are stamped with the number of the command that added them instead
+    // of the wall clock, so every run over the same input builds the same books
+    BookManager<ManualClockOrderbook> books_{};
+    uint64_t commandCnt_{0};
+    ExecutionCollector collector_{};
+
+    // Orders cancelled by expireOrders, logged before the command that found them due
+    struct ExpiryCollector : EventSink {
+        std::vector<std::pair<orderId_t, quantity_t>> orders;
+
+        void onCancel(orderId_t orderId, quantity_t quantity) { orders.emplace_back(orderId, quantity); }
+    };
+    ExpiryCollector expired_{};
 
     static const std::unordered_map<std::string, Actions> str2action_;
     static const std::unordered_map<OrderType, std::string> type2str_;
 
     void processCommand(Command& op);
-    void logStats(orderId_t orderId, trades_t& trades, OrderInfo info);
+    void logStats(instrumentId_t instrument, OrderStatus status, trades_t& trades, OrderInfo info);
 };
@@ -0,0 +1,818 @@
+#include "checkpoint.h"
+#include "clock.h"
+#include "depthReplica.h"
+#include "journal.h"
+#include "orderIndex.h"
+#include "orderReplica.h"
+#include "orderbook.h"
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr size_t restingOrders = 1'000'000;
+
+// The map the book used before OrderIndex, with the same interface
+class UnorderedMapIndex
+{
+public:
+    size_t size() const { return orders_.size(); }
+    orderHandle_t find(orderId_t orderId) const
+    {
+        auto it = orders_.find(orderId);
+        return it == orders_.end() ? badValues::orderHandle : it->second;
+    }
+    void insert(orderId_t orderId, orderHandle_t handle) { orders_[orderId] = handle; }
+    void erase(orderId_t orderId) { orders_.erase(orderId); }
+
+private:
+    std::unordered_map<orderId_t, orderHandle_t> orders_;
+};
+
+static std::vector<orderId_t> shuffledIds(size_t count)
+{
+    std::vector<orderId_t> ids(count);
+    std::iota(ids.begin(), ids.end(), 2);
+    std::shuffle(ids.begin(), ids.end(), std::mt19937_64{42});
+    return ids;
+}
+
+// 1M resting orders, then every id is looked up and cancelled in random order
+template <typename Index>
+static void BM_IndexCancelHeavy(benchmark::State& state)
+{
+    const auto cancelOrder = shuffledIds(restingOrders);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        Index index;
+        for (orderId_t id = 2; id < restingOrders + 2; ++id)
+            index.insert(id, static_cast<orderHandle_t>(id));
+        state.ResumeTiming();
+
+        for (auto id : cancelOrder) {
+            benchmark::DoNotOptimize(index.find(id));
+            index.erase(id);
+        }
+        benchmark::DoNotOptimize(index.size());
+    }
+    state.SetItemsProcessed(state.iterations() * restingOrders);
+}
+
+// Same traffic through the book: 1M resting orders, cancelled in random order
+template <typename Book>
+static void BM_BookCancelHeavy(benchmark::State& state)
+{
+    const auto cancelOrder = shuffledIds(restingOrders);
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<price_t> priceDist(0, 499);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto book = std::make_unique<Book>();
+        for (size_t i = 0; i < restingOrders; ++i) {
+            bool buy = i % 2 == 0;
+            book->addOrder(10, buy ? 9500 + priceDist(rng) : 10001 + priceDist(rng), OrderType::GoodTillCancel,
+                           buy ? Side::Buy : Side::Sell);
+        }
+        state.ResumeTiming();
+
+        for (auto id : cancelOrder)
+            book->cancelOrder(id);
+
+        state.PauseTiming();
+        book.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * restingOrders);
+}
+
+// Fill-or-kill orders against a deep ask side that holds slightly less than asked
+// for, so every check has to account for every level and the order is rejected
+template <typename Book>
+static void BM_FillOrKillDeepBook(benchmark::State& state)
+{
+    const auto levels = static_cast<price_t>(state.range(0));
+    Book book;
+    for (price_t level = 0; level < levels; ++level)
+        book.addOrder(10, 10'000 + level, OrderType::GoodTillCancel, Side::Sell);
+
+    EventSink sink;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            book.addOrder(10 * levels + 1, 10'000 + levels, OrderType::FillOrKill, Side::Buy, sink));
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Market maker traffic: resting orders on 100 levels per side whose quantity is
+// lowered by one lot at a time, round robin
+template <typename Book>
+static void BM_AmendDown(benchmark::State& state)
+{
+    constexpr size_t orders = 10'000;
+    Book book;
+    EventSink sink;
+    std::vector<orderId_t> ids;
+    for (size_t i = 0; i < orders; ++i) {
+        bool buy = i % 2 == 0;
+        price_t price = buy ? 9'999 - static_cast<price_t>(i % 100) : 10'001 + static_cast<price_t>(i % 100);
+        ids.push_back(
+            book.addOrder(1'000'000'000, price, OrderType::GoodTillCancel, buy ? Side::Buy : Side::Sell, sink).orderId);
+    }
+
+    quantity_t quantity = 1'000'000'000;
+    size_t next = 0;
+    for (auto _ : state) {
+        if (next == orders) {
+            next = 0;
+            quantity--;
+        }
+        ids[next] = book.modifyOrder(ids[next], ModifyOrder{.quantity = quantity - 1}, sink).orderId;
+        next++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Misbehaving client: every valid order that rests and is cancelled again is
+// followed by two orders with zero quantity that have to be refused
+template <typename Book>
+static void BM_HalfInvalidFlood(benchmark::State& state)
+{
+    Book book;
+    EventSink sink;
+    for (auto _ : state) {
+        auto status = book.addOrder(10, 9'999, OrderType::GoodTillCancel, Side::Buy, sink);
+        benchmark::DoNotOptimize(book.addOrder(0, 9'999, OrderType::GoodTillCancel, Side::Buy, sink));
+        benchmark::DoNotOptimize(book.addOrder(0, 10'001, OrderType::GoodTillCancel, Side::Sell, sink));
+        book.cancelOrder(status.orderId, sink);
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+
+// 1M resting asks on 1000 levels, taken by one buy that sweeps all of them.
+// Orders are spread over the levels round robin, so the orders of one level sit
+// 1000 pool nodes apart and every fill reads a node from a different cache line
+template <typename Book>
+static void BM_DeepSweep(benchmark::State& state)
+{
+    constexpr price_t levels = 1000;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto book = std::make_unique<Book>();
+        EventSink sink;
+        for (size_t i = 0; i < restingOrders; ++i)
+            book->addOrder(10, 10'000 + static_cast<price_t>(i % levels), OrderType::GoodTillCancel, Side::Sell, sink);
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(book->addOrder(static_cast<quantity_t>(10 * restingOrders), 10'000 + levels,
+                                                OrderType::FillAndKill, Side::Buy, sink));
+
+        state.PauseTiming();
+        book.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * restingOrders));
+}
+
+// 1M resting GoodTillDate orders on 1000 levels per side that expire at 1000
+// different times. With `purge` they are removed by one expireOrders() call
+// after the last expiry, otherwise cancelled one by one in expiry order, which
+// is what a caller had to do without the expiry engine
+template <template <Side> class Levels, bool purge>
+static void BM_ExpireOrders(benchmark::State& state)
+{
+    using Book = BasicOrderbook<Levels, ManualClock>;
+    constexpr int64_t expiries = 1000;
+    std::mt19937 rng{9};
+    std::uniform_int_distribution<price_t> priceDist(0, 999);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto book = std::make_unique<Book>();
+        EventSink sink;
+        std::vector<std::vector<orderId_t>> byExpiry(expiries);
+        for (size_t i = 0; i < restingOrders; ++i) {
+            bool buy = i % 2 == 0;
+            int64_t expiry = static_cast<int64_t>(rng() % expiries);
+            auto status = book->addOrder(10, buy ? 9000 + priceDist(rng) : 10001 + priceDist(rng),
+                                         OrderType::GoodTillDate, buy ? Side::Buy : Side::Sell,
+                                         microsec_t{1'000'000 + expiry * 1'000}, sink);
+            byExpiry[expiry].push_back(status.orderId);
+        }
+        book->clock().set(microsec_t{1'000'000 + expiries * 1'000});
+        state.ResumeTiming();
+
+        if constexpr (purge) {
+            book->expireOrders(sink);
+        } else {
+            for (const auto& ids : byExpiry)
+                for (auto id : ids)
+                    book->cancelOrder(id, sink);
+        }
+        benchmark::DoNotOptimize(book->bestBid());
+
+        state.PauseTiming();
+        book.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * restingOrders);
+}
+
+// Market data publisher that sends the depth of a book with 500 levels per side
+// after every add or cancel: either a copy of both sides or the level updates
+// of the command, which a subscriber applies to its DepthReplica
+template <bool deltas>
+static void BM_PublishDepth(benchmark::State& state)
+{
+    Orderbook book;
+    LevelUpdateCollector collector;
+    DepthReplica replica;
+    std::mt19937 rng{3};
+    std::vector<orderId_t> ids;
+    for (int i = 0; i < 10'000; ++i) {
+        bool buy = i % 2 == 0;
+        price_t price = buy ? 9500 + static_cast<price_t>(rng() % 500) : 10001 + static_cast<price_t>(rng() % 500);
+        Side side = buy ? Side::Buy : Side::Sell;
+        ids.push_back(book.addOrder(10, price, OrderType::GoodTillCancel, side, collector).orderId);
+    }
+    replica.apply(collector.updates());
+
+    size_t next = 0;
+    for (auto _ : state) {
+        collector.clear();
+        bool buy = rng() % 2 == 0;
+        price_t price = buy ? 9500 + static_cast<price_t>(rng() % 500) : 10001 + static_cast<price_t>(rng() % 500);
+        book.cancelOrder(ids[next], collector);
+        Side side = buy ? Side::Buy : Side::Sell;
+        ids[next] = book.addOrder(10, price, OrderType::GoodTillCancel, side, collector).orderId;
+        next = (next + 1) % ids.size();
+
+        if constexpr (deltas) {
+            replica.apply(collector.updates());
+        } else {
+            benchmark::DoNotOptimize(book.fullDepthAsk());
+            benchmark::DoNotOptimize(book.fullDepthBid());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// The churn of BM_PublishDepth published order by order: the subscriber applies
+// the order events of each command to its OrderReplica
+static void BM_PublishOrders(benchmark::State& state)
+{
+    Orderbook book;
+    OrderEventCollector collector{10'000};
+    OrderReplica replica;
+    std::mt19937 rng{3};
+    std::vector<orderId_t> ids;
+    for (int i = 0; i < 10'000; ++i) {
+        bool buy = i % 2 == 0;
+        price_t price = buy ? 9500 + static_cast<price_t>(rng() % 500) : 10001 + static_cast<price_t>(rng() % 500);
+        Side side = buy ? Side::Buy : Side::Sell;
+        ids.push_back(book.addOrder(10, price, OrderType::GoodTillCancel, side, collector).orderId);
+    }
+    replica.apply(collector.events());
+
+    size_t next = 0;
+    for (auto _ : state) {
+        collector.clear();
+        bool buy = rng() % 2 == 0;
+        price_t price = buy ? 9500 + static_cast<price_t>(rng() % 500) : 10001 + static_cast<price_t>(rng() % 500);
+        book.cancelOrder(ids[next], collector);
+        Side side = buy ? Side::Buy : Side::Sell;
+        ids[next] = book.addOrder(10, price, OrderType::GoodTillCancel, side, collector).orderId;
+        next = (next + 1) % ids.size();
+        replica.apply(collector.events());
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+enum class DepthQuery { Full, Top, Cached };
+
+// Publisher that sends the best 10 levels of both sides after every command of a
+// churn on 500 levels per side (every 16th command is a small trade at the top)
+template <typename Book, DepthQuery query>
+static void BM_TopOfBookQuery(benchmark::State& state)
+{
+    Book book;
+    EventSink sink;
+    std::mt19937 rng{5};
+    std::vector<orderId_t> ids;
+    auto randomPrice = [&](bool buy) {
+        return buy ? 9500 + static_cast<price_t>(rng() % 500) : 10001 + static_cast<price_t>(rng() % 500);
+    };
+    for (int i = 0; i < 10'000; ++i) {
+        bool buy = i % 2 == 0;
+        ids.push_back(
+            book.addOrder(10, randomPrice(buy), OrderType::GoodTillCancel, buy ? Side::Buy : Side::Sell, sink).orderId);
+    }
+
+    std::array<LevelView, Book::cachedLevels> out{};
+    size_t next = 0;
+    uint64_t commands = 0;
+    for (auto _ : state) {
+        bool buy = rng() % 2 == 0;
+        Side side = buy ? Side::Buy : Side::Sell;
+        if (++commands % 16 == 0) {
+            book.addOrder(1, buy ? 10'500 : 9'500, OrderType::FillAndKill, side, sink);
+        } else {
+            book.cancelOrder(ids[next], sink);
+            ids[next] = book.addOrder(10, randomPrice(buy), OrderType::GoodTillCancel, side, sink).orderId;
+            next = (next + 1) % ids.size();
+        }
+
+        if constexpr (query == DepthQuery::Full) {
+            benchmark::DoNotOptimize(book.fullDepthAsk());
+            benchmark::DoNotOptimize(book.fullDepthBid());
+        } else if constexpr (query == DepthQuery::Top) {
+            benchmark::DoNotOptimize(book.topDepth(Side::Sell, out.size(), out));
+            benchmark::DoNotOptimize(book.topDepth(Side::Buy, out.size(), out));
+        } else {
+            benchmark::DoNotOptimize(book.cachedTopDepth(Side::Sell).data());
+            benchmark::DoNotOptimize(book.cachedTopDepth(Side::Buy).data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Restart with 5M orders resting on 1000 levels per side: either every add since
+// the open is run through the book again, or the book is loaded from the
+// snapshot it saved before the restart
+enum class Startup { Replay, Snapshot };
+
+template <typename Book, Startup startup>
+static void BM_Startup(benchmark::State& state)
+{
+    constexpr size_t orders = 5'000'000;
+    std::mt19937 rng{15};
+    std::uniform_int_distribution<price_t> priceDist(0, 999);
+    std::vector<price_t> prices(orders);
+    for (size_t i = 0; i < orders; ++i)
+        prices[i] = i % 2 == 0 ? 9000 + priceDist(rng) : 10001 + priceDist(rng);
+
+    EventSink sink;
+    auto replay = [&](Book& book) {
+        for (size_t i = 0; i < orders; ++i)
+            book.addOrder(1 + static_cast<quantity_t>(i % 100), prices[i], OrderType::GoodTillCancel,
+                          i % 2 == 0 ? Side::Buy : Side::Sell, sink);
+    };
+
+    auto path = std::filesystem::temp_directory_path() / "bench_orderbook.snapshot";
+    if constexpr (startup == Startup::Snapshot) {
+        auto book = std::make_unique<Book>();
+        replay(*book);
+        if (book->saveSnapshot(path) != SnapshotError::None) {
+            state.SkipWithError("could not save the snapshot");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        auto book = std::make_unique<Book>();
+        if constexpr (startup == Startup::Snapshot)
+            benchmark::DoNotOptimize(book->loadSnapshot(path));
+        else
+            replay(*book);
+        benchmark::DoNotOptimize(book->bestBid());
+
+        state.PauseTiming();
+        book.reset();
+        state.ResumeTiming();
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * orders);
+}
+
+// Per command latency of adds and cancels of one order at a time next to 1000
+// resting orders, applied directly or through a JournaledBook that hands every
+// command to the journal's writer thread
+template <bool journaled>
+static void BM_JournaledCommand(benchmark::State& state)
+{
+    Orderbook book;
+    EventSink sink;
+    for (price_t price = 0; price < 1000; ++price)
+        book.addOrder(10, 9000 + price, OrderType::GoodTillCancel, Side::Buy, sink);
+
+    auto path = std::filesystem::temp_directory_path() / "bench_orderbook.journal";
+    std::filesystem::remove(path);
+    std::optional<Journal> journal;
+    if constexpr (journaled)
+        journal.emplace(path);
+
+    Command add;
+    add.action = Actions::ADD;
+    add.quantity = 10;
+    add.type = OrderType::GoodTillCancel;
+    add.side = Side::Sell;
+    Command cancel;
+    cancel.action = Actions::CANCEL;
+
+    price_t offset = 0;
+    for (auto _ : state) {
+        add.price = 10001 + offset;
+        offset = (offset + 1) % 100;
+        if constexpr (journaled) {
+            JournaledBook journaledBook{book, *journal};
+            cancel.oid = journaledBook.apply(add, sink).orderId;
+            journaledBook.apply(cancel, sink);
+        } else {
+            cancel.oid = book.addOrder(add.quantity, add.price, add.type, add.side, sink).orderId;
+            book.cancelOrder(cancel.oid, sink);
+        }
+    }
+
+    if constexpr (journaled) {
+        state.counters["stalls"] = static_cast<double>(journal->stalls());
+        journal.reset();
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// Bytes of this process that are not shared with another one, i.e. while a
+// checkpoint child runs, the pages the parent had to copy
+static size_t privateDirtyBytes()
+{
+    std::ifstream rollup{"/proc/self/smaps_rollup"};
+    std::string key;
+    size_t kilobytes = 0;
+    while (rollup >> key) {
+        if (key == "Private_Dirty:") {
+            rollup >> kilobytes;
+            return kilobytes * 1024;
+        }
+    }
+    return 0;
+}
+
+// Snapshot of a book with 5M resting orders taken on the engine thread or by a
+// forked child while the parent keeps cancelling random resting orders and
+// adding new ones. Time is the pause of the engine thread, extra_rss the
+// memory the parent copied while the child was writing
+template <bool fork>
+static void BM_Checkpoint(benchmark::State& state)
+{
+    constexpr size_t orders = 5'000'000;
+    std::mt19937 rng{17};
+    std::uniform_int_distribution<price_t> priceDist(0, 999);
+    auto book = std::make_unique<Orderbook>();
+    EventSink sink;
+    for (size_t i = 0; i < orders; ++i) {
+        bool buy = i % 2 == 0;
+        book->addOrder(1 + static_cast<quantity_t>(i % 100), buy ? 9000 + priceDist(rng) : 10001 + priceDist(rng),
+                       OrderType::GoodTillCancel, buy ? Side::Buy : Side::Sell, sink);
+    }
+    orderId_t nextId = orders + 2;
+
+    auto path = std::filesystem::temp_directory_path() / "bench_orderbook_checkpoint.snapshot";
+    size_t extraRss = 0;
+    size_t commands = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        if constexpr (fork) {
+            auto checkpoint = Checkpoint::start(*book, path);
+            state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            while (!checkpoint.done()) {
+                for (int i = 0; i < 10'000; ++i, ++commands) {
+                    bool buy = rng() % 2 == 0;
+                    book->cancelOrder(2 + rng() % (nextId - 2), sink);
+                    book->addOrder(10, buy ? 9000 + priceDist(rng) : 10001 + priceDist(rng),
+                                   OrderType::GoodTillCancel, buy ? Side::Buy : Side::Sell, sink);
+                    nextId++;
+                }
+                // Only counts while the child still shares the rest of the memory
+                size_t copied = privateDirtyBytes();
+                if (!checkpoint.done())
+                    extraRss = std::max(extraRss, copied);
+            }
+            if (checkpoint.result() != SnapshotError::None)
+                state.SkipWithError("checkpoint failed");
+        } else {
+            if (book->saveSnapshot(path) != SnapshotError::None)
+                state.SkipWithError("snapshot failed");
+            state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    std::filesystem::remove(path);
+    state.counters["extra_rss_MB"] = static_cast<double>(extraRss) / (1 << 20);
+    state.counters["commands_during"] = static_cast<double>(commands);
+}
+
+// Trending price stream over 100k pending stops. The price walks 1000 ticks up
+// and down again, every step rests an order on each side of it and trades
+// through the next tick. Every triggered stop is replaced by one on the other
+// side of the price, so the number of pending stops stays the same. Indexed
+// stops are held by the book (addStopOrder), Naive is what the book did without
+// them: a list next to it that is scanned for crossed triggers after every
+// command that traded
+enum class Stops { None, Naive, Indexed };
+
+template <Stops stops>
+static void BM_TrendingWithStops(benchmark::State& state)
+{
+    struct StopSink : EventSink {
+        std::vector<Side> triggered;
+        std::optional<price_t> lastTrade;
+        void onTrade(const Trade& trade) { lastTrade = trade.price; }
+        void onTrigger(orderId_t, const OrderInfo& info) { triggered.push_back(info.side); }
+    };
+    constexpr size_t pending = 100'000;
+    constexpr price_t low = 10'000;
+    constexpr price_t range = 1'000;
+    std::mt19937 rng{18};
+    auto book = std::make_unique<Orderbook>();
+    StopSink sink;
+    price_t price = low + range / 2;
+    price_t direction = 1;
+
+    std::vector<StopOrder> naive;
+    auto addStop = [&](Side side) {
+        price_t trigger = side == Side::Buy ? price + 1 + static_cast<price_t>(rng() % (low + range - price + 1))
+                                            : price - 1 - static_cast<price_t>(rng() % (price - low + 1));
+        if constexpr (stops == Stops::Indexed)
+            book->addStopOrder(1, trigger, 0, OrderType::Stop, side, sink);
+        else if constexpr (stops == Stops::Naive)
+            naive.push_back(StopOrder{.orderId = 0,
+                                      .openTime = microsec_t{0},
+                                      .trigger = trigger,
+                                      .price = trigger,
+                                      .quantity = 1,
+                                      .type = OrderType::Stop,
+                                      .side = side});
+    };
+    // Scans every pending stop after a trade, triggered ones are sent as market orders
+    auto triggerNaive = [&]() {
+        while (sink.lastTrade.has_value()) {
+            price_t last = sink.lastTrade.value();
+            sink.lastTrade.reset();
+            std::vector<StopOrder> crossed;
+            std::erase_if(naive, [&](const StopOrder& stop) {
+                bool hit = stop.side == Side::Buy ? stop.trigger <= last : stop.trigger >= last;
+                if (hit)
+                    crossed.push_back(stop);
+                return hit;
+            });
+            for (const StopOrder& stop : crossed) {
+                sink.triggered.push_back(stop.side);
+                book->addOrder(stop.quantity, stop.trigger, OrderType::Market, stop.side, sink);
+            }
+        }
+    };
+
+    if constexpr (stops != Stops::None)
+        for (size_t i = 0; i < pending; ++i)
+            addStop(i % 2 == 0 ? Side::Buy : Side::Sell);
+
+    size_t triggered = 0;
+    for (auto _ : state) {
+        book->addOrder(10, price + 1, OrderType::GoodTillCancel, Side::Sell, sink);
+        book->addOrder(10, price - 1, OrderType::GoodTillCancel, Side::Buy, sink);
+        sink.lastTrade.reset();
+        book->addOrder(20, price + direction, OrderType::FillAndKill, direction > 0 ? Side::Buy : Side::Sell, sink);
+        if constexpr (stops == Stops::Naive)
+            triggerNaive();
+
+        price += direction;
+        if (price == low + range || price == low)
+            direction = -direction;
+        for (Side side : sink.triggered)
+            addStop(opposite(side));
+        triggered += sink.triggered.size();
+        sink.triggered.clear();
+    }
+    state.counters["triggered_per_step"] = static_cast<double>(triggered) / static_cast<double>(state.iterations());
+}
+
+// Level of 16 icebergs that show 10 at a time and have a large reserve, every
+// iteration a FAK takes one clip. Native icebergs refresh inside the book, the
+// other case is what a client without them does: plain 10 lot orders, every
+// filled one is added again (new id, node and index entry) at the back
+template <typename Book, bool native>
+static void BM_IcebergRefresh(benchmark::State& state)
+{
+    struct FillSink : EventSink {
+        size_t fills = 0;
+        void onTrade(const Trade&) { fills++; }
+    };
+    constexpr size_t icebergs = 16;
+    constexpr quantity_t clip = 10;
+    auto book = std::make_unique<Book>();
+    FillSink sink;
+    for (size_t i = 0; i < icebergs; ++i) {
+        if constexpr (native)
+            book->addIcebergOrder(std::numeric_limits<quantity_t>::max() - 1, clip, 100, OrderType::GoodTillCancel,
+                                  Side::Buy, microsec_t{0}, sink);
+        else
+            book->addOrder(clip, 100, OrderType::GoodTillCancel, Side::Buy, sink);
+    }
+
+    for (auto _ : state) {
+        book->addOrder(clip, 100, OrderType::FillAndKill, Side::Sell, sink);
+        if constexpr (!native)
+            book->addOrder(clip, 100, OrderType::GoodTillCancel, Side::Buy, sink);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(sink.fills));
+}
+
+// One timestamp, what the book pays per new order
+// Call auction with 100k levels per side, all of them crossed: bids and asks on
+// the same 100k prices with uneven quantities. PerPriceQueries searches the
+// equilibrium the way a caller could before, two availableVolume() queries per
+// price, Scan asks equilibrium() and Uncross times the whole uncross.
+// IcebergScan is Scan with every 100th ask an iceberg, which takes the level merge
+enum class Auction { PerPriceQueries, Scan, IcebergScan, Uncross };
+
+template <typename Book, Auction mode>
+static void BM_Auction(benchmark::State& state)
+{
+    constexpr price_t levels = 100'000;
+    constexpr price_t low = 10'000;
+    auto fill = [](Book& book, EventSink& sink) {
+        book.startAuction();
+        for (price_t i = 0; i < levels; ++i) {
+            book.addOrder(1 + static_cast<quantity_t>(i % 13), low + i, OrderType::GoodTillCancel, Side::Buy, sink);
+            if (mode == Auction::IcebergScan && i % 100 == 0)
+                book.addIcebergOrder(50, 5, low + i, OrderType::GoodTillCancel, Side::Sell, microsec_t{0}, sink);
+            else
+                book.addOrder(1 + static_cast<quantity_t>(i % 7), low + i, OrderType::GoodTillCancel, Side::Sell,
+                              sink);
+        }
+    };
+
+    auto book = std::make_unique<Book>();
+    EventSink sink;
+    fill(*book, sink);
+    for (auto _ : state) {
+        if constexpr (mode == Auction::PerPriceQueries) {
+            uint64_t best = 0;
+            price_t bestPrice = 0;
+            for (price_t price = low; price < low + levels; ++price) {
+                uint64_t volume =
+                    std::min(book->availableVolume(Side::Buy, price), book->availableVolume(Side::Sell, price));
+                if (volume > best) {
+                    best = volume;
+                    bestPrice = price;
+                }
+            }
+            benchmark::DoNotOptimize(bestPrice);
+        } else if constexpr (mode == Auction::Scan || mode == Auction::IcebergScan) {
+            benchmark::DoNotOptimize(book->equilibrium());
+        } else {
+            benchmark::DoNotOptimize(book->uncross(sink));
+            state.PauseTiming();
+            book = std::make_unique<Book>();
+            fill(*book, sink);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * levels);
+}
+
+// A 10M order ladder book with its orders and index on the heap, in an arena of
+// 4K pages or in one of huge pages (transparent ones if no hugetlb pages are
+// reserved). Arenas are prefaulted while the timer is paused. Grow times adding
+// the 10M orders to an empty book, Churn cancels a random resting order and adds
+// one at its price, which lands in the node just freed, so every command touches
+// a random page of the 700MB of nodes and index
+enum class Storage { Heap, SmallPages, HugePages };
+enum class Growth { Grow, Churn };
+
+template <Storage storage, Growth mode>
+static void BM_BookStorage(benchmark::State& state)
+{
+    constexpr size_t orders = 10'000'000;
+    constexpr size_t churn = 1'000'000;
+    auto makeBook = [] {
+        if constexpr (storage == Storage::Heap)
+            return std::make_unique<LadderOrderbook>();
+        else
+            return std::make_unique<LadderOrderbook>(StorageOptions{
+                .orders = orders,
+                .backing = storage == Storage::SmallPages ? PageBacking::Small : PageBacking::Huge,
+                .prefault = true});
+    };
+    auto priceOf = [](size_t i) {
+        return i % 2 == 0 ? 9500 + static_cast<price_t>(i % 500) : 10001 + static_cast<price_t>(i % 499);
+    };
+    auto sideOf = [](size_t i) { return i % 2 == 0 ? Side::Buy : Side::Sell; };
+    // Pages the arena got, Huge falls back to Transparent
+    auto backing = [](const LadderOrderbook& book) {
+        return book.arena().capacity() == 0 ? std::string{"heap"} : std::string{toString(book.arena().backing())};
+    };
+    EventSink sink;
+    std::mt19937 rng{11};
+
+    std::unique_ptr<LadderOrderbook> book;
+    std::vector<orderId_t> ids;
+    std::vector<size_t> slots;
+    if constexpr (mode == Growth::Churn) {
+        book = makeBook();
+        for (size_t i = 0; i < orders; ++i)
+            ids.push_back(book->addOrder(10, priceOf(i), OrderType::GoodTillCancel, sideOf(i), sink).orderId);
+        for (size_t i = 0; i < churn; ++i)
+            slots.push_back(rng() % orders);
+    }
+
+    for (auto _ : state) {
+        if constexpr (mode == Growth::Grow) {
+            state.PauseTiming();
+            book = makeBook();
+            state.ResumeTiming();
+            for (size_t i = 0; i < orders; ++i)
+                book->addOrder(10, priceOf(i), OrderType::GoodTillCancel, sideOf(i), sink);
+            state.PauseTiming();
+            state.SetLabel(backing(*book));
+            book.reset();
+            state.ResumeTiming();
+        } else {
+            for (size_t slot : slots) {
+                book->cancelOrder(ids[slot], sink);
+                ids[slot] = book->addOrder(10, priceOf(slot), OrderType::GoodTillCancel, sideOf(slot), sink).orderId;
+            }
+        }
+    }
+    if constexpr (mode == Growth::Churn)
+        state.SetLabel(backing(*book));
+    state.SetItemsProcessed(state.iterations() * (mode == Growth::Grow ? orders : churn));
+}
+
+template <typename Clock>
+static void BM_ClockNow(benchmark::State& state)
+{
+    Clock clock;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(clock.now());
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_IndexCancelHeavy<UnorderedMapIndex>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IndexCancelHeavy<OrderIndex>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookCancelHeavy<Orderbook>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookCancelHeavy<LadderOrderbook>)->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_FillOrKillDeepBook<Orderbook>)->Arg(10)->Arg(1000);
+BENCHMARK(BM_FillOrKillDeepBook<LadderOrderbook>)->Arg(10)->Arg(1000);
+BENCHMARK(BM_AmendDown<Orderbook>);
+BENCHMARK(BM_AmendDown<LadderOrderbook>);
+BENCHMARK(BM_HalfInvalidFlood<Orderbook>);
+BENCHMARK(BM_HalfInvalidFlood<LadderOrderbook>);
+BENCHMARK(BM_DeepSweep<Orderbook>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DeepSweep<LadderOrderbook>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExpireOrders<MapLevels, false>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExpireOrders<MapLevels, true>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExpireOrders<TickLevels, false>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExpireOrders<TickLevels, true>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PublishDepth<false>);
+BENCHMARK(BM_PublishDepth<true>);
+BENCHMARK(BM_PublishOrders);
+BENCHMARK(BM_TopOfBookQuery<Orderbook, DepthQuery::Full>);
+BENCHMARK(BM_TopOfBookQuery<Orderbook, DepthQuery::Top>);
+BENCHMARK(BM_TopOfBookQuery<Orderbook, DepthQuery::Cached>);
+BENCHMARK(BM_TopOfBookQuery<LadderOrderbook, DepthQuery::Full>);
+BENCHMARK(BM_TopOfBookQuery<LadderOrderbook, DepthQuery::Top>);
+BENCHMARK(BM_TopOfBookQuery<LadderOrderbook, DepthQuery::Cached>);
+BENCHMARK(BM_Startup<Orderbook, Startup::Replay>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Startup<Orderbook, Startup::Snapshot>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Startup<LadderOrderbook, Startup::Replay>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Startup<LadderOrderbook, Startup::Snapshot>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_JournaledCommand<false>)->Iterations(1'000'000);
+BENCHMARK(BM_JournaledCommand<true>)->Iterations(1'000'000);
+BENCHMARK(BM_Checkpoint<false>)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Checkpoint<true>)->UseManualTime()->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TrendingWithStops<Stops::None>)->Iterations(200'000);
+BENCHMARK(BM_TrendingWithStops<Stops::Naive>)->Iterations(200'000);
+BENCHMARK(BM_TrendingWithStops<Stops::Indexed>)->Iterations(200'000);
+BENCHMARK(BM_IcebergRefresh<Orderbook, false>);
+BENCHMARK(BM_IcebergRefresh<Orderbook, true>);
+BENCHMARK(BM_IcebergRefresh<LadderOrderbook, false>);
+BENCHMARK(BM_IcebergRefresh<LadderOrderbook, true>);
+BENCHMARK(BM_Auction<Orderbook, Auction::PerPriceQueries>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Auction<Orderbook, Auction::Scan>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Auction<LadderOrderbook, Auction::Scan>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Auction<Orderbook, Auction::IcebergScan>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Auction<LadderOrderbook, Auction::IcebergScan>)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Auction<Orderbook, Auction::Uncross>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Auction<LadderOrderbook, Auction::Uncross>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookStorage<Storage::Heap, Growth::Grow>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookStorage<Storage::SmallPages, Growth::Grow>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookStorage<Storage::HugePages, Growth::Grow>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookStorage<Storage::Heap, Growth::Churn>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookStorage<Storage::SmallPages, Growth::Churn>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BookStorage<Storage::HugePages, Growth::Churn>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ClockNow<SystemClock>);
+BENCHMARK(BM_ClockNow<TscClock>);
+BENCHMARK(BM_ClockNow<ManualClock>);
+
+BENCHMARK_MAIN();
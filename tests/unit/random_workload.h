@@ -0,0 +1,55 @@
+#pragma once
+
+#include "orderbook.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+// Passive adds like data/book_growth.txt and icebergs, mixed with cancels,
+// amends, replacing modifies and orders that sweep into the other side. `sink`
+// is cleared before every command and check(i) is called after command i, the
+// run stops at the first fatal failure of a check
+template <typename Book, typename Sink, typename Check>
+void runRandomWorkload(Book& book, Sink& sink, uint32_t seed, Check&& check)
+{
+    std::mt19937 rng{seed};
+    std::vector<orderId_t> ids;
+
+    for (int i = 0; i < 20'000; ++i) {
+        sink.clear();
+        uint32_t r = rng() % 100;
+        bool buy = rng() % 2 == 0;
+        Side side = buy ? Side::Buy : Side::Sell;
+        quantity_t quantity = 1 + rng() % 100;
+        price_t passive = buy ? 9500 + static_cast<price_t>(rng() % 500) : 10001 + static_cast<price_t>(rng() % 500);
+
+        if (r < 55 || ids.empty()) {
+            ids.push_back(book.addOrder(quantity, passive, OrderType::GoodTillCancel, side, sink).orderId);
+        } else if (r < 60) {
+            auto status = book.addIcebergOrder(quantity * 5, quantity, passive, OrderType::GoodTillCancel, side,
+                                               microsec_t{0}, sink);
+            ids.push_back(status.orderId);
+        } else if (r < 78) {
+            size_t idx = rng() % ids.size();
+            book.cancelOrder(ids[idx], sink);
+            ids[idx] = ids.back();
+            ids.pop_back();
+        } else if (r < 90) {
+            size_t idx = rng() % ids.size();
+            auto status = book.modifyOrder(ids[idx], ModifyOrder{.quantity = quantity}, sink);
+            if (status.accepted())
+                ids[idx] = status.orderId;
+        } else {
+            price_t price = buy ? 10050 : 9950;
+            OrderType type = r < 94 ? OrderType::FillAndKill : (r < 97 ? OrderType::GoodTillCancel : OrderType::Market);
+            auto status = book.addOrder(quantity * 10, price, type, side, sink);
+            if (type == OrderType::GoodTillCancel)
+                ids.push_back(status.orderId);
+        }
+
+        check(i);
+        if (::testing::Test::HasFatalFailure())
+            return;
+    }
+}
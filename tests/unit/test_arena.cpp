@@ -0,0 +1,73 @@
+#include "arena.h"
+#include "orderbook.h"
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+
+TEST(PageArenaTest, EmptyArenaAllocatesNothing)
+{
+    PageArena arena;
+    EXPECT_EQ(arena.capacity(), 0);
+    EXPECT_EQ(arena.allocate(64, 8), nullptr);
+    EXPECT_FALSE(arena.owns(&arena));
+}
+
+TEST(PageArenaTest, HandsOutAlignedBlocksUntilFull)
+{
+    PageArena arena{1, PageBacking::Small};
+    ASSERT_EQ(arena.capacity(), PageArena::hugePageSize);
+    EXPECT_EQ(arena.backing(), PageBacking::Small);
+
+    auto* first = static_cast<std::byte*>(arena.allocate(10, 8));
+    auto* second = static_cast<std::byte*>(arena.allocate(100, 64));
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(first) % PageArena::hugePageSize, 0);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(second) % 64, 0);
+    EXPECT_EQ(second - first, 64);
+    EXPECT_EQ(arena.used(), 164);
+    std::memset(second, 0xff, 100);
+
+    EXPECT_EQ(arena.allocate(PageArena::hugePageSize, 8), nullptr);
+    EXPECT_NE(arena.allocate(PageArena::hugePageSize - 164, 4), nullptr);
+    EXPECT_EQ(arena.allocate(1, 1), nullptr);
+    EXPECT_TRUE(arena.owns(second));
+}
+
+TEST(PageArenaTest, HugePagesFallBackToTransparentOnes)
+{
+    PageArena arena{3 * PageArena::hugePageSize, PageBacking::Huge, true};
+    ASSERT_EQ(arena.capacity(), 3 * PageArena::hugePageSize);
+    // Without hugetlb pages reserved the mapping gets transparent huge pages
+    EXPECT_NE(arena.backing(), PageBacking::Small);
+    auto* block = static_cast<std::byte*>(arena.allocate(arena.capacity(), PageArena::hugePageSize));
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(block) % PageArena::hugePageSize, 0);
+    block[arena.capacity() - 1] = std::byte{1};
+}
+
+// The book places its orders and index in the arena and keeps working past it
+TEST(PageArenaTest, BookOutgrowsItsArena)
+{
+    LadderOrderbook book{StorageOptions{.orders = 1000, .backing = PageBacking::Transparent, .prefault = true}};
+    LadderOrderbook reference;
+    EventSink sink;
+    ASSERT_GT(book.arena().capacity(), 0);
+    // The arena is rounded up to 2MB, fill past what it can hold
+    size_t arenaOrders = book.arena().capacity() / OrderPool::bytesFor(1) * OrderPool::pageSize;
+    for (size_t i = 0; i < arenaOrders + 5000; ++i) {
+        Side side = i % 3 == 0 ? Side::Buy : Side::Sell;
+        price_t price = side == Side::Buy ? 10000 - static_cast<price_t>(i % 50) : 10001 + static_cast<price_t>(i % 70);
+        EXPECT_EQ(book.addOrder(5, price, OrderType::GoodTillCancel, side, sink).orderId,
+                  reference.addOrder(5, price, OrderType::GoodTillCancel, side, sink).orderId);
+    }
+    EXPECT_EQ(book.restingOrders(), arenaOrders + 5000);
+    EXPECT_EQ(book.memoryStats().orders.bytes, reference.memoryStats().orders.bytes);
+
+    for (orderId_t id = 1; id <= arenaOrders + 5000; id += 7)
+        EXPECT_EQ(book.cancelOrder(id, sink), reference.cancelOrder(id, sink));
+    book.addOrder(1000, 10005, OrderType::FillAndKill, Side::Buy, sink);
+    reference.addOrder(1000, 10005, OrderType::FillAndKill, Side::Buy, sink);
+    EXPECT_EQ(book.fullDepthAsk(), reference.fullDepthAsk());
+    EXPECT_EQ(book.fullDepthBid(), reference.fullDepthBid());
+}
@@ -0,0 +1,107 @@
+#include "bookManager.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+struct CountingSink : EventSink {
+    size_t accepted{0};
+    size_t trades{0};
+    std::vector<RejectReason> rejected;
+    std::vector<orderId_t> rejectedIds;
+
+    void onAccept(orderId_t, const OrderInfo&) { accepted++; }
+    void onTrade(const Trade&) { trades++; }
+    void onReject(orderId_t orderId, RejectReason reason)
+    {
+        rejected.push_back(reason);
+        rejectedIds.push_back(orderId);
+    }
+};
+
+static Command add(instrumentId_t instrument, quantity_t quantity, price_t price, Side side)
+{
+    return Command{.action = Actions::ADD,
+                   .type = OrderType::GoodTillCancel,
+                   .quantity = quantity,
+                   .price = price,
+                   .side = side,
+                   .instrument = instrument};
+}
+
+class BookManagerTest : public testing::Test
+{
+protected:
+    BookManager<Orderbook> books;
+    CountingSink sink;
+};
+
+TEST_F(BookManagerTest, BooksAreCreatedOnFirstCommand)
+{
+    EXPECT_EQ(books.size(), 0);
+    EXPECT_EQ(books.find(3), nullptr);
+
+    books.process(add(3, 10, 100, Side::Buy), sink);
+    EXPECT_EQ(books.size(), 1);
+    ASSERT_NE(books.find(3), nullptr);
+    EXPECT_EQ(books.find(3)->bestBid(), 100);
+    EXPECT_EQ(books.find(0), nullptr);
+}
+
+TEST_F(BookManagerTest, InstrumentsDoNotInteract)
+{
+    // Same prices on both sides, but on different instruments they must not trade
+    std::vector<Command> commands{add(1, 10, 100, Side::Buy), add(2, 10, 100, Side::Sell), add(2, 5, 100, Side::Buy),
+                                  add(1, 5, 101, Side::Sell)};
+    books.process(commands, sink);
+
+    EXPECT_EQ(sink.accepted, 4);
+    EXPECT_EQ(sink.trades, 1);
+    EXPECT_EQ(books.find(1)->bestBid(), 100);
+    EXPECT_EQ(books.find(1)->bestAsk(), 101);
+    EXPECT_EQ(books.find(2)->bestBid(), std::nullopt);
+    EXPECT_EQ(books.find(2)->fullDepthAsk()[0].volume, 5);
+}
+
+TEST_F(BookManagerTest, OrderIdsArePerInstrument)
+{
+    books.process(add(1, 10, 100, Side::Buy), sink);
+    books.process(add(2, 10, 100, Side::Buy), sink);
+
+    // Both books handed out the same id, a cancel only reaches its own instrument
+    books.process(Command{.action = Actions::CANCEL, .oid = 2, .instrument = 2}, sink);
+    EXPECT_EQ(books.find(1)->bestBid(), 100);
+    EXPECT_EQ(books.find(2)->bestBid(), std::nullopt);
+}
+
+TEST_F(BookManagerTest, ShardsOwnDisjointInstruments)
+{
+    constexpr size_t shards = 3;
+    std::vector<BookManager<Orderbook>> managers;
+    for (size_t shard = 0; shard < shards; ++shard)
+        managers.emplace_back(shard, shards);
+
+    for (instrumentId_t instrument = 0; instrument < 30; ++instrument) {
+        size_t owners = 0;
+        for (const auto& manager : managers)
+            owners += manager.owns(instrument);
+        EXPECT_EQ(owners, 1);
+        EXPECT_TRUE(managers[BookManager<Orderbook>::shardOf(instrument, shards)].owns(instrument));
+    }
+
+    // Commands for instruments of another shard are rejected and create no book
+    managers[0].process(add(1, 10, 100, Side::Buy), sink);
+    EXPECT_EQ(sink.rejected, (std::vector<RejectReason>{RejectReason::UnknownInstrument}));
+    EXPECT_EQ(managers[0].size(), 0);
+}
+
+TEST_F(BookManagerTest, ForeignInstrumentsReportTheOrderIdOfTheCommand)
+{
+    BookManager<Orderbook> shard{0, 2};
+    Command cancel{.action = Actions::CANCEL, .oid = 42, .instrument = 1};
+    shard.process(add(1, 10, 100, Side::Buy), sink);
+    shard.process(cancel, sink);
+
+    // Like a refused add of a book, the add has no id yet
+    EXPECT_EQ(sink.rejectedIds, (std::vector<orderId_t>{0, 42}));
+    EXPECT_EQ(sink.rejected,
+              (std::vector<RejectReason>{RejectReason::UnknownInstrument, RejectReason::UnknownInstrument}));
+}
@@ -0,0 +1,99 @@
+#include "checkpoint.h"
+#include "journal.h"
+#include "orderbook.h"
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+
+static std::filesystem::path tempPath(const std::string& name)
+{
+    auto path = std::filesystem::temp_directory_path() / ("orderbook_test_checkpoint_" + name);
+    std::filesystem::remove(path);
+    return path;
+}
+
+// Resting adds on both sides with a crossing order every 10 commands
+static void addOrders(JournaledBook<ManualClockOrderbook>& book, int from, int to)
+{
+    EventSink sink;
+    for (int i = from; i < to; ++i) {
+        book.book().clock().set(microsec_t{i});
+        Command command;
+        command.action = Actions::ADD;
+        command.side = i % 2 == 0 ? Side::Buy : Side::Sell;
+        command.quantity = 1 + static_cast<quantity_t>(i % 7);
+        command.type = OrderType::GoodTillCancel;
+        command.price = command.side == Side::Buy ? 990 + i % 10 : 1001 + i % 10;
+        if (i % 10 == 0) {
+            command.type = OrderType::FillAndKill;
+            command.price = command.side == Side::Buy ? 1005 : 995;
+        }
+        book.apply(command, sink);
+    }
+}
+
+TEST(CheckpointTest, RecoverFromCheckpointAndJournal)
+{
+    auto journalFile = tempPath("recover.journal");
+    auto snapshotFile = tempPath("recover.snapshot");
+    ManualClockOrderbook original;
+    levels_t bidsAtCheckpoint;
+    std::uint64_t checkpointSequence = 0;
+    {
+        Journal journal{journalFile};
+        JournaledBook journaled{original, journal};
+        addOrders(journaled, 1, 2000);
+
+        bidsAtCheckpoint = original.fullDepthBid();
+        auto checkpoint = Checkpoint::start(original, snapshotFile, journal);
+        // The parent keeps matching while the child writes
+        addOrders(journaled, 2000, 3000);
+        EXPECT_EQ(checkpoint.wait(), SnapshotError::None);
+        checkpointSequence = checkpoint.journalSequence();
+        EXPECT_EQ(checkpointSequence, 1999);
+    }
+
+    // The snapshot holds the book as it was at the fork
+    auto header = readSnapshotHeader(snapshotFile);
+    ASSERT_TRUE(header.has_value());
+    EXPECT_EQ(header->journalSequence, checkpointSequence);
+    ManualClockOrderbook restored;
+    ASSERT_EQ(restored.loadSnapshot(snapshotFile), SnapshotError::None);
+    EXPECT_EQ(restored.fullDepthBid(), bidsAtCheckpoint);
+
+    // and the journal only what came after it
+    JournalReader reader{journalFile};
+    ASSERT_TRUE(reader.ok());
+    ASSERT_FALSE(reader.entries().empty());
+    EXPECT_EQ(reader.entries().front().sequence, checkpointSequence + 1);
+    auto entries = reader.entriesAfter(header->journalSequence);
+    ASSERT_TRUE(entries.has_value());
+    EXPECT_FALSE(reader.entriesAfter(header->journalSequence - 1).has_value());
+
+    EventSink sink;
+    EXPECT_TRUE(replayJournal(*entries, restored, sink).consistent);
+    EXPECT_EQ(restored.fullDepthAsk(), original.fullDepthAsk());
+    EXPECT_EQ(restored.fullDepthBid(), original.fullDepthBid());
+
+    std::filesystem::remove(journalFile);
+    std::filesystem::remove(snapshotFile);
+}
+
+TEST(CheckpointTest, FailedCheckpointKeepsTheJournal)
+{
+    auto journalFile = tempPath("failed.journal");
+    auto snapshotFile = tempPath("missing_directory") / "snapshot";
+    ManualClockOrderbook book;
+    {
+        Journal journal{journalFile};
+        JournaledBook journaled{book, journal};
+        addOrders(journaled, 1, 100);
+        auto checkpoint = Checkpoint::start(book, snapshotFile, journal);
+        EXPECT_EQ(checkpoint.wait(), SnapshotError::Io);
+    }
+
+    JournalReader reader{journalFile};
+    ASSERT_FALSE(reader.entries().empty());
+    EXPECT_EQ(reader.entries().front().sequence, 1);
+    std::filesystem::remove(journalFile);
+}
@@ -0,0 +1,44 @@
+#include "clock.h"
+#include "orderbook.h"
+#include <gtest/gtest.h>
+
+TEST(ClockTest, ManualClockOnlyMovesWhenTold)
+{
+    ManualClock clock;
+    EXPECT_EQ(clock.now(), microsec_t{0});
+
+    clock.set(microsec_t{100});
+    EXPECT_EQ(clock.now(), microsec_t{100});
+    EXPECT_EQ(clock.now(), microsec_t{100});
+
+    clock.advance(microsec_t{5});
+    EXPECT_EQ(clock.now(), microsec_t{105});
+}
+
+TEST(ClockTest, TscClockIsMonotonicAndFollowsSystemClock)
+{
+    TscClock tsc;
+    EXPECT_GT(TscClock::cyclesPerMicrosecond(), 0.0);
+
+    auto previous = tsc.now();
+    for (int i = 0; i < 1000; ++i) {
+        auto now = tsc.now();
+        EXPECT_GE(now, previous);
+        previous = now;
+    }
+
+    // Generous bound, the two only have to agree on the epoch and the rate
+    auto difference = tsc.now() - SystemClock{}.now();
+    EXPECT_LT(std::chrono::abs(difference), std::chrono::milliseconds{100});
+}
+
+TEST(ClockTest, BookReadsItsOwnClock)
+{
+    ManualClockOrderbook book;
+    book.clock().set(microsec_t{42});
+    EXPECT_EQ(book.clock().now(), microsec_t{42});
+
+    // Orders are stamped without touching the wall clock, time does not move on its own
+    book.addOrder(10, 100, OrderType::GoodTillCancel, Side::Buy);
+    EXPECT_EQ(book.clock().now(), microsec_t{42});
+}
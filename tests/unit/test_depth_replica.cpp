@@ -0,0 +1,56 @@
+#include "depthReplica.h"
+#include "orderbook.h"
+#include "random_workload.h"
+#include <gtest/gtest.h>
+
+template <typename Book>
+static void followRandomWorkload(uint32_t seed)
+{
+    Book book;
+    LevelUpdateCollector collector;
+    DepthReplica replica;
+    runRandomWorkload(book, collector, seed, [&](int i) {
+        ASSERT_TRUE(replica.apply(collector.updates())) << "command " << i;
+        ASSERT_EQ(replica.fullDepthAsk(), book.fullDepthAsk()) << "command " << i;
+        ASSERT_EQ(replica.fullDepthBid(), book.fullDepthBid()) << "command " << i;
+    });
+}
+
+TEST(DepthReplicaTest, FollowsMapOrderbook) { followRandomWorkload<Orderbook>(17); }
+
+TEST(DepthReplicaTest, FollowsLadderOrderbook) { followRandomWorkload<LadderOrderbook>(17); }
+
+TEST(DepthReplicaTest, OneUpdatePerTouchedLevel)
+{
+    Orderbook book;
+    LevelUpdateCollector collector;
+    book.addOrder(10, 100, OrderType::GoodTillCancel, Side::Sell, collector);
+    book.addOrder(10, 101, OrderType::GoodTillCancel, Side::Sell, collector);
+    book.addOrder(10, 101, OrderType::GoodTillCancel, Side::Sell, collector);
+    collector.clear();
+
+    // Sweeps 100 and half of 101, the rest of the buy order rests
+    book.addOrder(40, 101, OrderType::GoodTillCancel, Side::Buy, collector);
+    const auto& updates = collector.updates();
+    ASSERT_EQ(updates.size(), 3);
+    EXPECT_EQ(updates[0].sequence, 4);
+    EXPECT_EQ(updates[0].side, Side::Sell);
+    EXPECT_EQ(updates[0].price, 100);
+    EXPECT_EQ(updates[0].orderCnt, 0);
+    EXPECT_EQ(updates[1].price, 101);
+    EXPECT_EQ(updates[1].orderCnt, 0);
+    EXPECT_EQ(updates[2].sequence, 6);
+    EXPECT_EQ(updates[2].side, Side::Buy);
+    EXPECT_EQ(updates[2].volume, 10);
+}
+
+TEST(DepthReplicaTest, GapIsRefused)
+{
+    DepthReplica replica;
+    EXPECT_TRUE(replica.apply(LevelUpdate{.sequence = 1, .price = 100, .volume = 5, .orderCnt = 1, .side = Side::Buy}));
+    EXPECT_FALSE(replica.apply(LevelUpdate{.sequence = 3, .price = 99, .volume = 5, .orderCnt = 1, .side = Side::Buy}));
+
+    EXPECT_EQ(replica.sequence(), 1);
+    ASSERT_EQ(replica.fullDepthBid().size(), 1);
+    EXPECT_EQ(replica.fullDepthBid()[0].price, 100);
+}
@@ -0,0 +1,70 @@
+#include "fenwick_tree.h"
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+#include <vector>
+
+TEST(FenwickTreeTest, EmptyTree)
+{
+    fenwick_tree<int64_t> tree;
+    EXPECT_EQ(tree.size(), 0);
+    EXPECT_EQ(tree.total(), 0);
+    EXPECT_EQ(tree.lower_bound(0), fenwick_tree<int64_t>::npos);
+    EXPECT_EQ(tree.lower_bound(1), fenwick_tree<int64_t>::npos);
+}
+
+TEST(FenwickTreeTest, AddAndPrefixSum)
+{
+    fenwick_tree<int64_t> tree{10};
+    tree.add(0, 5);
+    tree.add(3, 2);
+    tree.add(9, 7);
+
+    EXPECT_EQ(tree.prefix_sum(0), 5);
+    EXPECT_EQ(tree.prefix_sum(2), 5);
+    EXPECT_EQ(tree.prefix_sum(3), 7);
+    EXPECT_EQ(tree.prefix_sum(8), 7);
+    EXPECT_EQ(tree.total(), 14);
+
+    tree.add(3, -2);
+    EXPECT_EQ(tree.prefix_sum(3), 5);
+}
+
+TEST(FenwickTreeTest, LowerBound)
+{
+    fenwick_tree<int64_t> tree{std::vector<int64_t>{0, 4, 0, 0, 3, 1}};
+
+    EXPECT_EQ(tree.lower_bound(1), 1);
+    EXPECT_EQ(tree.lower_bound(4), 1);
+    EXPECT_EQ(tree.lower_bound(5), 4);
+    EXPECT_EQ(tree.lower_bound(7), 4);
+    EXPECT_EQ(tree.lower_bound(8), 5);
+    EXPECT_EQ(tree.lower_bound(9), fenwick_tree<int64_t>::npos);
+}
+
+TEST(FenwickTreeTest, MatchesNaiveSums)
+{
+    constexpr size_t size = 1000;
+    std::vector<int64_t> values(size, 0);
+    std::mt19937_64 rng{5};
+    for (auto& value : values)
+        value = rng() % 10;
+
+    fenwick_tree<int64_t> tree{values};
+    for (int i = 0; i < 10'000; ++i) {
+        size_t idx = rng() % size;
+        int64_t delta = static_cast<int64_t>(rng() % 10);
+        tree.add(idx, delta);
+        values[idx] += delta;
+
+        size_t probe = rng() % size;
+        ASSERT_EQ(tree.prefix_sum(probe), std::accumulate(values.begin(), values.begin() + probe + 1, int64_t{0}));
+    }
+
+    std::vector<int64_t> prefix(size);
+    std::partial_sum(values.begin(), values.end(), prefix.begin());
+    for (int64_t target = 1; target <= prefix.back(); target += 37) {
+        size_t expected = std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin();
+        ASSERT_EQ(tree.lower_bound(target), expected);
+    }
+}
@@ -0,0 +1,109 @@
+#include "hierarchical_bitmap.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+class HierarchicalBitmapTest : public testing::Test
+{
+public:
+    // Three layers: 64^2 < size <= 64^3
+    size_t size = 64 * 64 * 3 + 5;
+    hierarchical_bitmap bitmap{size};
+};
+
+TEST_F(HierarchicalBitmapTest, NewBitmapIsEmpty)
+{
+    EXPECT_EQ(bitmap.size(), size);
+    EXPECT_TRUE(bitmap.none());
+    EXPECT_EQ(bitmap.find_first(), hierarchical_bitmap::npos);
+    EXPECT_EQ(bitmap.find_last(), hierarchical_bitmap::npos);
+    EXPECT_EQ(bitmap.find_next(0), hierarchical_bitmap::npos);
+    EXPECT_EQ(bitmap.find_prev(size - 1), hierarchical_bitmap::npos);
+}
+
+TEST_F(HierarchicalBitmapTest, SetAndReset)
+{
+    bitmap.set(4097);
+    EXPECT_TRUE(bitmap.test(4097));
+    EXPECT_FALSE(bitmap.test(4096));
+    EXPECT_FALSE(bitmap.none());
+
+    bitmap.reset(4097);
+    EXPECT_FALSE(bitmap.test(4097));
+    EXPECT_TRUE(bitmap.none());
+}
+
+TEST_F(HierarchicalBitmapTest, FirstAndLast)
+{
+    bitmap.set(70);
+    bitmap.set(9000);
+    bitmap.set(size - 1);
+
+    EXPECT_EQ(bitmap.find_first(), 70);
+    EXPECT_EQ(bitmap.find_last(), size - 1);
+
+    bitmap.reset(70);
+    bitmap.reset(size - 1);
+    EXPECT_EQ(bitmap.find_first(), 9000);
+    EXPECT_EQ(bitmap.find_last(), 9000);
+}
+
+TEST_F(HierarchicalBitmapTest, NextAndPrevCrossWordsAndLayers)
+{
+    bitmap.set(3);
+    bitmap.set(64 * 64 + 1);
+    bitmap.set(64 * 64 * 2 + 63);
+
+    EXPECT_EQ(bitmap.find_next(0), 3);
+    EXPECT_EQ(bitmap.find_next(3), 3);
+    EXPECT_EQ(bitmap.find_next(4), 64 * 64 + 1);
+    EXPECT_EQ(bitmap.find_next(64 * 64 + 2), 64 * 64 * 2 + 63);
+    EXPECT_EQ(bitmap.find_next(64 * 64 * 2 + 64), hierarchical_bitmap::npos);
+    EXPECT_EQ(bitmap.find_next(size), hierarchical_bitmap::npos);
+
+    EXPECT_EQ(bitmap.find_prev(size), 64 * 64 * 2 + 63);
+    EXPECT_EQ(bitmap.find_prev(64 * 64 * 2 + 62), 64 * 64 + 1);
+    EXPECT_EQ(bitmap.find_prev(64 * 64), 3);
+    EXPECT_EQ(bitmap.find_prev(2), hierarchical_bitmap::npos);
+}
+
+TEST_F(HierarchicalBitmapTest, SmallBitmapHasOneLayer)
+{
+    hierarchical_bitmap small{10};
+    small.set(9);
+    small.set(0);
+
+    EXPECT_EQ(small.find_first(), 0);
+    EXPECT_EQ(small.find_last(), 9);
+    EXPECT_EQ(small.find_next(1), 9);
+    EXPECT_EQ(small.find_prev(8), 0);
+}
+
+TEST_F(HierarchicalBitmapTest, MatchesStdSetOnRandomOperations)
+{
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<size_t> idx(0, size - 1);
+    std::set<size_t> expected;
+
+    for (int i = 0; i < 20000; ++i) {
+        size_t bit = idx(rng);
+        if (rng() % 3 == 0) {
+            bitmap.reset(bit);
+            expected.erase(bit);
+        } else {
+            bitmap.set(bit);
+            expected.insert(bit);
+        }
+
+        size_t probe = idx(rng);
+        auto next = expected.lower_bound(probe);
+        ASSERT_EQ(bitmap.find_next(probe), next == expected.end() ? hierarchical_bitmap::npos : *next);
+
+        auto prev = expected.upper_bound(probe);
+        ASSERT_EQ(bitmap.find_prev(probe),
+                  prev == expected.begin() ? hierarchical_bitmap::npos : *std::prev(prev));
+    }
+
+    EXPECT_EQ(bitmap.find_first(), *expected.begin());
+    EXPECT_EQ(bitmap.find_last(), *expected.rbegin());
+}
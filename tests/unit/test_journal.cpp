@@ -0,0 +1,157 @@
+#include "journal.h"
+#include "orderbook.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+static std::filesystem::path journalPath(const std::string& name)
+{
+    auto path = std::filesystem::temp_directory_path() / ("orderbook_test_" + name + ".journal");
+    std::filesystem::remove(path);
+    return path;
+}
+
+static Command add(quantity_t quantity, price_t price, OrderType type, Side side, microsec_t expiry = microsec_t{0})
+{
+    Command command;
+    command.action = Actions::ADD;
+    command.quantity = quantity;
+    command.price = price;
+    command.type = type;
+    command.side = side;
+    command.expiry = expiry;
+    return command;
+}
+
+static Command cancel(orderId_t orderId)
+{
+    Command command;
+    command.action = Actions::CANCEL;
+    command.oid = orderId;
+    return command;
+}
+
+// Adds of every type, cancels, amends, expiry runs and call auctions, some of them refused
+static void journalRandomWorkload(ManualClockOrderbook& book, Journal& journal)
+{
+    JournaledBook journaled{book, journal};
+    EventSink sink;
+    std::mt19937 rng{31};
+    std::vector<orderId_t> ids;
+
+    for (int i = 0; i < 5000; ++i) {
+        book.clock().set(microsec_t{1000 + i});
+        if (i % 1000 == 400)
+            journaled.startAuction();
+        else if (i % 1000 == 600)
+            journaled.uncross(sink);
+        uint32_t r = rng() % 100;
+        Side side = rng() % 2 == 0 ? Side::Buy : Side::Sell;
+        quantity_t quantity = 1 + rng() % 50;
+        price_t price = side == Side::Buy ? 9950 + static_cast<price_t>(rng() % 60)
+                                          : 9990 + static_cast<price_t>(rng() % 60);
+
+        if (r < 50 || ids.empty()) {
+            OrderType type = r % 5 == 0 ? OrderType::FillAndKill : OrderType::GoodTillCancel;
+            if (r % 7 == 0)
+                type = OrderType::GoodTillDate;
+            Command command = add(quantity, price, type, side, microsec_t{1000 + i + 50});
+            if (r % 11 == 0) {
+                command.type = r % 2 == 0 ? OrderType::Stop : OrderType::StopLimit;
+                command.trigger = side == Side::Buy ? price + 20 : price - 20;
+            } else if (r % 13 == 0 && type != OrderType::FillAndKill) {
+                command.peak = 1 + quantity / 3;
+            }
+            auto status = journaled.apply(command, sink);
+            if (status.accepted())
+                ids.push_back(status.orderId);
+        } else if (r < 70) {
+            journaled.apply(cancel(ids[rng() % ids.size()]), sink);
+        } else if (r < 90) {
+            Command modify = cancel(ids[rng() % ids.size()]);
+            modify.action = Actions::MODIFY;
+            if (r % 2 == 0)
+                modify.quantity = quantity;
+            else
+                modify.price = price;
+            auto status = journaled.apply(modify, sink);
+            if (status.accepted())
+                ids.push_back(status.orderId);
+        } else if (r < 95) {
+            // Refused before the book is touched, not journaled
+            journaled.apply(add(0, price, OrderType::GoodTillCancel, side), sink);
+        } else {
+            journaled.expireOrders(sink);
+        }
+    }
+}
+
+TEST(JournalTest, ReplayRebuildsTheJournaledBook)
+{
+    auto path = journalPath("replay");
+    ManualClockOrderbook original;
+    uint64_t lastSequence = 0;
+    {
+        Journal journal{path};
+        journalRandomWorkload(original, journal);
+        lastSequence = journal.lastSequence();
+        EXPECT_TRUE(journal.waitDurable(lastSequence));
+    }
+
+    JournalReader reader{path};
+    ASSERT_TRUE(reader.ok());
+    ASSERT_EQ(reader.entries().size(), lastSequence);
+
+    ManualClockOrderbook restored;
+    EventSink sink;
+    auto replay = replayJournal(reader.entries(), restored, sink);
+    EXPECT_TRUE(replay.consistent);
+    EXPECT_EQ(replay.applied, lastSequence);
+    EXPECT_EQ(restored.fullDepthAsk(), original.fullDepthAsk());
+    EXPECT_EQ(restored.fullDepthBid(), original.fullDepthBid());
+    EXPECT_EQ(std::get<0>(restored.addOrder(1, 1, OrderType::GoodTillCancel, Side::Buy)),
+              std::get<0>(original.addOrder(1, 1, OrderType::GoodTillCancel, Side::Buy)));
+
+    // The journal does not continue the state of a book that already has orders
+    EXPECT_FALSE(replayJournal(reader.entries(), restored, sink).consistent);
+    std::filesystem::remove(path);
+}
+
+TEST(JournalTest, TornTailIsIgnored)
+{
+    auto path = journalPath("torn");
+    {
+        Journal journal{path};
+        for (int i = 0; i < 10; ++i)
+            journal.append(JournalEntry::from(JournalOp::Expire, Command{}, 0, microsec_t{i}));
+    }
+    EXPECT_EQ(JournalReader{path}.entries().size(), 10);
+
+    // Half of the last entry made it to disk
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - sizeof(JournalEntry) / 2);
+    EXPECT_EQ(JournalReader{path}.entries().size(), 9);
+
+    // A damaged entry ends the journal
+    {
+        std::fstream file{path, std::ios::in | std::ios::out | std::ios::binary};
+        file.seekp(sizeof(JournalHeader) + 4 * sizeof(JournalEntry) + offsetof(JournalEntry, price));
+        file.put('x');
+    }
+    JournalReader reader{path};
+    EXPECT_TRUE(reader.ok());
+    EXPECT_EQ(reader.entries().size(), 4);
+    std::filesystem::remove(path);
+}
+
+TEST(JournalTest, ExistingFileIsNotOverwritten)
+{
+    auto path = journalPath("existing");
+    std::ofstream{path} << "previous session";
+    EXPECT_THROW(Journal{path}, std::system_error);
+    EXPECT_FALSE(JournalReader{path}.ok());
+    std::filesystem::remove(path);
+}
@@ -2,7 +2,6 @@
 #include "types.h"
 #include "usings.h"
 #include <gtest/gtest.h>
-#include <stdexcept>
 
 constexpr microsec_t NOW = microsec_t{67};
 
@@ -17,10 +16,14 @@ protected:
     Order order = Order(orderid, quantity, price, type, side, NOW);
 };
 
-TEST_F(OrderTest, ConstructorInvalidQuantity)
+TEST_F(OrderTest, Validate)
 {
-    EXPECT_NO_THROW(Order(orderid, quantity, price, type, side, NOW));
-    EXPECT_THROW(Order(orderid, 0, price, type, side, NOW), std::invalid_argument);
+    EXPECT_EQ(Order::validate(quantity, price, type, side), RejectReason::None);
+    EXPECT_EQ(Order::validate(0, price, type, side), RejectReason::BadQuantity);
+    EXPECT_EQ(Order::validate(badValues::quantity, price, type, side), RejectReason::BadQuantity);
+    EXPECT_EQ(Order::validate(quantity, badValues::price, type, side), RejectReason::BadPrice);
+    EXPECT_EQ(Order::validate(quantity, price, OrderType::Bad, side), RejectReason::BadType);
+    EXPECT_EQ(Order::validate(quantity, price, type, Side::Bad), RejectReason::BadSide);
 }
 
 TEST_F(OrderTest, Constructor)
@@ -41,16 +44,6 @@ TEST_F(OrderTest, InitialState)
     EXPECT_EQ(order.getRemainingQuantity(), order.getInitialQuantity());
 }
 
-TEST_F(OrderTest, BadFillCall)
-{
-    EXPECT_THROW(order.fill(quantity + 1), std::invalid_argument);
-
-    // Check if throw was before anything was changed
-    EXPECT_EQ(order.getRemainingQuantity(), quantity);
-    EXPECT_EQ(order.getFilled(), 0);
-    EXPECT_FALSE(order.isFullyFilled());
-}
-
 TEST_F(OrderTest, FillFull)
 {
     order.fill(quantity);
@@ -101,3 +94,28 @@ TEST_F(OrderTest, MultipleFillsFull)
     EXPECT_EQ(order.getFilled(), quantity);
     EXPECT_TRUE(order.isFullyFilled());
 }
+
+TEST_F(OrderTest, IcebergShowsOneClipAtATime)
+{
+    Order iceberg{orderid, quantity, price, type, side, NOW, microsec_t{0}, 30};
+    iceberg.fill(20);
+    iceberg.hideReserve();
+    EXPECT_EQ(iceberg.getRemainingQuantity(), 30);
+    EXPECT_EQ(iceberg.getHiddenQuantity(), 50);
+    EXPECT_EQ(iceberg.getFilled(), 20);
+
+    iceberg.fill(30);
+    EXPECT_TRUE(iceberg.isFullyFilled());
+    EXPECT_EQ(iceberg.refresh(), 30);
+    EXPECT_EQ(iceberg.getHiddenQuantity(), 20);
+
+    // Reductions take the hidden quantity first
+    iceberg.reduceRemaining(35);
+    EXPECT_EQ(iceberg.getRemainingQuantity(), 30);
+    EXPECT_EQ(iceberg.getHiddenQuantity(), 5);
+    iceberg.reduceRemaining(10);
+    EXPECT_EQ(iceberg.getRemainingQuantity(), 10);
+    EXPECT_EQ(iceberg.getHiddenQuantity(), 0);
+    EXPECT_EQ(iceberg.getFilled(), 50);
+    EXPECT_EQ(iceberg.getInitialQuantity(), 60);
+}
@@ -0,0 +1,116 @@
+#include "orderIndex.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <unordered_map>
+
+class OrderIndexTest : public testing::Test
+{
+protected:
+    OrderIndex index;
+};
+
+TEST_F(OrderIndexTest, InitialState)
+{
+    EXPECT_EQ(index.size(), 0);
+    EXPECT_FALSE(index.contains(0));
+    EXPECT_EQ(index.find(12345), badValues::orderHandle);
+}
+
+TEST_F(OrderIndexTest, InsertFindErase)
+{
+    index.insert(2, 7);
+    index.insert(3, 8);
+
+    EXPECT_EQ(index.size(), 2);
+    EXPECT_EQ(index.find(2), 7);
+    EXPECT_EQ(index.find(3), 8);
+    EXPECT_FALSE(index.contains(4));
+
+    index.erase(2);
+    EXPECT_EQ(index.size(), 1);
+    EXPECT_FALSE(index.contains(2));
+    EXPECT_EQ(index.find(3), 8);
+
+    // Erasing twice or erasing unknown ids is a no-op
+    index.erase(2);
+    index.erase(1'000'000);
+    EXPECT_EQ(index.size(), 1);
+}
+
+TEST_F(OrderIndexTest, InsertOverwritesHandle)
+{
+    index.insert(5, 1);
+    index.insert(5, 2);
+
+    EXPECT_EQ(index.size(), 1);
+    EXPECT_EQ(index.find(5), 2);
+}
+
+TEST_F(OrderIndexTest, StaleIdsAreRejectedAfterPageRecycling)
+{
+    // Fill the first page, empty it, then move on to later pages
+    for (orderId_t id = 0; id < OrderIndex::pageSize; ++id)
+        index.insert(id, static_cast<orderHandle_t>(id));
+    for (orderId_t id = 0; id < OrderIndex::pageSize; ++id)
+        index.erase(id);
+
+    orderId_t later = 5 * OrderIndex::pageSize + 17;
+    index.insert(later, 99);
+    index.insert(later + OrderIndex::pageSize, 100);
+
+    // Same slot inside the page as `later`, but an old id
+    EXPECT_FALSE(index.contains(17));
+    EXPECT_FALSE(index.contains(later - OrderIndex::pageSize));
+    EXPECT_EQ(index.find(later), 99);
+    EXPECT_EQ(index.find(later + OrderIndex::pageSize), 100);
+    EXPECT_EQ(index.size(), 2);
+}
+
+TEST_F(OrderIndexTest, EmptiedPagesMoveToTheFreeBytes)
+{
+    for (orderId_t id = 0; id < 3 * OrderIndex::pageSize; ++id)
+        index.insert(id, static_cast<orderHandle_t>(id));
+    MemoryStats::Usage full = index.memoryUse();
+    EXPECT_EQ(full.bytes, full.peak);
+    EXPECT_EQ(index.freeBytes(), 0);
+
+    // The two pages behind the newest one are recycled, the peak stays
+    for (orderId_t id = 0; id < 2 * OrderIndex::pageSize; ++id)
+        index.erase(id);
+    MemoryStats::Usage emptied = index.memoryUse();
+    EXPECT_EQ(emptied.peak, full.peak);
+    size_t recycled = full.bytes - emptied.bytes;
+    EXPECT_GE(recycled, 2 * OrderIndex::pageSize * sizeof(orderHandle_t));
+    EXPECT_GE(index.freeBytes(), recycled);
+
+    // A new page reuses a free one
+    size_t freeBytes = index.freeBytes();
+    index.insert(3 * OrderIndex::pageSize, 1);
+    EXPECT_LT(index.freeBytes(), freeBytes);
+    EXPECT_EQ(index.memoryUse().peak, full.peak);
+}
+
+TEST_F(OrderIndexTest, MatchesUnorderedMapOnRandomWorkload)
+{
+    std::unordered_map<orderId_t, orderHandle_t> expected;
+    std::mt19937_64 rng{3};
+    orderId_t nextId = 1;
+
+    for (int i = 0; i < 100'000; ++i) {
+        if (rng() % 3 != 0 || expected.empty()) {
+            orderHandle_t handle = static_cast<orderHandle_t>(rng() % 1'000'000);
+            index.insert(nextId, handle);
+            expected[nextId] = handle;
+            nextId++;
+        } else {
+            orderId_t victim = 1 + rng() % (nextId - 1);
+            index.erase(victim);
+            expected.erase(victim);
+        }
+
+        orderId_t probe = 1 + rng() % nextId;
+        auto it = expected.find(probe);
+        ASSERT_EQ(index.find(probe), it == expected.end() ? badValues::orderHandle : it->second);
+    }
+    EXPECT_EQ(index.size(), expected.size());
+}
@@ -0,0 +1,151 @@
+#include "orderPool.h"
+#include "types.h"
+#include "usings.h"
+#include <gtest/gtest.h>
+#include <utility>
+#include <vector>
+
+constexpr microsec_t POOL_NOW = microsec_t{67};
+
+class OrderPoolTest : public testing::Test
+{
+protected:
+    OrderPool pool;
+
+    orderHandle_t acquire(orderId_t orderId)
+    {
+        return pool.acquire(orderId, 10u, 100, OrderType::GoodTillCancel, Side::Buy, POOL_NOW);
+    }
+
+    std::vector<orderId_t> queueIds(const OrderQueue& queue) const
+    {
+        std::vector<orderId_t> ids;
+        for (auto handle = queue.head; handle != badValues::orderHandle; handle = pool.next(handle))
+            ids.push_back(pool[handle].getOrderId());
+        return ids;
+    }
+};
+
+TEST_F(OrderPoolTest, InitialState)
+{
+    EXPECT_EQ(pool.size(), 0);
+    EXPECT_EQ(pool.capacity(), 0);
+
+    OrderPool reserved{OrderPool::pageSize + 1};
+    EXPECT_EQ(reserved.size(), 0);
+    EXPECT_EQ(reserved.capacity(), 2 * OrderPool::pageSize);
+}
+
+TEST_F(OrderPoolTest, AcquireConstructsOrder)
+{
+    auto handle = acquire(5);
+
+    EXPECT_EQ(pool.size(), 1);
+    EXPECT_EQ(pool[handle].getOrderId(), 5);
+    EXPECT_EQ(pool[handle].getRemainingQuantity(), 10);
+    EXPECT_EQ(pool[handle].getPrice(), 100);
+    EXPECT_EQ(pool.next(handle), badValues::orderHandle);
+}
+
+TEST_F(OrderPoolTest, ReleasedNodeIsRecycled)
+{
+    auto first = acquire(1);
+    auto second = acquire(2);
+    pool.release(first);
+    EXPECT_EQ(pool.size(), 1);
+
+    auto third = acquire(3);
+    EXPECT_EQ(third, first);
+    EXPECT_EQ(pool[third].getOrderId(), 3);
+    EXPECT_EQ(pool[second].getOrderId(), 2);
+    EXPECT_EQ(pool.capacity(), OrderPool::pageSize);
+}
+
+TEST_F(OrderPoolTest, GrowsAcrossPagesWithoutMovingOrders)
+{
+    std::vector<orderHandle_t> handles;
+    for (orderId_t id = 0; id < 3 * OrderPool::pageSize; ++id)
+        handles.push_back(acquire(id));
+    OrderRef firstOrder = pool[handles.front()];
+
+    for (orderId_t id = 0; id < handles.size(); ++id)
+        EXPECT_EQ(pool[handles[id]].getOrderId(), id);
+    // A view taken before the pool grew still refers to the live order
+    EXPECT_EQ(&firstOrder.hot(), &pool[handles.front()].hot());
+    EXPECT_EQ(&firstOrder.cold(), &pool[handles.front()].cold());
+    EXPECT_EQ(pool.capacity(), 3 * OrderPool::pageSize);
+}
+
+TEST_F(OrderPoolTest, PagesComeFromTheArenaThenTheHeap)
+{
+    PageArena arena{OrderPool::bytesFor(OrderPool::pageSize), PageBacking::Small};
+    OrderPool arenaPool{0, &arena};
+    std::vector<orderHandle_t> handles;
+    for (orderId_t id = 0; id < 2 * OrderPool::pageSize; ++id)
+        handles.push_back(arenaPool.acquire(id, 10u, 100, OrderType::GoodTillCancel, Side::Buy, POOL_NOW));
+
+    // The arena is rounded up to 2MB, so it holds more than the one page asked for
+    size_t arenaPages = arena.capacity() / OrderPool::bytesFor(1);
+    ASSERT_GE(arenaPages, 1);
+    EXPECT_TRUE(arena.owns(&arenaPool[handles.front()].hot()));
+    EXPECT_EQ(arena.owns(&arenaPool[handles.back()].hot()), arenaPages >= 2);
+    for (orderId_t id = 0; id < handles.size(); ++id)
+        EXPECT_EQ(arenaPool[handles[id]].getOrderId(), id);
+}
+
+TEST_F(OrderPoolTest, ViewChangesTheStoredOrder)
+{
+    auto handle = pool.acquire(Order{7, 100u, 250, OrderType::GoodTillCancel, Side::Sell, POOL_NOW, microsec_t{0}, 30});
+    OrderRef order = pool[handle];
+    order.fill(40);
+    order.hideReserve();
+
+    ConstOrderRef stored = std::as_const(pool)[handle];
+    EXPECT_EQ(stored.getOrderId(), 7);
+    EXPECT_EQ(stored.getRemainingQuantity(), 30);
+    EXPECT_EQ(stored.getHiddenQuantity(), 30);
+    EXPECT_EQ(stored.getFilled(), 40);
+    EXPECT_EQ(stored.getPrice(), 250);
+    EXPECT_EQ(stored.getSide(), Side::Sell);
+    EXPECT_EQ(stored.getOpenTime(), POOL_NOW);
+}
+
+TEST_F(OrderPoolTest, QueueKeepsFIFOOrder)
+{
+    OrderQueue queue;
+    EXPECT_TRUE(queue.empty());
+
+    for (orderId_t id = 1; id <= 4; ++id)
+        pool.pushBack(queue, acquire(id));
+
+    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ(queueIds(queue), (std::vector<orderId_t>{1, 2, 3, 4}));
+}
+
+TEST_F(OrderPoolTest, UnlinkHeadMiddleAndTail)
+{
+    OrderQueue queue;
+    std::vector<orderHandle_t> handles;
+    for (orderId_t id = 1; id <= 5; ++id) {
+        handles.push_back(acquire(id));
+        pool.pushBack(queue, handles.back());
+    }
+
+    pool.unlink(queue, handles[2]);
+    EXPECT_EQ(queueIds(queue), (std::vector<orderId_t>{1, 2, 4, 5}));
+    pool.unlink(queue, handles[0]);
+    EXPECT_EQ(queueIds(queue), (std::vector<orderId_t>{2, 4, 5}));
+    pool.unlink(queue, handles[4]);
+    EXPECT_EQ(queueIds(queue), (std::vector<orderId_t>{2, 4}));
+    EXPECT_EQ(queue.tail, handles[3]);
+
+    pool.unlink(queue, handles[1]);
+    pool.unlink(queue, handles[3]);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.tail, badValues::orderHandle);
+
+    // Unlinked orders can be queued again, at the back
+    pool.pushBack(queue, handles[0]);
+    pool.pushBack(queue, handles[3]);
+    EXPECT_EQ(queueIds(queue), (std::vector<orderId_t>{1, 4}));
+}
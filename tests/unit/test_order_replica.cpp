@@ -0,0 +1,110 @@
+#include "orderReplica.h"
+#include "orderbook.h"
+#include "random_workload.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+template <typename Book>
+static void followRandomWorkload(uint32_t seed)
+{
+    Book book;
+    OrderEventCollector collector;
+    OrderReplica replica;
+    runRandomWorkload(book, collector, seed, [&](int i) {
+        ASSERT_TRUE(replica.apply(collector.events())) << "command " << i;
+        ASSERT_EQ(replica.fullDepthAsk(), book.fullDepthAsk()) << "command " << i;
+        ASSERT_EQ(replica.fullDepthBid(), book.fullDepthBid()) << "command " << i;
+    });
+}
+
+TEST(OrderReplicaTest, FollowsMapOrderbook) { followRandomWorkload<Orderbook>(23); }
+
+TEST(OrderReplicaTest, FollowsLadderOrderbook) { followRandomWorkload<LadderOrderbook>(23); }
+
+TEST(OrderReplicaTest, KeepsQueuePositions)
+{
+    Orderbook book;
+    OrderEventCollector collector{64};
+    OrderReplica replica;
+    orderId_t first = book.addOrder(10, 100, OrderType::GoodTillCancel, Side::Sell, collector).orderId;
+    orderId_t iceberg =
+        book.addIcebergOrder(30, 10, 100, OrderType::GoodTillCancel, Side::Sell, microsec_t{0}, collector).orderId;
+    orderId_t last = book.addOrder(10, 100, OrderType::GoodTillCancel, Side::Sell, collector).orderId;
+    ASSERT_EQ(collector.events().size(), 3);
+    EXPECT_EQ(collector.events()[1].queuePosition, 1);
+    EXPECT_EQ(collector.events()[1].quantity, 10);
+
+    // Amending down keeps the place in the queue
+    book.modifyOrder(first, ModifyOrder{.quantity = 4}, collector);
+    ASSERT_TRUE(replica.apply(collector.events()));
+    EXPECT_EQ(replica.queue(Side::Sell, 100), (std::vector<orderId_t>{first, iceberg, last}));
+    EXPECT_EQ(replica.quantity(first), 4);
+
+    // Takes the first order and the clip of the iceberg, which shows its next clip at the back
+    collector.clear();
+    book.addOrder(14, 100, OrderType::FillAndKill, Side::Buy, collector);
+    const auto& events = collector.events();
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_EQ(events[0].type, OrderEventType::Filled);
+    EXPECT_EQ(events[0].orderId, first);
+    EXPECT_EQ(events[1].type, OrderEventType::Filled);
+    EXPECT_EQ(events[1].orderId, iceberg);
+    EXPECT_EQ(events[2].type, OrderEventType::Added);
+    EXPECT_EQ(events[2].orderId, iceberg);
+    EXPECT_EQ(events[2].queuePosition, 1);
+    EXPECT_EQ(events[2].sequence, 7);
+    ASSERT_TRUE(replica.apply(events));
+    EXPECT_EQ(replica.queue(Side::Sell, 100), (std::vector<orderId_t>{last, iceberg}));
+
+    collector.clear();
+    book.addOrder(3, 100, OrderType::FillAndKill, Side::Buy, collector);
+    ASSERT_EQ(collector.events().size(), 1);
+    EXPECT_EQ(collector.events()[0].type, OrderEventType::Executed);
+    EXPECT_EQ(collector.events()[0].quantity, 3);
+    ASSERT_TRUE(replica.apply(collector.events()));
+    EXPECT_EQ(replica.quantity(last), 7);
+
+    collector.clear();
+    book.cancelOrder(last, collector);
+    ASSERT_TRUE(replica.apply(collector.events()));
+    EXPECT_EQ(replica.quantity(last), std::nullopt);
+    EXPECT_EQ(replica.queue(Side::Sell, 100), (std::vector<orderId_t>{iceberg}));
+    EXPECT_EQ(replica.fullDepthAsk(), book.fullDepthAsk());
+}
+
+TEST(OrderReplicaTest, RefusesEventsThatDoNotFit)
+{
+    OrderReplica replica;
+    OrderEvent add{.sequence = 1,
+                   .orderId = 5,
+                   .price = 100,
+                   .quantity = 10,
+                   .queuePosition = 0,
+                   .type = OrderEventType::Added,
+                   .side = Side::Buy};
+    EXPECT_TRUE(replica.apply(add));
+
+    // Out of sequence
+    OrderEvent gap = add;
+    gap.sequence = 3;
+    gap.orderId = 6;
+    EXPECT_FALSE(replica.apply(gap));
+    // Not at the back of the level
+    OrderEvent ahead = add;
+    ahead.sequence = 2;
+    ahead.orderId = 6;
+    EXPECT_FALSE(replica.apply(ahead));
+    // Unknown order
+    OrderEvent cancel{.sequence = 2,
+                      .orderId = 7,
+                      .price = 100,
+                      .quantity = 10,
+                      .queuePosition = 0,
+                      .type = OrderEventType::Cancelled,
+                      .side = Side::Buy};
+    EXPECT_FALSE(replica.apply(cancel));
+
+    EXPECT_EQ(replica.sequence(), 1);
+    EXPECT_EQ(replica.size(), 1);
+    EXPECT_EQ(replica.queue(Side::Buy, 100), (std::vector<orderId_t>{5}));
+}
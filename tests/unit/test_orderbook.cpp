@@ -1,10 +1,11 @@
 #include "orderbook.h"
 #include "types.h"
 #include "usings.h"
+#include <array>
 #include <gtest/gtest.h>
 #include <numeric>
 #include <random>
-#include <stdexcept>
+#include <span>
 
 struct SideState {
     uint32_t orderCnt{0};
@@ -126,6 +127,130 @@ class MarketOrderbookTest : public OrderbookTest
 {
 };
 
+class FillOrKillOrderbookTest : public OrderbookTest
+{
+};
+
+class DepthQueryOrderbookTest : public OrderbookTest
+{
+protected:
+    // Same queries answered by walking fullDepth
+    uint64_t expectedVolume(Side side, price_t limitPrice) const
+    {
+        uint64_t volume = 0;
+        for (const auto& level : side == Side::Buy ? orderbook.fullDepthAsk() : orderbook.fullDepthBid())
+            if (side == Side::Buy ? level.price <= limitPrice : level.price >= limitPrice)
+                volume += level.volume;
+        return volume;
+    }
+    std::optional<notional_t> expectedCost(Side side, uint64_t quantity) const
+    {
+        notional_t cost = 0;
+        for (const auto& level : side == Side::Buy ? orderbook.fullDepthAsk() : orderbook.fullDepthBid()) {
+            uint64_t take = std::min<uint64_t>(quantity, level.volume);
+            cost += static_cast<notional_t>(take) * level.price;
+            quantity -= take;
+        }
+        return quantity > 0 ? std::nullopt : std::optional<notional_t>{cost};
+    }
+    // `top` holds the first min(n, full.size()) levels of `full`
+    void expectTopOf(std::span<const LevelView> top, const levels_t& full, size_t n) const
+    {
+        ASSERT_EQ(top.size(), std::min(n, full.size()));
+        for (size_t i = 0; i < top.size(); ++i) {
+            LevelState expected{.price = full[i].price, .volume = full[i].volume, .orderCnt = full[i].orderCnt};
+            EXPECT_EQ(expected, top[i]);
+        }
+    }
+};
+
+// Records every event the book sends through the listener API
+struct RecordingSink : EventSink {
+    std::vector<orderId_t> accepted;
+    std::vector<Trade> trades;
+    std::vector<std::pair<orderId_t, quantity_t>> cancelled;
+    std::vector<std::pair<orderId_t, RejectReason>> rejected;
+    std::vector<orderId_t> triggered;
+    std::vector<std::pair<orderId_t, quantity_t>> refreshed;
+
+    void onAccept(orderId_t orderId, const OrderInfo&) { accepted.push_back(orderId); }
+    void onTrigger(orderId_t orderId, const OrderInfo&) { triggered.push_back(orderId); }
+    void onRefresh(orderId_t orderId, quantity_t clip) { refreshed.emplace_back(orderId, clip); }
+    void onTrade(const Trade& trade) { trades.push_back(trade); }
+    void onCancel(orderId_t orderId, quantity_t remaining) { cancelled.emplace_back(orderId, remaining); }
+    void onReject(orderId_t orderId, RejectReason reason) { rejected.emplace_back(orderId, reason); }
+};
+
+class EventsOrderbookTest : public OrderbookTest
+{
+protected:
+    RecordingSink sink;
+};
+
+class StopOrderbookTest : public OrderbookTest
+{
+protected:
+    RecordingSink sink;
+
+    orderId_t addStop(quantity_t quantity, price_t trigger, price_t price, OrderType type, Side side)
+    {
+        auto status = orderbook.addStopOrder(quantity, trigger, price, type, side, sink);
+        EXPECT_TRUE(status.accepted());
+        return status.orderId;
+    }
+};
+
+class IcebergOrderbookTest : public OrderbookTest
+{
+protected:
+    RecordingSink sink;
+
+    orderId_t addIceberg(quantity_t quantity, quantity_t peak, price_t price, Side side)
+    {
+        auto status =
+            orderbook.addIcebergOrder(quantity, peak, price, OrderType::GoodTillCancel, side, microsec_t{0}, sink);
+        EXPECT_TRUE(status.accepted());
+        return status.orderId;
+    }
+};
+
+class AuctionOrderbookTest : public OrderbookTest
+{
+protected:
+    RecordingSink sink;
+
+    orderId_t addLimit(quantity_t quantity, price_t price, Side side)
+    {
+        auto status = orderbook.addOrder(quantity, price, OrderType::GoodTillCancel, side, sink);
+        EXPECT_TRUE(status.accepted());
+        return status.orderId;
+    }
+};
+
+class ExpiryOrderbookTest : public testing::Test
+{
+protected:
+    ManualClockOrderbook orderbook;
+    RecordingSink sink;
+
+    void SetUp() override { orderbook.clock().set(microsec_t{1'000}); }
+
+    orderId_t addGoodTillDate(quantity_t quantity, price_t price, Side side, int64_t expiry)
+    {
+        auto status = orderbook.addOrder(quantity, price, OrderType::GoodTillDate, side, microsec_t{expiry}, sink);
+        EXPECT_TRUE(status.accepted());
+        return status.orderId;
+    }
+
+    void expectBidLevels(const std::vector<LevelState>& expected) const
+    {
+        levels_t levels = orderbook.fullDepthBid();
+        ASSERT_EQ(levels.size(), expected.size());
+        for (size_t i = 0; i < levels.size(); ++i)
+            EXPECT_EQ(expected[i], levels[i]);
+    }
+};
+
 // PASSIVE ORDERS
 TEST_F(PassiveOrderbookTest, InitialState)
 {
@@ -187,10 +312,9 @@ TEST_F(PassiveOrderbookTest, FIFOOnTheSameLevel)
         orderbook.addOrder(quantity, price, OrderType::Market, Side::Sell);
     validateInfo(info, price, quantity, Side::Sell, OrderType::Market);
 
-    // Order1 and the opposite one should not exist anymore so they will throw
-    // on cancelation
-    EXPECT_THROW(orderbook.cancelOrder(orderId1), std::out_of_range);
-    EXPECT_THROW(orderbook.cancelOrder(oppositeOrderId), std::out_of_range);
+    // Order1 and the opposite one should not exist anymore so cancelling them is rejected
+    EXPECT_EQ(orderbook.cancelOrder(orderId1), RejectReason::UnknownOrder);
+    EXPECT_EQ(orderbook.cancelOrder(oppositeOrderId), RejectReason::UnknownOrder);
 
     ASSERT_EQ(oppositeOrderTrades.size(), 1);
     Trade& trade = oppositeOrderTrades[0];
@@ -318,7 +442,7 @@ TEST_F(PassiveOrderbookTest, CancelNonExistentOrder)
 {
     ASSERT_TRUE(orderbook.fullDepthAsk().empty());
     ASSERT_TRUE(orderbook.fullDepthBid().empty());
-    EXPECT_THROW(orderbook.cancelOrder(100), std::out_of_range);
+    EXPECT_EQ(orderbook.cancelOrder(100), RejectReason::UnknownOrder);
 }
 
 TEST_F(PassiveOrderbookTest, CancelOrderWhichIsNotTheLastAtLevel)
@@ -428,6 +552,45 @@ TEST_F(PassiveOrderbookTest, ModifyQuantityDown)
     EXPECT_EQ(bidDepth[0], expLevel);
 }
 
+TEST_F(PassiveOrderbookTest, ModifyQuantityDownKeepsIdAndPriority)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+
+    auto orderId1 = addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Buy);
+    auto orderId2 = addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Buy);
+
+    auto [amendedId, amendTrades, amendInfo] = orderbook.modifyOrder(orderId1, ModifyOrder{.quantity = q / 2});
+    EXPECT_EQ(amendedId, orderId1);
+    EXPECT_TRUE(amendTrades.empty());
+    validateInfo(amendInfo, price, q / 2, Side::Buy, OrderType::GoodTillCancel);
+
+    // The amended order is still first in the queue
+    auto [sellId, trades, info] = orderbook.addOrder(q, price, OrderType::Market, Side::Sell);
+    ASSERT_EQ(trades.size(), 2);
+    EXPECT_EQ((TradeState{.seller = sellId, .buyer = orderId1, .quantity = q / 2}), trades[0]);
+    EXPECT_EQ((TradeState{.seller = sellId, .buyer = orderId2, .quantity = q - q / 2}), trades[1]);
+
+    BookState expectedBookState{.bid{.orderCnt = 1, .volume = q / 2, .depth = 1, .bestPrice = price}};
+    assertBookState(expectedBookState);
+}
+
+TEST_F(PassiveOrderbookTest, ModifyQuantityUpLosesPriority)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+
+    auto orderId1 = addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Buy);
+    auto orderId2 = addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Buy);
+
+    auto [newOrderId, newTrades, newInfo] = orderbook.modifyOrder(orderId1, ModifyOrder{.quantity = q * 2});
+    EXPECT_NE(newOrderId, orderId1);
+
+    auto [sellId, trades, info] = orderbook.addOrder(q, price, OrderType::Market, Side::Sell);
+    ASSERT_EQ(trades.size(), 1);
+    EXPECT_EQ((TradeState{.seller = sellId, .buyer = orderId2, .quantity = q}), trades[0]);
+}
+
 TEST_F(PassiveOrderbookTest, ModifyPriceMovesToDifferentLevel)
 {
     price_t before = defaultPrice;
@@ -554,6 +717,295 @@ TEST_F(PassiveOrderbookTest, LimitOrderPartialFillRestStaysOnBook) {}
 TEST_F(PassiveOrderbookTest, LimitOrderSweepsAllLiquidityFullFill) {}
 TEST_F(PassiveOrderbookTest, LimitOrderSweepsAllLiquidityPartialFillRestStays) {}
 
+// FILL OR KILL ORDERS
+TEST_F(FillOrKillOrderbookTest, FullFillAcrossLevels)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+    auto orderId1 = addRestingOrder(q / 2, price, OrderType::GoodTillCancel, Side::Sell);
+    auto orderId2 = addRestingOrder(q - q / 2, price + 1, OrderType::GoodTillCancel, Side::Sell);
+    addRestingOrder(q, price - 1, OrderType::GoodTillCancel, Side::Buy);
+
+    auto [orderId, trades, info] = orderbook.addOrder(q, price + 1, OrderType::FillOrKill, Side::Buy);
+    validateInfo(info, price + 1, q, Side::Buy, OrderType::FillOrKill);
+    ASSERT_EQ(trades.size(), 2);
+    EXPECT_EQ((TradeState{.seller = orderId1, .buyer = orderId, .quantity = q / 2}), trades[0]);
+    EXPECT_EQ((TradeState{.seller = orderId2, .buyer = orderId, .quantity = q - q / 2}), trades[1]);
+
+    BookState expectedBookState{
+        .bid{.orderCnt = 1, .volume = q, .depth = 1, .bestPrice = price - 1},
+    };
+    assertBookState(expectedBookState);
+}
+
+TEST_F(FillOrKillOrderbookTest, RejectedWhenLiquidityWithinLimitIsTooSmall)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+    addRestingOrder(q / 2, price, OrderType::GoodTillCancel, Side::Buy);
+    addRestingOrder(q, price - 1, OrderType::GoodTillCancel, Side::Buy);
+
+    // Only the level at `price` is within the limit
+    auto [orderId, trades, info] = orderbook.addOrder(q, price, OrderType::FillOrKill, Side::Sell);
+    EXPECT_EQ(orderId, 0);
+    EXPECT_TRUE(trades.empty());
+
+    BookState expectedBookState{
+        .bid{.orderCnt = 2, .volume = q / 2 + q, .depth = 2, .bestPrice = price},
+    };
+    assertBookState(expectedBookState);
+}
+
+TEST_F(FillOrKillOrderbookTest, OwnSideVolumeIsNotCounted)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+    addRestingOrder(q * 10, price - 1, OrderType::GoodTillCancel, Side::Buy);
+    addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Sell);
+
+    auto [orderId, trades, info] = orderbook.addOrder(q + 1, price, OrderType::FillOrKill, Side::Buy);
+    EXPECT_EQ(orderId, 0);
+    EXPECT_TRUE(trades.empty());
+}
+
+// DEPTH QUERIES
+TEST_F(DepthQueryOrderbookTest, EmptyBook)
+{
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, defaultPrice), 0);
+    EXPECT_EQ(orderbook.availableVolume(Side::Sell, defaultPrice), 0);
+    EXPECT_EQ(orderbook.costToFill(Side::Buy, 1), std::nullopt);
+    EXPECT_EQ(orderbook.costToFill(Side::Sell, 0), 0);
+}
+
+TEST_F(DepthQueryOrderbookTest, VolumeAndCostAcrossLevels)
+{
+    price_t price = defaultPrice;
+    addRestingOrder(10, price, OrderType::GoodTillCancel, Side::Sell);
+    addRestingOrder(5, price + 2, OrderType::GoodTillCancel, Side::Sell);
+    addRestingOrder(7, price - 1, OrderType::GoodTillCancel, Side::Buy);
+    addRestingOrder(3, price - 3, OrderType::GoodTillCancel, Side::Buy);
+
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, price - 1), 0);
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, price + 1), 10);
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, price + 100), 15);
+    EXPECT_EQ(orderbook.availableVolume(Side::Sell, price), 0);
+    EXPECT_EQ(orderbook.availableVolume(Side::Sell, price - 3), 10);
+
+    EXPECT_EQ(orderbook.costToFill(Side::Buy, 12), 10 * price + 2 * (price + 2));
+    EXPECT_EQ(orderbook.costToFill(Side::Buy, 16), std::nullopt);
+    EXPECT_EQ(orderbook.costToFill(Side::Sell, 8), 7 * (price - 1) + (price - 3));
+
+    // Fills and cancels are reflected as well
+    orderbook.addOrder(4, price, OrderType::Market, Side::Buy);
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, price), 6);
+    orderbook.cancelOrder(addRestingOrder(1, price - 2, OrderType::GoodTillCancel, Side::Buy));
+    EXPECT_EQ(orderbook.availableVolume(Side::Sell, price - 2), 7);
+}
+
+TEST_F(DepthQueryOrderbookTest, LevelsOutsideOfTheIndexWindow)
+{
+    // Farther apart than DepthIndex::maxWindow, answered by walking the levels
+    price_t far = defaultPrice + static_cast<price_t>(DepthIndex::maxWindow) * 2;
+    addRestingOrder(10, defaultPrice, OrderType::GoodTillCancel, Side::Sell);
+    auto farId = addRestingOrder(5, far, OrderType::GoodTillCancel, Side::Sell);
+
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, far), 15);
+    EXPECT_EQ(orderbook.costToFill(Side::Buy, 11), 10 * static_cast<notional_t>(defaultPrice) + far);
+
+    // Back to the index once the far level is gone
+    orderbook.cancelOrder(farId);
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, far), 10);
+    EXPECT_EQ(orderbook.costToFill(Side::Buy, 10), 10 * defaultPrice);
+}
+
+TEST_F(DepthQueryOrderbookTest, MatchesFullDepthOnRandomFlow)
+{
+    std::mt19937 rng{11};
+    std::vector<orderId_t> ids;
+    for (int i = 0; i < 5'000; ++i) {
+        Side side = rng() % 2 ? Side::Buy : Side::Sell;
+        if (rng() % 4 == 0 && !ids.empty()) {
+            orderbook.cancelOrder(ids[rng() % ids.size()]);
+        } else {
+            price_t price = defaultPrice + static_cast<price_t>(rng() % 200) - 100;
+            auto [orderId, trades, info] = orderbook.addOrder(1 + rng() % 20, price, OrderType::GoodTillCancel, side);
+            ids.push_back(orderId);
+        }
+
+        price_t probe = defaultPrice + static_cast<price_t>(rng() % 240) - 120;
+        uint64_t quantity = rng() % 300;
+        ASSERT_EQ(orderbook.availableVolume(side, probe), expectedVolume(side, probe));
+        ASSERT_EQ(orderbook.costToFill(side, quantity), expectedCost(side, quantity));
+    }
+}
+
+TEST_F(DepthQueryOrderbookTest, TopDepthStopsAfterN)
+{
+    for (price_t price = 90; price < 110; ++price) {
+        Side side = price < 100 ? Side::Buy : Side::Sell;
+        addRestingOrder(defaultQuantity + price, price, OrderType::GoodTillCancel, side);
+    }
+
+    std::array<LevelView, 8> out{};
+    size_t written = orderbook.topDepth(Side::Buy, 5, out);
+    expectTopOf(std::span{out.data(), written}, orderbook.fullDepthBid(), 5);
+    // The buffer bounds the result as well
+    written = orderbook.topDepth(Side::Sell, 50, out);
+    expectTopOf(std::span{out.data(), written}, orderbook.fullDepthAsk(), 8);
+    EXPECT_EQ(orderbook.topDepth(Side::Sell, 0, out), 0);
+
+    Orderbook empty;
+    EXPECT_EQ(empty.topDepth(Side::Buy, 5, out), 0);
+}
+
+TEST_F(DepthQueryOrderbookTest, CachedTopDepthFollowsBook)
+{
+    std::mt19937 rng{13};
+    std::vector<orderId_t> ids;
+    for (int i = 0; i < 5'000; ++i) {
+        Side side = rng() % 2 ? Side::Buy : Side::Sell;
+        if (rng() % 3 == 0 && !ids.empty()) {
+            orderbook.cancelOrder(ids[rng() % ids.size()]);
+        } else if (rng() % 10 == 0) {
+            orderbook.addOrder(1 + rng() % 40, defaultPrice, OrderType::Market, side);
+        } else {
+            price_t price = side == Side::Buy ? defaultPrice - 1 - static_cast<price_t>(rng() % 30)
+                                              : defaultPrice + 1 + static_cast<price_t>(rng() % 30);
+            auto [orderId, trades, info] = orderbook.addOrder(1 + rng() % 20, price, OrderType::GoodTillCancel, side);
+            ids.push_back(orderId);
+        }
+
+        expectTopOf(orderbook.cachedTopDepth(Side::Buy), orderbook.fullDepthBid(), Orderbook::cachedLevels);
+        expectTopOf(orderbook.cachedTopDepth(Side::Sell), orderbook.fullDepthAsk(), Orderbook::cachedLevels);
+        if (HasFailure())
+            return;
+    }
+}
+
+// LISTENER EVENTS
+TEST_F(EventsOrderbookTest, RestingOrderIsAcceptedWithoutTrades)
+{
+    auto orderId =
+        orderbook.addOrder(defaultQuantity, defaultPrice, OrderType::GoodTillCancel, Side::Buy, sink).orderId;
+
+    EXPECT_EQ(sink.accepted, (std::vector<orderId_t>{orderId}));
+    EXPECT_TRUE(sink.trades.empty());
+    EXPECT_TRUE(sink.cancelled.empty());
+    EXPECT_TRUE(sink.rejected.empty());
+}
+
+TEST_F(EventsOrderbookTest, TradesAndKilledRestAreReported)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+    auto restingId = addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Sell);
+
+    auto orderId = orderbook.addOrder(q * 3, price, OrderType::FillAndKill, Side::Buy, sink).orderId;
+    ASSERT_EQ(sink.trades.size(), 1);
+    EXPECT_EQ((TradeState{.seller = restingId, .buyer = orderId, .quantity = q}), sink.trades[0]);
+    ASSERT_EQ(sink.cancelled.size(), 1);
+    EXPECT_EQ(sink.cancelled[0], std::make_pair(orderId, q * 2));
+    EXPECT_TRUE(orderbook.fullDepthAsk().empty());
+}
+
+TEST_F(EventsOrderbookTest, RejectsAreReported)
+{
+    auto fak = orderbook.addOrder(defaultQuantity, defaultPrice, OrderType::FillAndKill, Side::Buy, sink);
+    EXPECT_FALSE(fak.accepted());
+    EXPECT_EQ(fak.reason, RejectReason::NotCrossing);
+    EXPECT_EQ(orderbook.cancelOrder(12345, sink), RejectReason::UnknownOrder);
+    EXPECT_EQ(orderbook.modifyOrder(12345, ModifyOrder{.quantity = 1}, sink).reason, RejectReason::UnknownOrder);
+
+    EXPECT_TRUE(sink.accepted.empty());
+    ASSERT_EQ(sink.rejected.size(), 3);
+    EXPECT_EQ(sink.rejected[0], std::make_pair(fak.orderId, RejectReason::NotCrossing));
+    EXPECT_EQ(sink.rejected[1], std::make_pair(orderId_t{12345}, RejectReason::UnknownOrder));
+    EXPECT_EQ(sink.rejected[2], std::make_pair(orderId_t{12345}, RejectReason::UnknownOrder));
+}
+
+TEST_F(EventsOrderbookTest, InvalidOrdersAreRejectedWithoutThrowing)
+{
+    price_t price = defaultPrice;
+    quantity_t q = defaultQuantity;
+    EXPECT_EQ(orderbook.addOrder(0, price, OrderType::GoodTillCancel, Side::Buy, sink).reason,
+              RejectReason::BadQuantity);
+    EXPECT_EQ(orderbook.addOrder(q, badValues::price, OrderType::GoodTillCancel, Side::Buy, sink).reason,
+              RejectReason::BadPrice);
+    EXPECT_EQ(orderbook.addOrder(q, price, OrderType::Bad, Side::Buy, sink).reason, RejectReason::BadType);
+    EXPECT_EQ(orderbook.addOrder(q, price, OrderType::GoodTillCancel, Side::Bad, sink).reason, RejectReason::BadSide);
+    EXPECT_TRUE(sink.accepted.empty());
+    ASSERT_EQ(sink.rejected.size(), 4);
+    EXPECT_EQ(sink.rejected[0], std::make_pair(orderId_t{0}, RejectReason::BadQuantity));
+
+    // An invalid modification leaves the order untouched
+    auto orderId = addRestingOrder(q, price, OrderType::GoodTillCancel, Side::Buy);
+    auto status = orderbook.modifyOrder(orderId, ModifyOrder{.quantity = 0}, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadQuantity);
+    EXPECT_TRUE(sink.cancelled.empty());
+
+    BookState expectedBookState{.bid{.orderCnt = 1, .volume = q, .depth = 1, .bestPrice = price}};
+    assertBookState(expectedBookState);
+}
+
+TEST_F(EventsOrderbookTest, CancelReportsRemainingQuantity)
+{
+    auto orderId = addRestingOrder(defaultQuantity, defaultPrice, OrderType::GoodTillCancel, Side::Buy);
+    orderbook.addOrder(3, defaultPrice, OrderType::Market, Side::Sell, sink);
+    orderbook.cancelOrder(orderId, sink);
+
+    ASSERT_EQ(sink.cancelled.size(), 1);
+    EXPECT_EQ(sink.cancelled[0], std::make_pair(orderId, defaultQuantity - 3));
+}
+
+TEST_F(EventsOrderbookTest, ProcessMatchesSingleCalls)
+{
+    std::mt19937 rng{21};
+    std::vector<Command> commands;
+    for (int i = 0; i < 2'000; ++i) {
+        orderId_t someId = 2 + rng() % (i + 1);
+        switch (rng() % 4) {
+        case 0:
+            commands.push_back(Command{.action = Actions::CANCEL, .oid = someId});
+            break;
+        case 1:
+            commands.push_back(Command{
+                .action = Actions::MODIFY, .oid = someId, .quantity = 1 + static_cast<quantity_t>(rng() % 20)});
+            break;
+        default:
+            commands.push_back(Command{.action = Actions::ADD,
+                                       .type = rng() % 5 ? OrderType::GoodTillCancel : OrderType::Market,
+                                       .quantity = 1 + static_cast<quantity_t>(rng() % 20),
+                                       .price = defaultPrice + static_cast<price_t>(rng() % 20) - 10,
+                                       .side = rng() % 2 ? Side::Buy : Side::Sell});
+        }
+    }
+
+    RecordingSink batchSink;
+    Orderbook batchBook;
+    batchBook.process(commands, batchSink);
+
+    for (const auto& command : commands) {
+        if (command.action == Actions::ADD)
+            orderbook.addOrder(command.quantity, command.price, command.type, command.side, sink);
+        else if (command.action == Actions::CANCEL)
+            orderbook.cancelOrder(command.oid, sink);
+        else
+            orderbook.modifyOrder(command.oid, command.modifications(), sink);
+    }
+
+    EXPECT_EQ(batchSink.accepted, sink.accepted);
+    EXPECT_EQ(batchSink.cancelled, sink.cancelled);
+    EXPECT_EQ(batchSink.rejected, sink.rejected);
+    ASSERT_EQ(batchSink.trades.size(), sink.trades.size());
+    for (size_t i = 0; i < sink.trades.size(); ++i)
+        EXPECT_EQ((TradeState{.seller = sink.trades[i].seller,
+                              .buyer = sink.trades[i].buyer,
+                              .quantity = sink.trades[i].quantity}),
+                  batchSink.trades[i]);
+    EXPECT_EQ(batchBook.fullDepthBid().size(), orderbook.fullDepthBid().size());
+    EXPECT_EQ(batchBook.fullDepthAsk().size(), orderbook.fullDepthAsk().size());
+}
+
 // MARKET ORDERS
 TEST_F(MarketOrderbookTest, NoLiquidity) {}
 TEST_F(MarketOrderbookTest, FullFillSingleLevel) {}
@@ -563,3 +1015,480 @@ TEST_F(MarketOrderbookTest, PartialFillMultipleLevels) {}
 TEST_F(MarketOrderbookTest, SweepAllBookFullFill) {}
 TEST_F(MarketOrderbookTest, SweepAllBookPartialFill) {}
 TEST_F(MarketOrderbookTest, FIFOFirstFilled) {}
+
+// EXPIRY
+TEST_F(ExpiryOrderbookTest, GoodTillDateExpiresAtItsTime)
+{
+    auto first = addGoodTillDate(10, 99, Side::Buy, 2'000);
+    auto second = addGoodTillDate(5, 101, Side::Sell, 500'000);
+    orderbook.addOrder(7, 99, OrderType::GoodTillCancel, Side::Buy, sink);
+
+    orderbook.clock().set(microsec_t{1'999});
+    orderbook.expireOrders(sink);
+    EXPECT_TRUE(sink.cancelled.empty());
+
+    orderbook.clock().set(microsec_t{2'000});
+    orderbook.expireOrders(sink);
+    ASSERT_EQ(sink.cancelled.size(), 1);
+    EXPECT_EQ(sink.cancelled[0], std::make_pair(first, quantity_t{10}));
+    expectBidLevels({{.price = 99, .volume = 7, .orderCnt = 1}});
+    EXPECT_EQ(orderbook.availableVolume(Side::Sell, 99), 7);
+
+    orderbook.clock().set(microsec_t{10'000'000});
+    orderbook.expireOrders(sink);
+    ASSERT_EQ(sink.cancelled.size(), 2);
+    EXPECT_EQ(sink.cancelled[1], std::make_pair(second, quantity_t{5}));
+    EXPECT_FALSE(orderbook.bestAsk().has_value());
+}
+
+TEST_F(ExpiryOrderbookTest, GoodTillDateNeedsFutureExpiry)
+{
+    auto status = orderbook.addOrder(10, 99, OrderType::GoodTillDate, Side::Buy, microsec_t{1'000}, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadExpiry);
+
+    // Turning a GTC order into a GTD one has no expiry to keep
+    auto orderId = orderbook.addOrder(10, 99, OrderType::GoodTillCancel, Side::Buy, sink).orderId;
+    status = orderbook.modifyOrder(orderId, ModifyOrder{.type = OrderType::GoodTillDate}, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadExpiry);
+    expectBidLevels({{.price = 99, .volume = 10, .orderCnt = 1}});
+}
+
+TEST_F(ExpiryOrderbookTest, FilledCancelledAndReplacedOrdersDoNotExpireTwice)
+{
+    addGoodTillDate(10, 99, Side::Buy, 2'000);
+    auto cancelled = addGoodTillDate(10, 98, Side::Buy, 2'000);
+    auto replaced = addGoodTillDate(10, 97, Side::Buy, 2'000);
+    auto partial = addGoodTillDate(10, 96, Side::Buy, 2'000);
+
+    orderbook.addOrder(10, 99, OrderType::Market, Side::Sell, sink);
+    orderbook.cancelOrder(cancelled, sink);
+    auto replacement = orderbook.modifyOrder(replaced, ModifyOrder{.price = 95}, sink).orderId;
+    orderbook.addOrder(4, 96, OrderType::FillAndKill, Side::Sell, sink);
+    sink.cancelled.clear();
+
+    orderbook.clock().set(microsec_t{2'000});
+    orderbook.expireOrders(sink);
+    EXPECT_EQ(sink.cancelled, (std::vector<std::pair<orderId_t, quantity_t>>{{replacement, 10}, {partial, 6}}));
+    EXPECT_TRUE(orderbook.fullDepthBid().empty());
+}
+
+TEST_F(ExpiryOrderbookTest, CloseSessionPurgesEndOfDayOrders)
+{
+    std::vector<orderId_t> eod;
+    for (int i = 0; i < 6; ++i)
+        eod.push_back(orderbook.addOrder(10, i % 2 == 0 ? 99 : 98, OrderType::GoodTillEOD, Side::Buy, sink).orderId);
+    auto gtc = orderbook.addOrder(10, 99, OrderType::GoodTillCancel, Side::Buy, sink).orderId;
+    auto ask = orderbook.addOrder(10, 101, OrderType::GoodTillEOD, Side::Sell, sink).orderId;
+    orderbook.cancelOrder(eod[2], sink);
+    sink.cancelled.clear();
+
+    orderbook.closeSession(sink);
+    std::vector<std::pair<orderId_t, quantity_t>> expected{
+        {eod[1], 10}, {eod[3], 10}, {eod[5], 10}, {eod[0], 10}, {eod[4], 10}, {ask, 10}};
+    EXPECT_EQ(sink.cancelled, expected);
+    expectBidLevels({{.price = 99, .volume = 10, .orderCnt = 1}});
+    EXPECT_FALSE(orderbook.bestAsk().has_value());
+    EXPECT_EQ(orderbook.costToFill(Side::Sell, 10), 990);
+
+    // The GTC order is still there and the next session starts empty
+    EXPECT_EQ(orderbook.cancelOrder(gtc, sink), RejectReason::None);
+    sink.cancelled.clear();
+    orderbook.closeSession(sink);
+    EXPECT_TRUE(sink.cancelled.empty());
+}
+
+// STOP ORDERS
+TEST_F(StopOrderbookTest, StopsWaitForTheirTrigger)
+{
+    for (price_t price : {101, 102, 103})
+        orderbook.addOrder(10, price, OrderType::GoodTillCancel, Side::Sell, sink);
+    orderbook.addOrder(10, 99, OrderType::GoodTillCancel, Side::Buy, sink);
+    auto stop = addStop(5, 102, 0, OrderType::Stop, Side::Buy);
+    auto stopLimit = addStop(5, 103, 103, OrderType::StopLimit, Side::Buy);
+    auto sellStop = addStop(5, 98, 98, OrderType::StopLimit, Side::Sell);
+    EXPECT_EQ(orderbook.pendingStops(), 3);
+    EXPECT_TRUE(sink.trades.empty());
+    EXPECT_EQ(orderbook.fullDepthAsk().size(), 3);
+
+    orderbook.addOrder(10, 101, OrderType::FillAndKill, Side::Buy, sink);
+    EXPECT_TRUE(sink.triggered.empty());
+
+    // The trade at 102 triggers the stop, whose trade at 103 triggers the stop limit
+    sink.trades.clear();
+    orderbook.addOrder(10, 102, OrderType::FillAndKill, Side::Buy, sink);
+    EXPECT_EQ(sink.triggered, (std::vector<orderId_t>{stop, stopLimit}));
+    ASSERT_EQ(sink.trades.size(), 3);
+    EXPECT_EQ(sink.trades[1].buyer, stop);
+    EXPECT_EQ(sink.trades[1].price, 103);
+    EXPECT_EQ(sink.trades[2].buyer, stopLimit);
+    EXPECT_FALSE(orderbook.bestAsk().has_value());
+    EXPECT_EQ(orderbook.pendingStops(), 1);
+
+    // A stop the last trade already reached is matched right away
+    orderbook.addOrder(10, 104, OrderType::GoodTillCancel, Side::Sell, sink);
+    auto late = addStop(2, 103, 0, OrderType::Stop, Side::Buy);
+    EXPECT_EQ(sink.triggered.back(), late);
+    EXPECT_EQ(orderbook.fullDepthAsk()[0].volume, 8);
+    EXPECT_EQ(orderbook.cancelOrder(sellStop, sink), RejectReason::None);
+}
+
+TEST_F(StopOrderbookTest, TriggeredStopsAreMatchedInTriggerOrder)
+{
+    for (price_t price = 101; price <= 106; ++price)
+        orderbook.addOrder(1, price, OrderType::GoodTillCancel, Side::Sell, sink);
+    // Stop limits far below the asks rest as bids once triggered
+    auto at105 = addStop(1, 105, 50, OrderType::StopLimit, Side::Buy);
+    auto first101 = addStop(1, 101, 50, OrderType::StopLimit, Side::Buy);
+    auto at103 = addStop(1, 103, 50, OrderType::StopLimit, Side::Buy);
+    auto second101 = addStop(1, 101, 50, OrderType::StopLimit, Side::Buy);
+    auto above = addStop(1, 107, 50, OrderType::StopLimit, Side::Buy);
+
+    orderbook.addOrder(6, 106, OrderType::FillAndKill, Side::Buy, sink);
+    EXPECT_EQ(sink.triggered, (std::vector<orderId_t>{first101, second101, at103, at105}));
+    levels_t bids = orderbook.fullDepthBid();
+    ASSERT_EQ(bids.size(), 1);
+    EXPECT_EQ(bids[0].orderCnt, 4);
+    EXPECT_EQ(orderbook.pendingStops(), 1);
+
+    sink.cancelled.clear();
+    EXPECT_EQ(orderbook.cancelOrder(above, sink), RejectReason::None);
+    EXPECT_EQ(sink.cancelled, (std::vector<std::pair<orderId_t, quantity_t>>{{above, 1}}));
+    EXPECT_EQ(orderbook.pendingStops(), 0);
+}
+
+TEST_F(StopOrderbookTest, InvalidStopsAreRejected)
+{
+    auto status = orderbook.addOrder(10, 100, OrderType::Stop, Side::Buy, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadTrigger);
+    status = orderbook.addStopOrder(10, badValues::price, 100, OrderType::StopLimit, Side::Buy, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadTrigger);
+    status = orderbook.addStopOrder(10, 100, 100, OrderType::GoodTillCancel, Side::Buy, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadType);
+    status = orderbook.addStopOrder(0, 100, 100, OrderType::Stop, Side::Buy, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadQuantity);
+
+    // Pending stops are only cancelled, resting orders do not turn into stops
+    auto stop = addStop(10, 110, 0, OrderType::Stop, Side::Buy);
+    EXPECT_EQ(orderbook.modifyOrder(stop, ModifyOrder{.quantity = 5}, sink).reason, RejectReason::UnknownOrder);
+    auto resting = orderbook.addOrder(10, 99, OrderType::GoodTillCancel, Side::Buy, sink).orderId;
+    status = orderbook.modifyOrder(resting, ModifyOrder{.type = OrderType::StopLimit}, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadTrigger);
+    EXPECT_EQ(orderbook.bestBid(), 99);
+    EXPECT_EQ(orderbook.pendingStops(), 1);
+}
+
+// ICEBERG ORDERS
+TEST_F(IcebergOrderbookTest, OnlyThePeakIsDisplayed)
+{
+    addIceberg(100, 10, 99, Side::Buy);
+    levels_t bids = orderbook.fullDepthBid();
+    ASSERT_EQ(bids.size(), 1);
+    EXPECT_EQ(bids[0].volume, 10);
+    EXPECT_EQ(orderbook.availableVolume(Side::Sell, 99), 10);
+
+    // An incoming iceberg is matched with all of its quantity before it hides the rest
+    orderbook.addOrder(5, 101, OrderType::GoodTillCancel, Side::Sell, sink);
+    orderbook.addOrder(5, 102, OrderType::GoodTillCancel, Side::Sell, sink);
+    auto aggressor = addIceberg(50, 10, 102, Side::Buy);
+    EXPECT_EQ(sink.trades.size(), 2);
+    bids = orderbook.fullDepthBid();
+    ASSERT_EQ(bids.size(), 2);
+    EXPECT_EQ(bids[0].price, 102);
+    EXPECT_EQ(bids[0].volume, 10);
+
+    sink.cancelled.clear();
+    EXPECT_EQ(orderbook.cancelOrder(aggressor, sink), RejectReason::None);
+    EXPECT_EQ(sink.cancelled, (std::vector<std::pair<orderId_t, quantity_t>>{{aggressor, 40}}));
+}
+
+TEST_F(IcebergOrderbookTest, RefreshedClipGoesToTheBackOfTheLevel)
+{
+    auto iceberg = addIceberg(30, 10, 99, Side::Buy);
+    auto plain = orderbook.addOrder(10, 99, OrderType::GoodTillCancel, Side::Buy, sink).orderId;
+
+    orderbook.addOrder(15, 99, OrderType::FillAndKill, Side::Sell, sink);
+    ASSERT_EQ(sink.trades.size(), 2);
+    EXPECT_EQ(sink.trades[0].buyer, iceberg);
+    EXPECT_EQ(sink.trades[0].quantity, 10);
+    EXPECT_EQ(sink.trades[1].buyer, plain);
+    EXPECT_EQ(sink.trades[1].quantity, 5);
+    EXPECT_EQ(sink.refreshed, (std::vector<std::pair<orderId_t, quantity_t>>{{iceberg, 10}}));
+    levels_t bids = orderbook.fullDepthBid();
+    ASSERT_EQ(bids.size(), 1);
+    EXPECT_EQ(bids[0].volume, 15);
+    EXPECT_EQ(bids[0].orderCnt, 2);
+
+    // One sweep takes the rest of the plain order and both remaining clips
+    sink.trades.clear();
+    orderbook.addOrder(30, 99, OrderType::FillAndKill, Side::Sell, sink);
+    ASSERT_EQ(sink.trades.size(), 3);
+    EXPECT_EQ(sink.trades[0].buyer, plain);
+    EXPECT_EQ(sink.trades[2].buyer, iceberg);
+    EXPECT_TRUE(orderbook.fullDepthBid().empty());
+    EXPECT_EQ(orderbook.cancelOrder(iceberg, sink), RejectReason::UnknownOrder);
+}
+
+TEST_F(IcebergOrderbookTest, FillOrKillCountsHiddenQuantity)
+{
+    auto iceberg = addIceberg(100, 5, 101, Side::Sell);
+    orderbook.addOrder(10, 102, OrderType::GoodTillCancel, Side::Sell, sink);
+    EXPECT_EQ(orderbook.availableVolume(Side::Buy, 102), 15);
+
+    // Filled by the clips the iceberg shows one after another
+    auto status = orderbook.addOrder(50, 101, OrderType::FillOrKill, Side::Buy, sink);
+    EXPECT_TRUE(status.accepted());
+    ASSERT_EQ(sink.trades.size(), 10);
+    EXPECT_EQ(sink.trades.back().seller, iceberg);
+    EXPECT_EQ(orderbook.fullDepthAsk()[0].volume, 5);
+
+    // 50 is left in the iceberg and 10 behind it, the limit decides what counts
+    sink.trades.clear();
+    status = orderbook.addOrder(55, 101, OrderType::FillOrKill, Side::Buy, sink);
+    EXPECT_EQ(status.reason, RejectReason::InsufficientLiquidity);
+    status = orderbook.addOrder(61, 102, OrderType::FillOrKill, Side::Buy, sink);
+    EXPECT_EQ(status.reason, RejectReason::InsufficientLiquidity);
+    EXPECT_TRUE(sink.trades.empty());
+    status = orderbook.addOrder(60, 102, OrderType::FillOrKill, Side::Buy, sink);
+    EXPECT_TRUE(status.accepted());
+    EXPECT_TRUE(orderbook.fullDepthAsk().empty());
+}
+
+TEST_F(IcebergOrderbookTest, ModifyChangesTheOpenQuantity)
+{
+    auto iceberg = addIceberg(50, 10, 99, Side::Buy);
+    auto plain = orderbook.addOrder(10, 99, OrderType::GoodTillCancel, Side::Buy, sink).orderId;
+
+    // Taken from the hidden quantity, the order keeps its place
+    EXPECT_EQ(orderbook.modifyOrder(iceberg, ModifyOrder{.quantity = 15}, sink).orderId, iceberg);
+    EXPECT_EQ(orderbook.fullDepthBid()[0].volume, 20);
+    orderbook.addOrder(10, 99, OrderType::FillAndKill, Side::Sell, sink);
+    EXPECT_EQ(sink.trades.back().buyer, iceberg);
+    EXPECT_EQ(sink.refreshed.back(), std::make_pair(iceberg, quantity_t{5}));
+
+    // A replaced iceberg keeps its peak
+    auto moved = orderbook.modifyOrder(iceberg, ModifyOrder{.price = 98, .quantity = 40}, sink).orderId;
+    levels_t bids = orderbook.fullDepthBid();
+    ASSERT_EQ(bids.size(), 2);
+    EXPECT_EQ(bids[1].price, 98);
+    EXPECT_EQ(bids[1].volume, 10);
+    EXPECT_EQ(orderbook.cancelOrder(plain, sink), RejectReason::None);
+    EXPECT_EQ(orderbook.cancelOrder(moved, sink), RejectReason::None);
+    EXPECT_EQ(sink.cancelled.back(), std::make_pair(moved, quantity_t{40}));
+
+    auto status = orderbook.addIcebergOrder(50, 10, 99, OrderType::FillAndKill, Side::Buy, microsec_t{0}, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadType);
+    status = orderbook.addIcebergOrder(50, 0, 99, OrderType::GoodTillCancel, Side::Buy, microsec_t{0}, sink);
+    EXPECT_EQ(status.reason, RejectReason::BadQuantity);
+}
+
+TEST_F(IcebergOrderbookTest, CommandsWithABadPeakAreRefused)
+{
+    std::array<Command, 2> commands{Command{.action = Actions::ADD,
+                                            .type = OrderType::GoodTillCancel,
+                                            .quantity = 50,
+                                            .price = 99,
+                                            .side = Side::Buy,
+                                            .peak = badValues::quantity},
+                                    Command{.action = Actions::ADD,
+                                            .type = OrderType::GoodTillCancel,
+                                            .quantity = 50,
+                                            .price = 99,
+                                            .side = Side::Buy,
+                                            .peak = 10}};
+    orderbook.process(commands, sink);
+    ASSERT_EQ(sink.rejected.size(), 1);
+    EXPECT_EQ(sink.rejected[0], std::make_pair(orderId_t{0}, RejectReason::BadQuantity));
+
+    auto bids = orderbook.fullDepthBid();
+    ASSERT_EQ(bids.size(), 1);
+    EXPECT_EQ(bids[0].volume, 10);
+    EXPECT_EQ(orderbook.addIcebergOrder(50, badValues::quantity, 99, OrderType::GoodTillCancel, Side::Buy,
+                                        microsec_t{0}, sink)
+                  .reason,
+              RejectReason::BadQuantity);
+}
+
+// CALL AUCTION
+TEST_F(AuctionOrderbookTest, OrdersRestWithoutMatching)
+{
+    orderbook.startAuction();
+    EXPECT_TRUE(orderbook.inAuction());
+    auto sell = addLimit(10, 100, Side::Sell);
+    auto buy = addLimit(10, 102, Side::Buy);
+    EXPECT_TRUE(sink.trades.empty());
+    EXPECT_EQ(orderbook.bestBid(), 102);
+    EXPECT_EQ(orderbook.bestAsk(), 100);
+
+    for (OrderType type : {OrderType::Market, OrderType::FillAndKill, OrderType::FillOrKill})
+        EXPECT_EQ(orderbook.addOrder(5, 102, type, Side::Buy, sink).reason, RejectReason::InAuction);
+    EXPECT_EQ(orderbook.addStopOrder(5, 90, 0, OrderType::Stop, Side::Sell, sink).reason, RejectReason::InAuction);
+    auto stopLimit = orderbook.addStopOrder(5, 90, 90, OrderType::StopLimit, Side::Sell, sink);
+    EXPECT_TRUE(stopLimit.accepted());
+    auto iceberg =
+        orderbook.addIcebergOrder(30, 5, 101, OrderType::GoodTillCancel, Side::Sell, microsec_t{0}, sink).orderId;
+    EXPECT_NE(iceberg, 0);
+    EXPECT_TRUE(sink.trades.empty());
+
+    // Modifies re-add without matching
+    auto moved = orderbook.modifyOrder(buy, ModifyOrder{.price = 103}, sink).orderId;
+    EXPECT_TRUE(sink.trades.empty());
+    EXPECT_EQ(orderbook.cancelOrder(sell, sink), RejectReason::None);
+    EXPECT_EQ(orderbook.bestAsk(), 101);
+
+    auto equilibrium = orderbook.uncross(sink);
+    ASSERT_TRUE(equilibrium.has_value());
+    // The hidden quantity of the iceberg is part of the equilibrium volume
+    EXPECT_EQ(equilibrium->price, 101);
+    EXPECT_EQ(equilibrium->volume, 10);
+    EXPECT_FALSE(orderbook.inAuction());
+    ASSERT_EQ(sink.trades.size(), 2);
+    for (const Trade& trade : sink.trades) {
+        EXPECT_EQ(trade.buyer, moved);
+        EXPECT_EQ(trade.seller, iceberg);
+        EXPECT_EQ(trade.quantity, 5);
+    }
+    EXPECT_EQ(sink.refreshed.back(), std::make_pair(iceberg, quantity_t{5}));
+    EXPECT_FALSE(orderbook.bestBid().has_value());
+    EXPECT_EQ(orderbook.bestAsk(), 101);
+    EXPECT_EQ(orderbook.cancelOrder(moved, sink), RejectReason::UnknownOrder);
+}
+
+TEST_F(AuctionOrderbookTest, UncrossTradesTheMostVolumeAtOnePrice)
+{
+    orderbook.startAuction();
+    auto ask99 = addLimit(10, 99, Side::Sell);
+    auto ask100 = addLimit(20, 100, Side::Sell);
+    addLimit(10, 102, Side::Sell);
+    auto bid103 = addLimit(15, 103, Side::Buy);
+    auto bid101 = addLimit(10, 101, Side::Buy);
+    auto bid100 = addLimit(20, 100, Side::Buy);
+
+    // Asks at or below / bids at or above: 99: 10/45, 100: 30/45, 101: 30/25, 102: 40/15, 103: 40/15
+    auto equilibrium = orderbook.equilibrium();
+    ASSERT_TRUE(equilibrium.has_value());
+    EXPECT_EQ(equilibrium->price, 100);
+    EXPECT_EQ(equilibrium->volume, 30);
+    EXPECT_EQ(equilibrium->imbalance, 15);
+
+    // Some volume outside of the depth index window, the levels are merged instead
+    auto far = addLimit(1, 5'000'000, Side::Sell);
+    auto merged = orderbook.equilibrium();
+    ASSERT_TRUE(merged.has_value());
+    EXPECT_EQ(merged->price, equilibrium->price);
+    EXPECT_EQ(merged->volume, equilibrium->volume);
+    EXPECT_EQ(merged->imbalance, equilibrium->imbalance);
+    EXPECT_EQ(orderbook.cancelOrder(far, sink), RejectReason::None);
+
+    // Bids from the highest, asks from the lowest price, all at the equilibrium
+    orderbook.uncross(sink);
+    std::vector<std::tuple<orderId_t, orderId_t, quantity_t>> expected{
+        {bid103, ask99, 10}, {bid103, ask100, 5}, {bid101, ask100, 10}, {bid100, ask100, 5}};
+    ASSERT_EQ(sink.trades.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(std::make_tuple(sink.trades[i].buyer, sink.trades[i].seller, sink.trades[i].quantity), expected[i]);
+        EXPECT_EQ(sink.trades[i].price, 100);
+    }
+    BookState expectedState{.ask = {.orderCnt = 1, .volume = 10, .depth = 1, .bestPrice = 102},
+                            .bid = {.orderCnt = 1, .volume = 15, .depth = 1, .bestPrice = 100}};
+    assertBookState(expectedState);
+    EXPECT_FALSE(orderbook.uncross(sink).has_value());
+}
+
+TEST_F(AuctionOrderbookTest, HiddenQuantityCountsOnBothSearchPaths)
+{
+    orderbook.startAuction();
+    addLimit(30, 102, Side::Buy);
+    addLimit(10, 100, Side::Buy);
+    auto iceberg =
+        orderbook.addIcebergOrder(40, 4, 99, OrderType::GoodTillCancel, Side::Sell, microsec_t{0}, sink).orderId;
+    auto cancelled =
+        orderbook.addIcebergOrder(20, 5, 101, OrderType::GoodTillCancel, Side::Sell, microsec_t{0}, sink).orderId;
+    EXPECT_EQ(orderbook.cancelOrder(cancelled, sink), RejectReason::None);
+    // Open 40 at 99 cut to 35, the hidden part goes first
+    EXPECT_TRUE(orderbook.modifyOrder(iceberg, ModifyOrder{.quantity = 35}, sink).accepted());
+
+    // Asks at or below / bids at or above: 99: 35/40, 100: 35/40, 102: 35/30
+    auto equilibrium = orderbook.equilibrium();
+    ASSERT_TRUE(equilibrium.has_value());
+    EXPECT_EQ(equilibrium->price, 99);
+    EXPECT_EQ(equilibrium->volume, 35);
+
+    auto far = addLimit(1, 5'000'000, Side::Sell);
+    auto merged = orderbook.equilibrium();
+    ASSERT_TRUE(merged.has_value());
+    EXPECT_EQ(merged->price, equilibrium->price);
+    EXPECT_EQ(merged->volume, equilibrium->volume);
+    EXPECT_EQ(merged->imbalance, equilibrium->imbalance);
+    EXPECT_EQ(orderbook.cancelOrder(far, sink), RejectReason::None);
+
+    orderbook.uncross(sink);
+    EXPECT_FALSE(orderbook.bestAsk().has_value());
+    EXPECT_EQ(orderbook.bestBid(), 100);
+}
+
+TEST_F(AuctionOrderbookTest, TiesGoToTheSmallestImbalanceThenTheLastTrade)
+{
+    // 100 and 101 both trade 10, 100 leaves nothing over
+    orderbook.startAuction();
+    addLimit(10, 100, Side::Sell);
+    addLimit(5, 101, Side::Sell);
+    addLimit(10, 101, Side::Buy);
+    auto equilibrium = orderbook.equilibrium();
+    ASSERT_TRUE(equilibrium.has_value());
+    EXPECT_EQ(equilibrium->price, 100);
+    EXPECT_EQ(equilibrium->imbalance, 0);
+    orderbook.uncross(sink);
+    EXPECT_EQ(orderbook.bestAsk(), 101);
+
+    // Same volume and imbalance at 101 and 103, the one closest to the last trade (100) wins
+    orderbook.startAuction();
+    addLimit(10, 103, Side::Buy);
+    equilibrium = orderbook.equilibrium();
+    ASSERT_TRUE(equilibrium.has_value());
+    EXPECT_EQ(equilibrium->price, 101);
+    EXPECT_EQ(equilibrium->volume, 5);
+    EXPECT_EQ(equilibrium->imbalance, 5);
+    orderbook.uncross(sink);
+    EXPECT_EQ(sink.trades.back().price, 101);
+    EXPECT_FALSE(orderbook.bestAsk().has_value());
+}
+
+// MEMORY STATS
+template <typename Book>
+static void checkMemoryFollowsTheBook()
+{
+    Book book;
+    EventSink sink;
+    std::vector<orderId_t> ids;
+    for (int i = 0; i < 10'000; ++i) {
+        Side side = i % 2 == 0 ? Side::Buy : Side::Sell;
+        price_t price = side == Side::Buy ? 9000 + i % 500 : 11000 + i % 500;
+        ids.push_back(book.addOrder(10, price, OrderType::GoodTillCancel, side, sink).orderId);
+    }
+    MemoryStats full = book.memoryStats();
+    EXPECT_EQ(book.restingOrders(), 10'000);
+    EXPECT_GE(full.orders.bytes, 10'000 * sizeof(OrderHot));
+    EXPECT_EQ(full.orders.peak, full.orders.bytes);
+    EXPECT_GT(full.levels.bytes, 0);
+    EXPECT_GT(full.index.bytes, 0);
+    EXPECT_EQ(full.total(), full.levels.bytes + full.orders.bytes + full.index.bytes + full.freePools + full.other);
+
+    for (orderId_t id : ids)
+        book.cancelOrder(id, sink);
+    MemoryStats empty = book.memoryStats();
+    EXPECT_EQ(book.restingOrders(), 0);
+    EXPECT_EQ(empty.orders.bytes, 0);
+    EXPECT_EQ(empty.orders.peak, full.orders.peak);
+    EXPECT_EQ(empty.levels.peak, full.levels.peak);
+    EXPECT_EQ(empty.index.peak, full.index.peak);
+    EXPECT_LT(empty.index.bytes, full.index.bytes);
+    // Nothing is handed back, the freed nodes are kept for the next orders
+    EXPECT_GE(empty.freePools, full.orders.bytes);
+
+    book.addOrder(10, 9000, OrderType::GoodTillCancel, Side::Buy, sink);
+    EXPECT_EQ(book.memoryStats().orders.bytes, full.orders.bytes / 10'000);
+}
+
+TEST(MemoryStatsTest, MapOrderbook) { checkMemoryFollowsTheBook<Orderbook>(); }
+
+TEST(MemoryStatsTest, LadderOrderbook) { checkMemoryFollowsTheBook<LadderOrderbook>(); }
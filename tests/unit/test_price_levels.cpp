@@ -0,0 +1,168 @@
+#include "orderbook.h"
+#include "priceLevels.h"
+#include "types.h"
+#include "usings.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+template <typename SideLevels>
+std::vector<price_t> levelPrices(const SideLevels& levels)
+{
+    std::vector<price_t> prices;
+    levels.forEach([&](price_t price, const PriceLevel&) {
+        prices.push_back(price);
+        return true;
+    });
+    return prices;
+}
+
+TEST(TickLevelsTest, AsksAreVisitedFromLowestPrice)
+{
+    TickLevels<Side::Sell> asks;
+    asks[105];
+    asks[101];
+    asks[103];
+
+    EXPECT_EQ(asks.size(), 3);
+    EXPECT_EQ(asks.bestPrice(), 101);
+    EXPECT_EQ(levelPrices(asks), (std::vector<price_t>{101, 103, 105}));
+}
+
+TEST(TickLevelsTest, BidsAreVisitedFromHighestPrice)
+{
+    TickLevels<Side::Buy> bids;
+    bids[99];
+    bids[97];
+    bids[98];
+
+    EXPECT_EQ(bids.bestPrice(), 99);
+    EXPECT_EQ(levelPrices(bids), (std::vector<price_t>{99, 98, 97}));
+}
+
+TEST(TickLevelsTest, FindAndErase)
+{
+    TickLevels<Side::Sell> asks;
+    EXPECT_EQ(asks.find(100), nullptr);
+
+    asks[100];
+    asks[101];
+    ASSERT_NE(asks.find(100), nullptr);
+    EXPECT_EQ(asks.find(102), nullptr);
+
+    asks.erase(100);
+    EXPECT_EQ(asks.find(100), nullptr);
+    EXPECT_EQ(asks.size(), 1);
+    EXPECT_EQ(asks.bestPrice(), 101);
+
+    // Erasing a missing level is a no-op
+    asks.erase(100);
+    asks.erase(1'000'000);
+    EXPECT_EQ(asks.size(), 1);
+}
+
+TEST(TickLevelsTest, RecenterKeepsLevelsWhenPriceDrifts)
+{
+    TickLevels<Side::Buy> bids{64};
+    OrderPool pool;
+    auto handle = pool.acquire(1ull, 10u, 1000, OrderType::GoodTillCancel, Side::Buy, microsec_t{0});
+    pool.pushBack(bids[1000].orders, handle);
+
+    // Far below and far above the initial window
+    bids[900];
+    bids[5000];
+
+    EXPECT_EQ(levelPrices(bids), (std::vector<price_t>{5000, 1000, 900}));
+    ASSERT_NE(bids.find(1000), nullptr);
+    EXPECT_EQ(bids.find(1000)->orders.head, handle);
+    EXPECT_GE(bids.window(), 2 * (5000 - 900 + 1));
+}
+
+TEST(TickLevelsTest, NegativePrices)
+{
+    TickLevels<Side::Sell> asks;
+    asks[-5];
+    asks[3];
+
+    EXPECT_EQ(asks.bestPrice(), -5);
+    EXPECT_EQ(levelPrices(asks), (std::vector<price_t>{-5, 3}));
+}
+
+TEST(LadderOrderbookTest, PriceOutsideOfMaxWindowIsRejected)
+{
+    LadderOrderbook book;
+    EventSink sink;
+    price_t far = static_cast<price_t>(100 + TickLevels<Side::Buy>::maxWindow);
+
+    ASSERT_TRUE(book.addOrder(10, 100, OrderType::GoodTillCancel, Side::Buy, sink).accepted());
+    EXPECT_EQ(book.addOrder(10, far, OrderType::GoodTillCancel, Side::Buy, sink).reason,
+              RejectReason::PriceOutOfRange);
+    EXPECT_EQ(book.fullDepthBid().size(), 1);
+    EXPECT_EQ(book.bestBid(), 100);
+}
+
+// Both side containers must produce exactly the same book
+TEST(LadderOrderbookTest, MatchesMapOrderbookOnRandomWorkload)
+{
+    Orderbook mapBook;
+    LadderOrderbook ladderBook;
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<price_t> priceDist(80, 120);
+    std::uniform_int_distribution<quantity_t> qtyDist(1, 50);
+    std::uniform_int_distribution<int> actionDist(0, 99);
+    const OrderType types[] = {OrderType::GoodTillCancel, OrderType::GoodTillEOD, OrderType::FillAndKill,
+                               OrderType::FillOrKill, OrderType::Market};
+    std::vector<orderId_t> ids;
+
+    auto expectSameTrades = [](const trades_t& lhs, const trades_t& rhs) {
+        ASSERT_EQ(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            EXPECT_EQ(lhs[i].buyer, rhs[i].buyer);
+            EXPECT_EQ(lhs[i].seller, rhs[i].seller);
+            EXPECT_EQ(lhs[i].quantity, rhs[i].quantity);
+            EXPECT_EQ(lhs[i].price, rhs[i].price);
+        }
+    };
+    auto expectSameDepth = [](const levels_t& lhs, const levels_t& rhs) {
+        ASSERT_EQ(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            EXPECT_EQ(lhs[i].price, rhs[i].price);
+            EXPECT_EQ(lhs[i].volume, rhs[i].volume);
+            EXPECT_EQ(lhs[i].orderCnt, rhs[i].orderCnt);
+        }
+    };
+
+    for (int i = 0; i < 5000; ++i) {
+        int action = actionDist(rng);
+        if (action < 70 || ids.empty()) {
+            Side side = rng() % 2 ? Side::Buy : Side::Sell;
+            OrderType type = types[action % 10 < 6 ? 0 : rng() % 5];
+            price_t price = priceDist(rng) + (side == Side::Buy ? -5 : 5);
+            quantity_t quantity = qtyDist(rng);
+
+            auto [mapId, mapTrades, mapInfo] = mapBook.addOrder(quantity, price, type, side);
+            auto [ladderId, ladderTrades, ladderInfo] = ladderBook.addOrder(quantity, price, type, side);
+            ASSERT_EQ(mapId, ladderId);
+            expectSameTrades(mapTrades, ladderTrades);
+            ids.push_back(mapId);
+        } else if (action < 90) {
+            orderId_t orderId = ids[rng() % ids.size()];
+            mapBook.cancelOrder(orderId);
+            ladderBook.cancelOrder(orderId);
+        } else {
+            orderId_t orderId = ids[rng() % ids.size()];
+            ModifyOrder mods{.price = priceDist(rng), .quantity = qtyDist(rng)};
+            auto [mapId, mapTrades, mapInfo] = mapBook.modifyOrder(orderId, mods);
+            auto [ladderId, ladderTrades, ladderInfo] = ladderBook.modifyOrder(orderId, mods);
+            ASSERT_EQ(mapId, ladderId);
+            expectSameTrades(mapTrades, ladderTrades);
+            ids.push_back(mapId);
+        }
+
+        ASSERT_EQ(mapBook.bestAsk(), ladderBook.bestAsk());
+        ASSERT_EQ(mapBook.bestBid(), ladderBook.bestBid());
+        expectSameDepth(mapBook.fullDepthAsk(), ladderBook.fullDepthAsk());
+        expectSameDepth(mapBook.fullDepthBid(), ladderBook.fullDepthBid());
+    }
+}
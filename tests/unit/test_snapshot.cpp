@@ -0,0 +1,244 @@
+#include "orderbook.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::filesystem::path snapshotPath(const std::string& name)
+{
+    return std::filesystem::temp_directory_path() / ("orderbook_test_" + name + ".snapshot");
+}
+
+static bool sameTrades(const trades_t& lhs, const trades_t& rhs)
+{
+    return std::ranges::equal(lhs, rhs, [](const Trade& l, const Trade& r) {
+        return l.buyer == r.buyer && l.seller == r.seller && l.quantity == r.quantity && l.price == r.price;
+    });
+}
+
+// Random resting book with partially filled and amended orders, saved and
+// loaded into a fresh book. Both books then have to answer the same sweeps
+// with the same trades, which only happens if every queue kept its order
+template <typename Book>
+static void roundTripRandomBook(const std::string& name)
+{
+    auto path = snapshotPath(name);
+    Book original;
+    std::mt19937 rng{23};
+    std::vector<orderId_t> ids;
+    for (int i = 0; i < 5000; ++i) {
+        bool buy = rng() % 2 == 0;
+        quantity_t quantity = 1 + rng() % 100;
+        price_t price = buy ? 9900 + static_cast<price_t>(rng() % 100) : 10001 + static_cast<price_t>(rng() % 100);
+        OrderType type = rng() % 4 == 0 ? OrderType::GoodTillEOD : OrderType::GoodTillCancel;
+        orderId_t id = 0;
+        if (rng() % 10 == 0) {
+            EventSink sink;
+            id = original.addIcebergOrder(quantity, 1 + quantity / 4, price, type, buy ? Side::Buy : Side::Sell,
+                                          microsec_t{0}, sink)
+                     .orderId;
+        } else {
+            id = std::get<0>(original.addOrder(quantity, price, type, buy ? Side::Buy : Side::Sell));
+        }
+        ids.push_back(id);
+        if (rng() % 5 == 0)
+            original.modifyOrder(ids[rng() % ids.size()], ModifyOrder{.quantity = 1});
+        if (rng() % 7 == 0)
+            original.addOrder(quantity, buy ? 10001 : 9999, OrderType::FillAndKill, buy ? Side::Sell : Side::Buy);
+        // Stops beyond the resting orders, the sweeps below trigger them
+        if (rng() % 20 == 0) {
+            EventSink sink;
+            OrderType stopType = rng() % 2 == 0 ? OrderType::Stop : OrderType::StopLimit;
+            price_t trigger = buy ? 10050 + static_cast<price_t>(rng() % 50) : 9950 - static_cast<price_t>(rng() % 50);
+            original.addStopOrder(quantity, trigger, buy ? 10060 : 9940, stopType, buy ? Side::Buy : Side::Sell, sink);
+        }
+    }
+    ASSERT_GT(original.pendingStops(), 0);
+
+    ASSERT_EQ(original.saveSnapshot(path), SnapshotError::None);
+    Book restored;
+    ASSERT_EQ(restored.loadSnapshot(path), SnapshotError::None);
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(restored.fullDepthAsk(), original.fullDepthAsk());
+    EXPECT_EQ(restored.fullDepthBid(), original.fullDepthBid());
+    EXPECT_EQ(restored.costToFill(Side::Buy, 1000), original.costToFill(Side::Buy, 1000));
+    EXPECT_EQ(restored.pendingStops(), original.pendingStops());
+
+    for (int i = 0; i < 200; ++i) {
+        Side side = i % 2 == 0 ? Side::Buy : Side::Sell;
+        quantity_t quantity = 50 + static_cast<quantity_t>(i);
+        price_t price = side == Side::Buy ? 10100 : 9900;
+        auto [expectedId, expectedTrades, expectedInfo] = original.addOrder(quantity, price, OrderType::FillAndKill, side);
+        auto [id, trades, info] = restored.addOrder(quantity, price, OrderType::FillAndKill, side);
+        ASSERT_EQ(id, expectedId);
+        ASSERT_TRUE(sameTrades(trades, expectedTrades)) << "sweep " << i;
+    }
+    EXPECT_EQ(restored.fullDepthAsk(), original.fullDepthAsk());
+    EXPECT_EQ(restored.fullDepthBid(), original.fullDepthBid());
+    EXPECT_EQ(restored.pendingStops(), original.pendingStops());
+}
+
+TEST(SnapshotTest, MapBookRoundTrip) { roundTripRandomBook<Orderbook>("map"); }
+
+TEST(SnapshotTest, LadderBookRoundTrip) { roundTripRandomBook<LadderOrderbook>("ladder"); }
+
+TEST(SnapshotTest, ExpiriesAreScheduledAgain)
+{
+    auto path = snapshotPath("expiry");
+    ManualClockOrderbook original;
+    original.clock().set(microsec_t{100});
+    EventSink sink;
+    original.addOrder(10, 100, OrderType::GoodTillDate, Side::Buy, microsec_t{200}, sink);
+    original.addOrder(10, 99, OrderType::GoodTillEOD, Side::Buy, sink);
+    original.addOrder(10, 98, OrderType::GoodTillCancel, Side::Buy, sink);
+    ASSERT_EQ(original.saveSnapshot(path), SnapshotError::None);
+
+    ManualClockOrderbook restored;
+    ASSERT_EQ(restored.loadSnapshot(path), SnapshotError::None);
+    std::filesystem::remove(path);
+    ASSERT_EQ(restored.fullDepthBid().size(), 3);
+
+    restored.clock().set(microsec_t{200});
+    restored.expireOrders(sink);
+    EXPECT_EQ(restored.bestBid(), 99);
+    restored.closeSession(sink);
+    ASSERT_EQ(restored.fullDepthBid().size(), 1);
+    EXPECT_EQ(restored.bestBid(), 98);
+}
+
+TEST(SnapshotTest, CrossedAuctionBookRoundTrip)
+{
+    auto path = snapshotPath("auction");
+    Orderbook original;
+    EventSink sink;
+    original.startAuction();
+    original.addOrder(10, 101, OrderType::GoodTillCancel, Side::Buy, sink);
+    original.addOrder(4, 99, OrderType::GoodTillCancel, Side::Sell, sink);
+    ASSERT_EQ(original.saveSnapshot(path), SnapshotError::None);
+
+    Orderbook restored;
+    ASSERT_EQ(restored.loadSnapshot(path), SnapshotError::None);
+    std::filesystem::remove(path);
+    EXPECT_TRUE(restored.inAuction());
+    EXPECT_EQ(restored.bestBid(), 101);
+    EXPECT_EQ(restored.bestAsk(), 99);
+
+    // Both levels are candidates with the same volume and imbalance, without a last trade the lower one wins
+    std::optional<Equilibrium> equilibrium = restored.uncross(sink);
+    ASSERT_TRUE(equilibrium.has_value());
+    EXPECT_EQ(equilibrium->price, 99);
+    EXPECT_EQ(equilibrium->volume, 4);
+    EXPECT_FALSE(restored.inAuction());
+    EXPECT_EQ(restored.bestBid(), 101);
+    EXPECT_FALSE(restored.bestAsk().has_value());
+}
+
+// The iceberg at 90 only shows 2 of its 10, its hidden quantity has to be in the
+// equilibrium volume or the bid at 101 is left over the ask at 98 after the uncross
+template <typename Book>
+static void uncrossIcebergAuction(const std::string& name)
+{
+    auto path = snapshotPath(name);
+    Book original;
+    EventSink sink;
+    original.startAuction();
+    original.addOrder(40, 107, OrderType::GoodTillCancel, Side::Buy, sink);
+    original.addOrder(1, 101, OrderType::GoodTillCancel, Side::Buy, sink);
+    original.addIcebergOrder(10, 2, 90, OrderType::GoodTillCancel, Side::Sell, microsec_t{0}, sink);
+    original.addOrder(38, 98, OrderType::GoodTillCancel, Side::Sell, sink);
+
+    std::optional<Equilibrium> equilibrium = original.uncross(sink);
+    ASSERT_TRUE(equilibrium.has_value());
+    EXPECT_EQ(equilibrium->price, 98);
+    EXPECT_EQ(equilibrium->volume, 41);
+    EXPECT_FALSE(original.inAuction());
+    EXPECT_FALSE(original.bestBid().has_value());
+    EXPECT_EQ(original.bestAsk(), 98);
+
+    ASSERT_EQ(original.saveSnapshot(path), SnapshotError::None);
+    Book restored;
+    ASSERT_EQ(restored.loadSnapshot(path), SnapshotError::None);
+    std::filesystem::remove(path);
+    EXPECT_FALSE(restored.inAuction());
+    EXPECT_EQ(restored.fullDepthAsk(), original.fullDepthAsk());
+    EXPECT_TRUE(restored.fullDepthBid().empty());
+}
+
+TEST(SnapshotTest, UncrossedIcebergAuctionRoundTripMap) { uncrossIcebergAuction<Orderbook>("iceberg_auction_map"); }
+
+TEST(SnapshotTest, UncrossedIcebergAuctionRoundTripLadder)
+{
+    uncrossIcebergAuction<LadderOrderbook>("iceberg_auction_ladder");
+}
+
+TEST(SnapshotTest, BadFilesAreRefused)
+{
+    auto path = snapshotPath("bad");
+    Orderbook book;
+    EXPECT_EQ(book.loadSnapshot(snapshotPath("missing")), SnapshotError::Io);
+
+    std::ofstream{path, std::ios::binary} << "not a snapshot, long enough to hold a header";
+    EXPECT_EQ(book.loadSnapshot(path), SnapshotError::BadFormat);
+
+    Orderbook original;
+    original.addOrder(10, 100, OrderType::GoodTillCancel, Side::Buy);
+    original.addOrder(10, 101, OrderType::GoodTillCancel, Side::Sell);
+    ASSERT_EQ(original.saveSnapshot(path), SnapshotError::None);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    EXPECT_EQ(book.loadSnapshot(path), SnapshotError::BadFormat);
+
+    // Nothing was loaded by the failed attempts
+    EXPECT_TRUE(book.fullDepthBid().empty());
+    ASSERT_EQ(original.saveSnapshot(path), SnapshotError::None);
+    EXPECT_EQ(original.loadSnapshot(path), SnapshotError::BookInUse);
+    EXPECT_EQ(book.loadSnapshot(path), SnapshotError::None);
+    EXPECT_EQ(book.bestBid(), 100);
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, RepeatedOrderIdsAreRefused)
+{
+    auto path = snapshotPath("repeated");
+    auto record = [](orderId_t id, price_t price) {
+        return SnapshotOrder{.orderId = id,
+                             .openTime = 0,
+                             .expiry = 0,
+                             .price = price,
+                             .initialQuantity = 10,
+                             .remainingQuantity = 10,
+                             .hiddenQuantity = 0,
+                             .peak = 0,
+                             .type = OrderType::GoodTillCancel,
+                             .side = Side::Buy};
+    };
+    auto save = [&](orderId_t secondId) {
+        SnapshotWriter writer{path};
+        writer.start();
+        writer.append(record(1, 100));
+        writer.append(record(secondId, 99));
+        return writer.commit(SnapshotHeader{.recordSize = 0,
+                                            .orderCount = 0,
+                                            .lastOrderId = 2,
+                                            .levelSequence = 0,
+                                            .orderSequence = 0,
+                                            .journalSequence = 0,
+                                            .lastTradePrice = badValues::price,
+                                            .inAuction = 0});
+    };
+
+    ASSERT_EQ(save(1), SnapshotError::None);
+    Orderbook book;
+    EXPECT_EQ(book.loadSnapshot(path), SnapshotError::BadFormat);
+    EXPECT_TRUE(book.fullDepthBid().empty());
+
+    // The same records with distinct ids load
+    ASSERT_EQ(save(2), SnapshotError::None);
+    EXPECT_EQ(book.loadSnapshot(path), SnapshotError::None);
+    EXPECT_EQ(book.bestBid(), 100);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,97 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+TEST(TimerWheelTest, FiresInTimeOrder)
+{
+    timer_wheel<int> wheel;
+    wheel.insert(300, 3);
+    wheel.insert(5, 1);
+    wheel.insert(70, 2);
+    EXPECT_EQ(wheel.size(), 3);
+
+    std::vector<int> fired;
+    wheel.advance(100, [&](int value) { fired.push_back(value); });
+    EXPECT_EQ(fired, (std::vector<int>{1, 2}));
+    EXPECT_EQ(wheel.now(), 100);
+    EXPECT_EQ(wheel.size(), 1);
+
+    wheel.advance(299, [&](int value) { fired.push_back(value); });
+    EXPECT_EQ(fired.size(), 2);
+    wheel.advance(300, [&](int value) { fired.push_back(value); });
+    EXPECT_EQ(fired, (std::vector<int>{1, 2, 3}));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, PastEntriesFireOnNextAdvance)
+{
+    timer_wheel<int> wheel{1000};
+    wheel.insert(10, 1);
+    wheel.insert(1000, 2);
+
+    std::vector<int> fired;
+    wheel.advance(1000, [&](int value) { fired.push_back(value); });
+    EXPECT_EQ(fired, (std::vector<int>{1, 2}));
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, FarFutureAndEpochTimes)
+{
+    // Microsecond wall clock times, entries days and years apart
+    constexpr uint64_t now = 1'760'000'000'000'000;
+    constexpr uint64_t day = 86'400'000'000;
+    timer_wheel<int> wheel{now};
+    wheel.insert(now + 365 * day, 3);
+    wheel.insert(now + day, 2);
+    wheel.insert(now + 1, 1);
+    wheel.insert(std::numeric_limits<uint64_t>::max(), 4);
+
+    std::vector<int> fired;
+    wheel.advance(now + day, [&](int value) { fired.push_back(value); });
+    EXPECT_EQ(fired, (std::vector<int>{1, 2}));
+    wheel.advance(std::numeric_limits<uint64_t>::max(), [&](int value) { fired.push_back(value); });
+    EXPECT_EQ(fired, (std::vector<int>{1, 2, 3, 4}));
+}
+
+TEST(TimerWheelTest, MatchesSortedTimesOnRandomOperations)
+{
+    std::mt19937_64 rng{12};
+    timer_wheel<size_t> wheel{rng() % 1'000'000};
+    std::vector<std::pair<uint64_t, size_t>> pending;
+    size_t nextValue = 0;
+
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            // Mostly near, sometimes far ahead
+            uint64_t distance = rng() % 8 == 0 ? rng() % (1ull << 40) : rng() % 5000;
+            uint64_t time = wheel.now() + distance;
+            wheel.insert(time, nextValue);
+            pending.emplace_back(time, nextValue++);
+        }
+
+        uint64_t to = wheel.now() + (rng() % 4 == 0 ? rng() % (1ull << 38) : rng() % 3000);
+        std::vector<std::pair<uint64_t, size_t>> fired;
+        wheel.advance(to, [&](size_t value) {
+            auto it = std::ranges::find(pending, value, &std::pair<uint64_t, size_t>::second);
+            ASSERT_NE(it, pending.end());
+            fired.push_back(*it);
+        });
+
+        std::vector<std::pair<uint64_t, size_t>> expected;
+        std::erase_if(pending, [&](const auto& entry) {
+            if (entry.first > to)
+                return false;
+            expected.push_back(entry);
+            return true;
+        });
+        ASSERT_EQ(fired.size(), expected.size());
+        std::ranges::sort(fired);
+        std::ranges::sort(expected);
+        EXPECT_EQ(fired, expected);
+        EXPECT_EQ(wheel.size(), pending.size());
+    }
+}